@@ -10,10 +10,7 @@
 #define HIT_DISTANCE_MIN    0.003
 #define HIT_DISTANCE_FACTOR 0.0001
 
-#define MAX_BVH_SIZE   100 // given the formula of 2*l - 1
-#define MAX_PRIMITIVES 100
-#define MAX_MODELS     50
-#define MAX_MATERIALS  10
+#define BVH_STACK_SIZE 32 // AABBHierarchy::MAX_DEPTH, ordered traversal pushes at most one node per level
 
 // enums
 
@@ -29,6 +26,10 @@
 #define OPERATION_SUBSTRACT  1
 #define OPERATION_INTERSECT  2
 
+#define TRANSFORM_IDENTITY    0
+#define TRANSFORM_TRANSLATION 1
+#define TRANSFORM_GENERAL     2
+
 #define TEXTURE_CHESSBOARD 0
 #define INVALID_TEXTURE    100
 
@@ -36,9 +37,10 @@ struct Primitive {
     uint type;
     uint operation;
     float blending;
-    // dummy float
-    mat4 transform;
+    uint transformKind;
+    mat3x4 transform; // rows of affine transform, translation in w
     vec4 data;
+    vec4 bound; // bounding sphere in geometry space, xyz center, w radius
 };
 
 struct Material {
@@ -51,28 +53,31 @@ struct Material {
 };
 
 struct Model {
-    mat4 transform;
+    mat3x4 transform; // rows of affine transform, translation in w
     uint geometryId; // offset to primitive buffer
     uint materialId;
     uint primitiveCount;
     float scale;
+    vec3 boundMin; // box of added primitives in geometry space
+    int  volumeId; // baked SDF volume of the geometry, -1 when there is none
+    vec3 boundMax;
+    uint transformKind;
 };
 
+// flat BVH in depth-first order, left child follows its parent
 struct BVHNode {
-    vec4 bbMin;
-    vec4 bbMax;
-    int left;
-    int right;
-    int parent;
-    int model;
+    vec3 bbMin;
+    int  model;  // model id for leaf, -1 for internal node
+    vec3 bbMax;
+    int  escape; // index of first node after the subtree
 };
 
 // uniform and buffers
 
-layout (std140) uniform PrimitivesBlock { Primitive primitives[MAX_PRIMITIVES]; };
-layout (std140) uniform MaterialBlock { Material materials[MAX_MODELS]; };
-layout (std140) uniform ModelsBlock { Model models[MAX_MODELS]; };
-layout (std140) uniform BVHBlock { BVHNode bvh[MAX_BVH_SIZE]; };
+layout (std430, binding = 0) readonly buffer PrimitivesBlock { Primitive primitives[]; };
+layout (std430, binding = 1) readonly buffer MaterialBlock   { Material  materials[]; };
+layout (std430, binding = 2) readonly buffer ModelsBlock     { Model     models[]; };
+layout (std430, binding = 3) readonly buffer BVHBlock        { BVHNode   bvh[]; };
 
 ///////////////////////////////////////////////////////////////////////////
 // END OF COMMON HEADER
@@ -88,6 +93,53 @@ uniform vec3 upRayDistorsion;
 uniform vec3 leftRayDistorsion;
 
 uniform vec3  lightPosition;
+uniform float penumbraFactor; // 0 for hard shadows, otherwise k of soft shadows min(k * distance / t), larger k gives sharper penumbra
+
+// pixelStride N > 1 renders one pixel of each NxN block of refineImage selected by pixelPhase (x + y * N),
+// the viewport is then the grid of blocks and the color is stored to refineImage instead of fColor
+uniform int   pixelStride;
+uniform int   pixelPhase;
+uniform ivec2 refineSize;
+layout (binding = 0, rgba8) writeonly uniform image2D refineImage;
+
+// primary ray hits of the previous frame, x is hit distance and y model id or -1 on miss
+uniform bool  reprojection;   // seed primary rays from history and write the new one
+uniform bool  historyValid;   // false after scene change
+uniform ivec2 historySize;    // rendered part of history
+uniform vec3  historyCameraPosition;
+uniform vec3  historyCameraDirection;
+uniform vec3  historyUpRayDistorsion;
+uniform vec3  historyLeftRayDistorsion;
+layout (binding = 1) uniform sampler2D historyTexture;
+layout (binding = 1, rg32f) writeonly uniform image2D historyImage;
+
+// depth prepass, cells of prepassCellSize^2 pixels of prepassSize image hold distance which no ray of the cell hits before
+uniform bool  prepass;         // renders one fragment per cell to prepassImage
+uniform bool  depthPrepass;    // primary rays start at the distance of their cell in prepassTexture
+uniform int   prepassCellSize;
+uniform ivec2 prepassSize;
+layout (binding = 2) uniform sampler2D prepassTexture;
+layout (binding = 2, r32f) writeonly uniform image2D prepassImage;
+
+// traversal counters summed over all fragments of the frame when collectStats is set
+uniform bool collectStats;
+layout (std430, binding = 4) buffer TraversalStatsBlock {
+    uint statRays;       // primary, reflection and shadow rays
+    uint statNodeVisits; // node boxes tested by the rays and by cones of the prepass
+};
+
+// work of every pixel when collectCounters is set, counters of a pixel follow each other in order of PixelCounter,
+// rows go top-down, the prepass adds work of a cell to its first pixel in window coordinates
+#define COUNTER_STEPS          0
+#define COUNTER_SDF_CALLS      1
+#define COUNTER_NODE_VISITS    2
+#define COUNTER_SECONDARY_RAYS 3
+#define COUNTER_COUNT          4
+uniform bool  collectCounters;
+uniform ivec2 counterSize;
+layout (std430, binding = 5) buffer PixelCountersBlock {
+    uint pixelCounters[];
+};
 
 vec3 backgroundColor = vec3(0.22, 0.23, 0.35);
 
@@ -110,89 +162,139 @@ struct ModelIntersection {
     float rayEnd;
 };
 
-int modelIntersected = 0;
-ModelIntersection intersectedModels[MAX_MODELS];
+// counters of this fragment, added to TraversalStatsBlock and PixelCountersBlock at the end of main
+uint fragmentRays          = 0;
+uint fragmentNodeVisits    = 0;
+uint fragmentSteps         = 0;
+uint fragmentSdfCalls      = 0;
+uint fragmentSecondaryRays = 0;
 
 // This function was inspired by: https://medium.com/@bromanz/another-view-on-the-classic-ray-aabb-intersection-algorithm-for-bvh-traversal-41125138b525
-bool intersectBB(int nodeIndex, vec3 rayOrigin, vec3 direction, out float rayBegin, out float rayEnd) {
-    if (nodeIndex >= 0) {
-        vec3 ro = (vec4(rayOrigin, 1)).xyz;
-        vec3 inverseRayDir = 1.0 / direction;
+// box is enlarged by boxMargin on each side, an inverted box of a removed model is never hit
+bool intersectBB(int nodeIndex, vec3 rayOrigin, vec3 direction, float boxMargin, out float rayBegin, out float rayEnd) {
+    ++fragmentNodeVisits;
+    if (any(greaterThan(bvh[nodeIndex].bbMin, bvh[nodeIndex].bbMax))) {
+        return false;
+    }
+    vec3 ro = (vec4(rayOrigin, 1)).xyz;
+    vec3 inverseRayDir = 1.0 / direction;
 
-        vec3 tminv0 = (bvh[nodeIndex].bbMin.xyz - ro) * inverseRayDir;
-        vec3 tmaxv0 = (bvh[nodeIndex].bbMax.xyz - ro) * inverseRayDir;
+    vec3 tminv0 = (bvh[nodeIndex].bbMin.xyz - boxMargin - ro) * inverseRayDir;
+    vec3 tmaxv0 = (bvh[nodeIndex].bbMax.xyz + boxMargin - ro) * inverseRayDir;
 
-        vec3 tminv = min(tminv0, tmaxv0);
-        vec3 tmaxv = max(tminv0, tmaxv0);
+    vec3 tminv = min(tminv0, tmaxv0);
+    vec3 tmaxv = max(tminv0, tmaxv0);
 
-        float tmin = max(tminv.x, max(tminv.y, tminv.z));
-        float tmax = min(tmaxv.x, min(tmaxv.y, tmaxv.z));
+    float tmin = max(tminv.x, max(tminv.y, tminv.z));
+    float tmax = min(tmaxv.x, min(tmaxv.y, tmaxv.z));
 
-        if (tmin < tmax && tmax > 0) {
-            rayEnd = tmax;
-            rayBegin = tmin;
-            return true;
-        }
+    if (tmin < tmax && tmax > 0) {
+        rayEnd = tmax;
+        rayBegin = tmin;
+        return true;
     }
     return false;
 }
 
-/**
- * inspired: https://stackoverflow.com/questions/8975773/stackless-pre-order-traversal-in-a-binary-tree
- */
-bool computeModelIntersections(vec3 rayOrigin, vec3 rayDirection) {
-    // traverse bvh and fidn all models
-    modelIntersected = 0;
-    int nodeIndex = 0;
-
-    float rBegin;
-    float rEnd;
+bool insideBB(int nodeIndex, vec3 point) {
+    return all(greaterThanEqual(point, bvh[nodeIndex].bbMin.xyz)) && all(lessThanEqual(point, bvh[nodeIndex].bbMax.xyz));
+}
 
+// front-to-back traversal of one ray, nodes waiting for a visit are kept with their ray range
+int  traversalNode;  // node visited next, -1 pops the stack
+vec2 traversalRange;
+int  stackSize;
+int  stackNodes[BVH_STACK_SIZE];
+vec2 stackRanges[BVH_STACK_SIZE];
+
+// subtree whose children did not fit the stack is scanned in node order by escape links, nodes [scan, scanEnd) are left
+int traversalScan;
+int traversalScanEnd;
+
+void beginTraversal(vec3 rayOrigin, vec3 rayDirection, float boxMargin) {
+    stackSize        = 0;
+    traversalScan    = 0;
+    traversalScanEnd = 0;
+    traversalNode    = -1;
+    if (intersectBB(0, rayOrigin, rayDirection, boxMargin, traversalRange.x, traversalRange.y)) {
+        traversalNode = 0;
+    }
+}
 
-    if (intersectBB(nodeIndex, rayOrigin, rayDirection, rBegin, rEnd)) {
-        // useDebugColor = true;
-        // debugColor = vec3(0,0,0);
-        // left most search
-        while (nodeIndex >= 0 && modelIntersected < MAX_MODELS) {
-            debugColor += vec3(0,0.1,0);
-            BVHNode node = bvh[nodeIndex];
-
-            if (node.model >= 0) {
-                ModelIntersection intersection;
-                intersection.model = node.model;
-                intersection.rayBegin = rBegin;
-                intersection.rayEnd = rEnd;
-                intersectedModels[modelIntersected++] = intersection;
-            } else {
-                if (node.left > 0 && intersectBB(node.left, rayOrigin, rayDirection, rBegin, rEnd)) {
-                    nodeIndex = node.left;
-                    continue;
-                }
-
-                if (node.right > 0 && intersectBB(node.right, rayOrigin, rayDirection, rBegin, rEnd)) {
-                    nodeIndex = node.right;
-                    continue;
-                }
+/**
+ * Next leaf hit by the ray in order of rayBegin with rayBegin in (minRayBegin, maxDistance).
+ * Both children of a hit node are tested, the nearer one is visited first and the farther one is pushed,
+ * nodes entered at or beyond maxDistance are dropped so the caller ends the traversal by lowering it to its closest hit.
+ * A subtree deeper than the stack, e.g. after refits, is scanned out of order, callers keep the closest hit of all leaves.
+ */
+bool nextLeaf(vec3 rayOrigin, vec3 rayDirection, float boxMargin, float minRayBegin, float maxDistance, out ModelIntersection leaf) {
+    maxDistance = min(maxDistance, MAX_DISTANCE);
+    while (true) {
+        if (traversalScan < traversalScanEnd) {
+            int  node = traversalScan;
+            vec2 range;
+            if (!intersectBB(node, rayOrigin, rayDirection, boxMargin, range.x, range.y) || range.x >= maxDistance) {
+                traversalScan = bvh[node].escape; // whole subtree is missed
+                continue;
             }
-
-            while (node.parent >= 0) {
-                BVHNode parent = bvh[node.parent];
-                if (parent.left == nodeIndex && parent.right > 0) {
-                    if (intersectBB(parent.right, rayOrigin, rayDirection, rBegin, rEnd)) {
-                        nodeIndex = parent.right;
-                        break;
-                    }
-                }
-                nodeIndex = node.parent;
-                node = parent;
+            traversalScan = node + 1; // children follow their parent
+            if (bvh[node].model >= 0 && range.x > minRayBegin) {
+                leaf.model    = bvh[node].model;
+                leaf.rayBegin = range.x;
+                leaf.rayEnd   = range.y;
+                return true;
             }
-
-            if (nodeIndex == 0) {
-                break;
+            continue;
+        }
+        if (traversalNode < 0) {
+            if (stackSize == 0) {
+                return false;
+            }
+            --stackSize;
+            traversalNode  = stackNodes[stackSize];
+            traversalRange = stackRanges[stackSize];
+        }
+        int node = traversalNode;
+        traversalNode = -1;
+        if (traversalRange.x >= maxDistance) {
+            continue;
+        }
+        debugColor += vec3(0,0.1,0);
+
+        if (bvh[node].model >= 0) {
+            if (traversalRange.x > minRayBegin) {
+                leaf.model    = bvh[node].model;
+                leaf.rayBegin = traversalRange.x;
+                leaf.rayEnd   = traversalRange.y;
+                return true;
             }
+            continue;
+        }
+        if (bvh[node].escape == node + 1) { // leaf of removed model
+            continue;
+        }
+
+        int  left  = node + 1;
+        int  right = bvh[left].escape;
+        vec2 leftRange;
+        vec2 rightRange;
+        bool leftHit  = intersectBB(left,  rayOrigin, rayDirection, boxMargin, leftRange.x,  leftRange.y);
+        bool rightHit = intersectBB(right, rayOrigin, rayDirection, boxMargin, rightRange.x, rightRange.y);
+        if (leftHit && rightHit && stackSize == BVH_STACK_SIZE) { // deeper than the build allows, same in CpuRenderer::nextLeaf
+            traversalScan    = left;
+            traversalScanEnd = bvh[node].escape;
+        } else if (leftHit && rightHit) {
+            bool leftFirst = leftRange.x <= rightRange.x;
+            stackNodes[stackSize]  = leftFirst ? right : left;
+            stackRanges[stackSize] = leftFirst ? rightRange : leftRange;
+            ++stackSize;
+            traversalNode  = leftFirst ? left : right;
+            traversalRange = leftFirst ? leftRange : rightRange;
+        } else if (leftHit || rightHit) {
+            traversalNode  = leftHit ? left : right;
+            traversalRange = leftHit ? leftRange : rightRange;
         }
     }
-    return modelIntersected > 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -208,6 +310,7 @@ float rayMarchModel(vec3 originPoint, vec3 direction, int modelId, float maxDist
     float distanceMarched = 0;
     minDistance = maxDistance;
     for (int step = 0; step < MAX_STEPS; ++step) {
+        ++fragmentSteps;
         vec3 position = originPoint + distanceMarched * direction;
         float dist = sdModel(position, modelId);
         minDistance = min(dist, minDistance);
@@ -219,38 +322,154 @@ float rayMarchModel(vec3 originPoint, vec3 direction, int modelId, float maxDist
     return min(distanceMarched, maxDistance);
 }
 
-float rayMarch(vec3 originPoint, vec3 direction, out int modelId) {
+// marching of each model starts at startDistance at the earliest
+float rayMarch(vec3 originPoint, vec3 direction, float startDistance, out int modelId) {
+    ++fragmentRays;
+    if (startDistance >= MAX_DISTANCE) { // cone of the prepass missed everything
+        return MAX_DISTANCE;
+    }
 
-    float closestRayBegin = 0;
-    int iterations = 0;
-    if (computeModelIntersections(originPoint, direction)) {
-        while (iterations < modelIntersected) {
+    // models are marched front to back only up to the closest hit, boxes entered behind it are not visited
+    float closestHit = MAX_DISTANCE;
+    ModelIntersection intersection;
+    beginTraversal(originPoint, direction, 0);
+    while (nextLeaf(originPoint, direction, 0, 0, closestHit, intersection)) {
+        float rayBegin = max(intersection.rayBegin, startDistance);
+        float rayEnd   = min(intersection.rayEnd, closestHit);
+        if (rayBegin < rayEnd) {
+            float minDistance;
+            vec3  actPosition = originPoint + direction * rayBegin;
+            float intersectionDistance = rayEnd - rayBegin;
+            float dist = rayMarchModel(actPosition, direction, intersection.model, intersectionDistance, minDistance);
 
-            ModelIntersection cloestMI;
-            cloestMI.rayBegin = MAX_DISTANCE;
-            for (int i = 0; i < modelIntersected; ++i) { // we need to find closest
-                if (intersectedModels[i].rayBegin > closestRayBegin && cloestMI.rayBegin > intersectedModels[i].rayBegin) {
-                    cloestMI = intersectedModels[i];
-                }
+            if (dist < intersectionDistance) { // hit
+                modelId    = intersection.model;
+                closestHit = dist + rayBegin;
             }
+        }
+    }
+    return closestHit;
+}
 
-            float minDistance;
-            vec3  actPosition = originPoint + direction * cloestMI.rayBegin;
-            float intersectionDistance = cloestMI.rayEnd - cloestMI.rayBegin;
-            float dist = rayMarchModel(actPosition, direction, cloestMI.model, intersectionDistance, minDistance);
+///////////////////////////////////////////////////////////////////////////////
+// SHADOW RAYS
+///////////////////////////////////////////////////////////////////////////////
+
+// light visibility along the model segment, 0 on hit, penumbra of the closest approach when penumbraFactor > 0
+float shadowMarchModel(vec3 originPoint, vec3 direction, int modelId, float rayBegin, float maxDistance) {
+    float visibility      = 1;
+    float distanceMarched = 0;
+    for (int step = 0; step < MAX_STEPS; ++step) {
+        ++fragmentSteps;
+        vec3  position = originPoint + distanceMarched * direction;
+        float dist     = sdModel(position, modelId);
+        if (penumbraFactor > 0) {
+            visibility = min(visibility, penumbraFactor * dist / (rayBegin + distanceMarched));
+        }
+        distanceMarched += dist;
+        if (distanceMarched >= maxDistance) {
+            return clamp(visibility, 0, 1);
+        }
+        if (dist <= getHitDistance(position)) {
+            return 0;
+        }
+    }
+    return 0; // out of steps counts as a hit as in rayMarchModel
+}
 
+// penumbra darkens rays passing a model closer than t / penumbraFactor, boxes are grown by the largest such distance
+float penumbraMargin(float maxDistance) {
+    return penumbraFactor > 0 ? maxDistance / penumbraFactor : 0;
+}
 
-            if (dist < intersectionDistance) { // hit
-                modelId = cloestMI.model;
-                return dist + cloestMI.rayBegin;
+/**
+ * Any-hit counterpart of rayMarch for shadow rays, ignoredModel is the shaded model.
+ * Models are marched in BVH order without collecting and sorting intersections, the first hit ends the traversal.
+ * Models whose box holds the ray origin are skipped, with penumbra their grown boxes are marched from the origin.
+ */
+float traceShadow(vec3 originPoint, vec3 direction, float maxDistance, int ignoredModel) {
+    maxDistance = min(maxDistance, MAX_DISTANCE);
+
+    ++fragmentRays;
+    ++fragmentSecondaryRays;
+    float visibility = 1;
+    float boxMargin  = penumbraMargin(maxDistance);
+    int   nodeIndex  = 0;
+    float rBegin;
+    float rEnd;
+    while (nodeIndex < bvh.length()) {
+        if (!intersectBB(nodeIndex, originPoint, direction, boxMargin, rBegin, rEnd) || rBegin >= maxDistance) {
+            nodeIndex = bvh[nodeIndex].escape;
+            continue;
+        }
+        int model = bvh[nodeIndex].model;
+        if (model < 0) {
+            ++nodeIndex;
+            continue;
+        }
+        if (model != ignoredModel && !insideBB(nodeIndex, originPoint)) {
+            rBegin     = max(rBegin, HIT_DISTANCE_MIN); // penumbra divides by the distance from the origin
+            visibility = min(visibility, shadowMarchModel(originPoint + direction * rBegin, direction, model, rBegin, min(rEnd, maxDistance) - rBegin));
+            if (visibility <= 0) {
+                return 0;
             }
+        }
+        nodeIndex = bvh[nodeIndex].escape;
+    }
+    return visibility;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DEPTH PREPASS
+///////////////////////////////////////////////////////////////////////////////
 
-            closestRayBegin = cloestMI.rayBegin;
-            ++iterations;
+vec3 prepassRayDirection(vec2 pixel) {
+    vec2 coord = pixel / vec2(prepassSize) * 2.0 - 1.0;
+    return normalize(cameraDirection + coord.y * upRayDistorsion + coord.x * leftRayDistorsion);
+}
+
+/**
+ * Distance along the cone axis up to which no ray of the cone gets closer to the model than its hit distance.
+ * Ray of the cone at distance t is at most t * spread from the axis, so a step keeps the cone inside the empty sphere.
+ */
+float coneMarchModel(vec3 direction, float spread, ModelIntersection intersection) {
+    float t = max(intersection.rayBegin, 0);
+    for (int step = 0; step < MAX_STEPS; ++step) {
+        ++fragmentSteps;
+        float dist        = sdModel(cameraPosition + direction * t, intersection.model);
+        float reach       = t + max(dist, 0);
+        float hitDistance = clamp(reach * reach * HIT_DISTANCE_FACTOR, HIT_DISTANCE_MIN, HIT_DISTANCE_MAX);
+        float advance     = (dist - hitDistance - t * spread) / (1 + spread);
+        if (advance <= t * spread) { // cone touches the surface within pixel footprint
+            return t + max(advance, 0);
+        }
+        t += advance;
+        if (t >= intersection.rayEnd) {
+            return MAX_DISTANCE;
         }
     }
+    return t;
+}
 
-    return MAX_DISTANCE;
+// safe start distance of all primary rays of the cell, models are cone marched front to back until the nearest stop
+float coneMarchCell(ivec2 cell) {
+    vec2 cellMin   = vec2(cell * prepassCellSize) + 0.5; // corner pixel centers
+    vec2 cellMax   = vec2(min((cell + 1) * prepassCellSize, prepassSize)) - 0.5;
+    vec3 direction = prepassRayDirection((cellMin + cellMax) * 0.5);
+    float spread   = max(
+        max(length(prepassRayDirection(cellMin) - direction), length(prepassRayDirection(cellMax) - direction)),
+        max(length(prepassRayDirection(vec2(cellMin.x, cellMax.y)) - direction), length(prepassRayDirection(vec2(cellMax.x, cellMin.y)) - direction))
+    );
+
+    // boxes are enlarged by the widest cone radius so that models touched only by the cone are not missed
+    float safeDistance = MAX_DISTANCE;
+    float boxMargin    = spread * MAX_DISTANCE;
+    ModelIntersection intersection;
+    beginTraversal(cameraPosition, direction, boxMargin);
+    while (nextLeaf(cameraPosition, direction, boxMargin, -MAX_DISTANCE, safeDistance, intersection)) {
+        safeDistance = min(safeDistance, coneMarchModel(direction, spread, intersection));
+    }
+    return safeDistance;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -258,6 +477,7 @@ float rayMarch(vec3 originPoint, vec3 direction, out int modelId) {
 ///////////////////////////////////////////////////////////////////////////////
 
 vec3 getNormal(vec3 point, int modelId) {
+    fragmentSdfCalls += 4;
     float d = sdModel(point, modelId);
     vec2 e = vec2(getHitDistance(point), 0);
     vec3 n = d - vec3(
@@ -298,12 +518,11 @@ vec3 getLight(vec3 point, vec3 toLightVector, vec3 viewVector, vec3 normalVector
     float dotNL = max(dot(normalVector, toLightVector), 0.0);
     float dotRV = max(dot(lightReflectedVector, viewVector), 0.0);
 
-    uint model;
-    float dist = rayMarch(point + normalVector * getHitDistance(point) * 1.1, toLightVector, model);
-    if (model != modelId && dist < length(lightPosition - point)) {
-        dotNL *= 0.1;
-        dotRV *= 0.1;
-    }
+    // shadowed light is dimmed to 10 %, penumbra blends in between
+    float visibility  = traceShadow(point + normalVector * getHitDistance(point) * 1.1, toLightVector, length(lightPosition - point), modelId);
+    float lightFactor = mix(0.1, 1.0, visibility);
+    dotNL *= lightFactor;
+    dotRV *= lightFactor;
 
     // get material propertios
     Material material = getMaterial(point, modelId);
@@ -334,7 +553,8 @@ vec3 getColor(vec3 point, int modelId, bool reflection) {
         if (material.shininess > 100) {
             int model;
             vec3 origin = point + normalVector * getHitDistance(point) * 1.1;
-            float dist = rayMarch(origin, viewReflectedVector, model);
+            ++fragmentSecondaryRays;
+            float dist = rayMarch(origin, viewReflectedVector, 0, model);
             vec3 reflectedColor;
             if (model != modelId) {
                 toLightVector        = normalize(lightPosition - origin);
@@ -354,17 +574,157 @@ vec3 getColor(vec3 point, int modelId, bool reflection) {
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// TEMPORAL REPROJECTION
+///////////////////////////////////////////////////////////////////////////////
+
+// screen coordinate of the point in the history camera, camera direction and distorsions are orthogonal
+vec2 historyScreenCoord(vec3 point, out bool inFront) {
+    vec3  v     = point - historyCameraPosition;
+    float depth = dot(v, historyCameraDirection) / dot(historyCameraDirection, historyCameraDirection);
+    inFront = depth > 0;
+    v = v / depth - historyCameraDirection;
+    return vec2(dot(v, historyLeftRayDistorsion) / dot(historyLeftRayDistorsion, historyLeftRayDistorsion),
+                dot(v, historyUpRayDistorsion)   / dot(historyUpRayDistorsion, historyUpRayDistorsion));
+}
+
+// hit point of the history texel, false when 2x2 texels around disagree in model or the point was disoccluded
+bool fetchHistoryHit(vec2 coord, out vec3 point, out int modelId) {
+    vec2  texel  = (coord * 0.5 + 0.5) * vec2(historySize);
+    ivec2 corner = ivec2(floor(texel - 0.5));
+    if (any(lessThan(corner, ivec2(0))) || any(greaterThanEqual(corner + 1, historySize))) {
+        return false;
+    }
+    vec2 h00 = texelFetch(historyTexture, corner, 0).xy;
+    vec2 h10 = texelFetch(historyTexture, corner + ivec2(1, 0), 0).xy;
+    vec2 h01 = texelFetch(historyTexture, corner + ivec2(0, 1), 0).xy;
+    vec2 h11 = texelFetch(historyTexture, corner + ivec2(1, 1), 0).xy;
+    if (h00.y < 0 || h00.y != h10.y || h00.y != h01.y || h00.y != h11.y) {
+        return false;
+    }
+
+    ivec2 nearest     = ivec2(texel);
+    vec2  nearestHit  = texelFetch(historyTexture, nearest, 0).xy;
+    vec2  texelCoord  = (vec2(nearest) + 0.5) / vec2(historySize) * 2.0 - 1.0;
+    vec3  direction   = normalize(historyCameraDirection + texelCoord.y * historyUpRayDistorsion + texelCoord.x * historyLeftRayDistorsion);
+    point   = historyCameraPosition + direction * nearestHit.x;
+    modelId = int(h00.y);
+    return true;
+}
+
+// true when any model is hit before maxDistance, stackless traversal by escape links as in traceShadow
+bool anyHit(vec3 originPoint, vec3 direction, float maxDistance) {
+    int   nodeIndex = 0;
+    float rBegin;
+    float rEnd;
+    while (nodeIndex < bvh.length()) {
+        if (!intersectBB(nodeIndex, originPoint, direction, 0, rBegin, rEnd) || rBegin >= maxDistance) {
+            nodeIndex = bvh[nodeIndex].escape;
+            continue;
+        }
+        int model = bvh[nodeIndex].model;
+        if (model < 0) {
+            ++nodeIndex;
+            continue;
+        }
+        float minDistance;
+        rBegin = max(rBegin, 0);
+        float segment = min(rEnd, maxDistance) - rBegin;
+        if (rayMarchModel(originPoint + direction * rBegin, direction, model, segment, minDistance) < segment) {
+            return true;
+        }
+        nodeIndex = bvh[nodeIndex].escape;
+    }
+    return false;
+}
+
+/**
+ * Surface seen by this pixel in the previous frame is a guess of the hit point, its reprojection is looked up again
+ * and accepted when the history hit lies on the ray. The hit model is then marched from just before the expected hit,
+ * and the ray in front of it is checked by an any-hit traversal for surfaces the history does not know of,
+ * such as models uncovered by the camera motion. False means disocclusion, occlusion or failed march
+ * and the full rayMarch has to be used.
+ */
+bool rayMarchReprojected(vec3 originPoint, vec3 direction, vec2 screenCoord, out float hitDistance, out int modelId) {
+    vec3 point;
+    bool inFront;
+    if (!fetchHistoryHit(screenCoord, point, modelId)) {
+        return false;
+    }
+    float t = dot(point - originPoint, direction);
+    vec2  coord = historyScreenCoord(originPoint + direction * t, inFront);
+    if (!inFront || !fetchHistoryHit(coord, point, modelId)) {
+        return false;
+    }
+    t = dot(point - originPoint, direction);
+    float margin = t * 0.02 + getHitDistance(point);
+    if (t <= margin || length(originPoint + direction * t - point) > margin) {
+        return false;
+    }
+
+    float minDistance;
+    float dist = rayMarchModel(originPoint + direction * (t - margin), direction, modelId, 3 * margin, minDistance);
+    if (dist < 0 || dist >= 3 * margin || anyHit(originPoint, direction, t - margin)) {
+        return false;
+    }
+    hitDistance = t - margin + dist;
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // ENTRY POINT
 ///////////////////////////////////////////////////////////////////////////////
 
+void addTraversalStats() {
+    if (collectStats) {
+        atomicAdd(statRays, fragmentRays);
+        atomicAdd(statNodeVisits, fragmentNodeVisits);
+    }
+}
+
+// pixel is in bottom-up window coordinates, atomics because prepass cells and pixels share their corner pixel
+void addPixelCounters(ivec2 pixel) {
+    if (!collectCounters || any(greaterThanEqual(pixel, counterSize))) {
+        return;
+    }
+    uint index = (uint(counterSize.y - 1 - pixel.y) * uint(counterSize.x) + uint(pixel.x)) * COUNTER_COUNT;
+    atomicAdd(pixelCounters[index + COUNTER_STEPS],          fragmentSteps);
+    atomicAdd(pixelCounters[index + COUNTER_SDF_CALLS],      fragmentSteps + fragmentSdfCalls);
+    atomicAdd(pixelCounters[index + COUNTER_NODE_VISITS],    fragmentNodeVisits);
+    atomicAdd(pixelCounters[index + COUNTER_SECONDARY_RAYS], fragmentSecondaryRays);
+}
 
 void main() {
+    if (prepass) {
+        imageStore(prepassImage, ivec2(gl_FragCoord.xy), vec4(coneMarchCell(ivec2(gl_FragCoord.xy))));
+        addTraversalStats();
+        addPixelCounters(ivec2(gl_FragCoord.xy) * prepassCellSize);
+        return;
+    }
+
+    vec2  screenCoord = fragCoord;
+    ivec2 refinePixel = ivec2(0);
+    if (pixelStride > 1) {
+        refinePixel = ivec2(gl_FragCoord.xy) * pixelStride + ivec2(pixelPhase % pixelStride, pixelPhase / pixelStride);
+        if (any(greaterThanEqual(refinePixel, refineSize))) {
+            return;
+        }
+        screenCoord = (vec2(refinePixel) + 0.5) / vec2(refineSize) * 2.0 - 1.0;
+    }
+
     vec3  rayOrigin    = cameraPosition;
-    vec3  rayDirection = normalize(cameraDirection + fragCoord.y * upRayDistorsion + fragCoord.x * leftRayDistorsion);
+    vec3  rayDirection = normalize(cameraDirection + screenCoord.y * upRayDistorsion + screenCoord.x * leftRayDistorsion);
     vec3  color        = backgroundColor;
-    int modelId;
-    float dist         = rayMarch(cameraPosition, rayDirection, modelId);
+    int   modelId      = -1;
+    float dist         = MAX_DISTANCE;
+    if (!reprojection || !historyValid || !rayMarchReprojected(rayOrigin, rayDirection, screenCoord, dist, modelId)) {
+        ivec2 pixel         = pixelStride > 1 ? refinePixel : ivec2(gl_FragCoord.xy);
+        float startDistance = depthPrepass ? texelFetch(prepassTexture, pixel / prepassCellSize, 0).x : 0;
+        dist = rayMarch(cameraPosition, rayDirection, startDistance, modelId);
+    }
+    if (reprojection && pixelStride == 1) {
+        imageStore(historyImage, ivec2(gl_FragCoord.xy), vec4(dist, dist < MAX_DISTANCE ? modelId : -1, 0, 0));
+    }
 
     // if hit then shade the point
     if (dist < MAX_DISTANCE) {
@@ -372,6 +732,11 @@ void main() {
         vec3 position = cameraPosition + rayDirection * dist;
         color = getColor(position, modelId, true);
     }
+    addTraversalStats();
+    addPixelCounters(pixelStride > 1 ? refinePixel : ivec2(gl_FragCoord.xy));
 
     fColor = vec4(mix(debugColor, color, useDebugColor ? 0.5 : 1), 1);
+    if (pixelStride > 1) {
+        imageStore(refineImage, refinePixel, fColor);
+    }
 }
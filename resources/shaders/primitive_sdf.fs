@@ -10,10 +10,9 @@
 #define HIT_DISTANCE_MIN    0.003
 #define HIT_DISTANCE_FACTOR 0.0001
 
-#define MAX_BVH_SIZE   100 // given the formula of 2*l - 1
-#define MAX_PRIMITIVES 100
-#define MAX_MODELS     50
-#define MAX_MATERIALS  10
+#define MODEL_BOUND_DISTANCE 1.0 // beyond this distance from its bound the model is not evaluated
+
+#define BVH_STACK_SIZE 32 // AABBHierarchy::MAX_DEPTH, ordered traversal pushes at most one node per level
 
 // enums
 
@@ -29,6 +28,10 @@
 #define OPERATION_SUBSTRACT  1
 #define OPERATION_INTERSECT  2
 
+#define TRANSFORM_IDENTITY    0
+#define TRANSFORM_TRANSLATION 1
+#define TRANSFORM_GENERAL     2
+
 #define TEXTURE_CHESSBOARD 0
 #define INVALID_TEXTURE    100
 
@@ -36,9 +39,10 @@ struct Primitive {
     uint type;
     uint operation;
     float blending;
-    // dummy float
-    mat4 transform;
+    uint transformKind;
+    mat3x4 transform; // rows of affine transform, translation in w
     vec4 data;
+    vec4 bound; // bounding sphere in geometry space, xyz center, w radius
 };
 
 struct Material {
@@ -51,34 +55,54 @@ struct Material {
 };
 
 struct Model {
-    mat4 transform;
+    mat3x4 transform; // rows of affine transform, translation in w
     uint geometryId; // offset to primitive buffer
     uint materialId;
     uint primitiveCount;
     float scale;
+    vec3 boundMin; // box of added primitives in geometry space
+    int  volumeId; // baked SDF volume of the geometry, -1 when there is none
+    vec3 boundMax;
+    uint transformKind;
 };
 
+// flat BVH in depth-first order, left child follows its parent
 struct BVHNode {
-    vec4 bbMin;
-    vec4 bbMax;
-    int left;
-    int right;
-    int parent;
-    int model;
+    vec3 bbMin;
+    int  model;  // model id for leaf, -1 for internal node
+    vec3 bbMax;
+    int  escape; // index of first node after the subtree
 };
 
 // uniform and buffers
 
-layout (std140) uniform PrimitivesBlock { Primitive primitives[MAX_PRIMITIVES]; };
-layout (std140) uniform MaterialBlock { Material materials[MAX_MODELS]; };
-layout (std140) uniform ModelsBlock { Model models[MAX_MODELS]; };
-layout (std140) uniform BVHBlock { BVHNode bvh[MAX_BVH_SIZE]; };
+layout (std430, binding = 0) readonly buffer PrimitivesBlock { Primitive primitives[]; };
+layout (std430, binding = 1) readonly buffer MaterialBlock   { Material  materials[]; };
+layout (std430, binding = 2) readonly buffer ModelsBlock     { Model     models[]; };
+layout (std430, binding = 3) readonly buffer BVHBlock        { BVHNode   bvh[]; };
 
 ///////////////////////////////////////////////////////////////////////////
 // END OF COMMON HEADER
 ///////////////////////////////////////////////////////////////////////////
 
-#define TRANSFORM_POS(pos, obj) (obj.transform * vec4(pos, 1)).xyz
+#define TRANSFORM_POS(pos, obj) transformPosition(pos, obj.transform, obj.transformKind)
+
+// identity and translation skip the matrix product, the kind is set by classifyTransform in sceneUtils.cpp
+vec3 transformPosition(vec3 position, mat3x4 transform, uint kind) {
+    switch (kind) {
+        case TRANSFORM_IDENTITY:    return position;
+        case TRANSFORM_TRANSLATION: return position + vec3(transform[0].w, transform[1].w, transform[2].w);
+    }
+    return vec4(position, 1) * transform;
+}
+
+#define VOLUME_MARGIN            0.25 // baked volume covers model bound grown by this margin in geometry space
+#define VOLUME_ANALYTIC_DISTANCE 0.1  // closer to the surface primitives are evaluated instead of the volume
+
+// baked SDF volumes stacked along z, see SdfVolume.h
+layout (binding = 0) uniform sampler3D sdfVolumes;
+uniform int volumeResolution;
+uniform int volumeCount;
 
 // see https://iquilezles.org/www/articles/distfunctions/distfunctions.htm
 
@@ -96,6 +120,7 @@ float getHitDistance(vec3 point);
 
 // SDF definitions
 float sdModel(vec3 position, int modelId);
+float sdPrimitives(vec3 p, uint geometryId, uint primitiveCount, float scale);
 float sdPrimitive(vec3 position, Primitive primitive);
 float sdSphere(vec3 position, Primitive sphere);
 float sdCapsule(vec3 position, Primitive capsule);
@@ -105,21 +130,56 @@ float sdCilinder(vec3 position, Primitive cilinder);
 float sdCone(vec3 position, Primitive cone);
 float roundCone(vec3 position, Primitive roundCone);
 float sdBoundingBox(vec3 position, Primitive bBox, float thicness);
+float sdBound(vec3 position, vec3 boundMin, vec3 boundMax);
+float sdVolume(vec3 position, Model model);
+
+// generated per scene by SdfCodegen, straight-line function of the geometry or sdPrimitives for other geometries
+float sdGeometry(vec3 p, uint geometryId, uint primitiveCount, float scale);
 
 vec3 debugColor    = vec3(1,0,0);
 bool useDebugColor = false;
 
 float sdModel(vec3 position, int modelId) {
 
+    Model model = models[modelId];
+    vec3  p     = TRANSFORM_POS(position, model) / model.scale;
+
+    // far from the model its bound is a conservative distance
+    float boundDist = sdBound(p, model.boundMin, model.boundMax) * model.scale;
+    if (boundDist > MODEL_BOUND_DISTANCE) {
+        return boundDist;
+    }
+
+    // baked volume replaces the primitives except near the surface where exact hits are needed
+    if (model.volumeId >= 0 && volumeCount > 0) {
+        float bakedDist = sdVolume(p, model) * model.scale;
+        if (bakedDist > VOLUME_ANALYTIC_DISTANCE) {
+            return bakedDist;
+        }
+    }
+
+    return sdGeometry(p, model.geometryId, model.primitiveCount, model.scale);
+}
+
+// interpreter of primitives of a geometry, p is in geometry space
+float sdPrimitives(vec3 p, uint geometryId, uint primitiveCount, float scale) {
+
     float finalDist = MAX_DISTANCE;
-    Model model     = models[modelId];
-    vec3 p          = TRANSFORM_POS(position, model);
+    for (uint i = 0; i < primitiveCount; ++i) {
 
-    for (int i = 0; i < model.primitiveCount; ++i) {
+        Primitive primitive = primitives[i + geometryId];
+        primitive.blending  *= scale;
 
-        Primitive primitive = primitives[i + model.geometryId];
-        primitive.blending  *= model.scale;
-        float distToPrimitive = sdPrimitive(p / model.scale, primitive) * model.scale;
+        // primitive distance is at least distance to its bounding sphere, skipped when blending would keep finalDist as it is
+        float lowerBound = (length(p - primitive.bound.xyz) - primitive.bound.w) * scale;
+        if (primitive.operation == OPERATION_ADD && lowerBound >= finalDist + primitive.blending) {
+            continue;
+        }
+        if (primitive.operation == OPERATION_SUBSTRACT && lowerBound >= primitive.blending - finalDist) {
+            continue;
+        }
+
+        float distToPrimitive = sdPrimitive(p, primitive) * scale;
 
         switch (primitive.operation) {
             case OPERATION_ADD:       finalDist = smoothMin(distToPrimitive, finalDist, primitive.blending); break;
@@ -128,26 +188,6 @@ float sdModel(vec3 position, int modelId) {
         };
     }
 
-    // // optimize with dist to models bounding box
-
-    // // data.y *= 0.5;
-    // // model.bbMax *= model.scale;
-    // // model.bbMin *= model.scale;
-
-    // Primitive bb = {
-    //     TYPE_BOX,
-    //     OPERATION_ADD,
-    //     0,
-    //     model.transform,
-    //     (model.bbMax - model.bbMin) * 0.5
-    // };
-    // finalDist = min(sdBoundingBox(
-    //     (position - (model.bbMin.xyz * 0.5 + model.bbMax.xyz * 0.5)),
-    //     bb,
-    //     0.01
-    // ), finalDist);
-    // // finalDist = min(sdBox(position, bb), finalDist);
-
     return finalDist;
 }
 
@@ -164,49 +204,44 @@ float sdPrimitive(vec3 position, Primitive primitive) {
     return MAX_DISTANCE;
 }
 
-// primitive SD functions
+// primitive SD functions, position is in space of the primitive for overloads taking only its data
 
-float sdSphere(vec3 position, Primitive sphere) {
-    return length(TRANSFORM_POS(position, sphere)) - sphere.data.x;
+float sdSphere(vec3 p, vec4 data) {
+    return length(p) - data.x;
 }
 
-float sdCapsule(vec3 position, Primitive capsule) {
-    vec3 p = TRANSFORM_POS(position, capsule);
-    vec3 a = vec3(0,  0.5, 0) * capsule.data.y;
-    vec3 b = vec3(0, -0.5, 0) * capsule.data.y;
+float sdCapsule(vec3 p, vec4 data) {
+    vec3 a = vec3(0,  0.5, 0) * data.y;
+    vec3 b = vec3(0, -0.5, 0) * data.y;
     vec3 ab = b - a;
     vec3 ap = p - a;
     float t = clamp(dot(ab, ap) / dot(ab, ab), 0, 1);
-    return length(ap - ab * t) - capsule.data.x;
+    return length(ap - ab * t) - data.x;
 }
 
-float sdTorus(vec3 position, Primitive torus) {
-    vec3 p = TRANSFORM_POS(position, torus);
-    float x = length(p.xz) - torus.data.x;
-    return length(vec2(x, p.y)) - torus.data.y;
+float sdTorus(vec3 p, vec4 data) {
+    float x = length(p.xz) - data.x;
+    return length(vec2(x, p.y)) - data.y;
 }
 
-float sdBox(vec3 position, Primitive box) {
-    vec3  p = TRANSFORM_POS(position, box);
-    vec3  d = abs(p) - box.data.xyz + box.data.www;
+float sdBox(vec3 p, vec4 data) {
+    vec3  d = abs(p) - data.xyz + data.www;
     float e = length(max(d, 0.0));               // exterior distance
     float i = min(max(d.x, max(d.y, d.z)), 0.0); // interior distance
-    return e + i - box.data.w;
+    return e + i - data.w;
 }
 
-float sdCilinder(vec3 position, Primitive cilinder) {
-    vec3 p = TRANSFORM_POS(position, cilinder);
-    float w = cilinder.data.x - cilinder.data.z;
-    float h = cilinder.data.y - cilinder.data.z;
+float sdCilinder(vec3 p, vec4 data) {
+    float w = data.x - data.z;
+    float h = data.y - data.z;
     vec2  d = abs(vec2(length(p.xz), p.y)) - vec2(w, h);
-    return min(max(d.x, d.y), 0.0) + length(max(d, 0.0)) - cilinder.data.z;
+    return min(max(d.x, d.y), 0.0) + length(max(d, 0.0)) - data.z;
 }
 
-float sdCone(vec3 position, Primitive cone) {
-    float r1 = cone.data.x - cone.data.w;
-    float r2 = cone.data.y - cone.data.w;
-    float h  = cone.data.z - cone.data.w;
-    vec3  p  = TRANSFORM_POS(position, cone);
+float sdCone(vec3 p, vec4 data) {
+    float r1 = data.x - data.w;
+    float r2 = data.y - data.w;
+    float h  = data.z - data.w;
 
     vec2 q = vec2( length(p.xz), p.y );
     vec2 k1 = vec2(r2,h);
@@ -214,14 +249,13 @@ float sdCone(vec3 position, Primitive cone) {
     vec2 ca = vec2(q.x-min(q.x,(q.y<0.0)?r1:r2), abs(q.y)-h);
     vec2 cb = q - k1 + k2*clamp( dot(k1-q,k2)/dot(k2.xy, k2.xy), 0.0, 1.0 );
     float s = (cb.x<0.0 && ca.y<0.0) ? -1.0 : 1.0;
-    return s*sqrt( min(dot(ca.xy, ca.xy),dot(cb.xy, cb.xy)) ) - cone.data.w;
+    return s*sqrt( min(dot(ca.xy, ca.xy),dot(cb.xy, cb.xy)) ) - data.w;
 }
 
-float roundCone(vec3 position, Primitive roundCone) {
-    float r1 = roundCone.data.x;
-    float r2 = roundCone.data.y;
-    float h  = roundCone.data.z;
-    vec3  p  = TRANSFORM_POS(position, roundCone);
+float roundCone(vec3 p, vec4 data) {
+    float r1 = data.x;
+    float r2 = data.y;
+    float h  = data.z;
     p.y += h * 0.5;
 
     vec2 q = vec2( length(p.xz), p.y );
@@ -236,6 +270,37 @@ float roundCone(vec3 position, Primitive roundCone) {
     return dot(q, vec2(a,b) ) - r1;
 }
 
+float sdSphere(vec3 position, Primitive sphere)     { return sdSphere(TRANSFORM_POS(position, sphere), sphere.data); }
+float sdCapsule(vec3 position, Primitive capsule)   { return sdCapsule(TRANSFORM_POS(position, capsule), capsule.data); }
+float sdTorus(vec3 position, Primitive torus)       { return sdTorus(TRANSFORM_POS(position, torus), torus.data); }
+float sdBox(vec3 position, Primitive box)           { return sdBox(TRANSFORM_POS(position, box), box.data); }
+float sdCilinder(vec3 position, Primitive cilinder) { return sdCilinder(TRANSFORM_POS(position, cilinder), cilinder.data); }
+float sdCone(vec3 position, Primitive cone)         { return sdCone(TRANSFORM_POS(position, cone), cone.data); }
+float roundCone(vec3 position, Primitive cone)      { return roundCone(TRANSFORM_POS(position, cone), cone.data); }
+
+float sdBound(vec3 position, vec3 boundMin, vec3 boundMax) {
+    vec3 d = max(boundMin - position, position - boundMax);
+    return length(max(d, 0.0)) + min(max(d.x, max(d.y, d.z)), 0.0);
+}
+
+// trilinear interpolation of baked samples lowered by the interpolation error, negative outside of the volume
+float sdVolume(vec3 position, Model model) {
+    float last       = float(volumeResolution - 1);
+    vec3  volumeMin  = model.boundMin - VOLUME_MARGIN;
+    vec3  volumeSize = model.boundMax - model.boundMin + 2.0 * VOLUME_MARGIN;
+    vec3  texel      = (position - volumeMin) / volumeSize * last;
+    if (any(lessThan(texel, vec3(0))) || any(greaterThan(texel, vec3(last)))) {
+        return -1.0;
+    }
+
+    // samples are at texel centers, z stays inside the volume of the model so filtering does not mix volumes
+    vec3 atlasSize = vec3(volumeResolution, volumeResolution, volumeResolution * volumeCount);
+    vec3 uvw       = (texel + 0.5 + vec3(0, 0, model.volumeId * volumeResolution)) / atlasSize;
+
+    // for 1-Lipschitz SDF the interpolation error is at most half of the cell diagonal
+    return textureLod(sdfVolumes, uvw, 0.0).r - 0.5 * length(volumeSize) / last;
+}
+
 float sdBoundingBox(vec3 position, Primitive bBox, float thicness)
 {
     vec3 p = TRANSFORM_POS(position, bBox);
@@ -1,6 +1,5 @@
 
 #include <AABB.h>
-#include <map>
 #include <algorithm>
 
 #ifdef DEBUG
@@ -9,15 +8,29 @@
 
 using namespace std;
 
-BoundingBox AABBHierarchy::geometryBB(const std::string& geometryId) {
-    BoundingBox bb = {};
-    const auto& geometry = scene.geometries.at(geometryId);
-    for (const auto& primitive : geometry.primitives) {
-        if (primitive->operation == PrimitiveOperation::Add) {
-            bb = bb.add(bbForPrimitive(*primitive));
+// geometry bounds are computed once, instances of a geometry only transform them
+static vector<BoundingBox> computeGeometryBounds(const Scene& scene) {
+    vector<BoundingBox> bounds;
+    bounds.reserve(scene.geometryNames.size());
+    for (const auto& name : scene.geometryNames) {
+        BoundingBox bb = {};
+        for (const auto& primitive : scene.geometries.at(name).primitives) {
+            if (primitive->operation == PrimitiveOperation::Add) {
+                bb = bb.add(AABBHierarchy::bbForPrimitive(*primitive));
+            }
         }
+        bounds.push_back(bb);
+    }
+    return bounds;
+}
+
+// models with unknown geometry fall back to the first geometry as in prepareShaderModel, without geometries the box is empty
+BoundingBox AABBHierarchy::modelBB(const Model& model) const {
+    if (geometryBounds.empty()) {
+        return {};
     }
-    return bb;
+    bool knownGeometry = model.geometryHandle >= 0 && model.geometryHandle < int(geometryBounds.size());
+    return geometryBounds[knownGeometry ? model.geometryHandle : 0].transform(model.transform);
 }
 
 BoundingBox AABBHierarchy::bbForPrimitive(const Primitive& primitive) {
@@ -43,7 +56,7 @@ BoundingBox BoundingBox::transform(const Transform& tranform) const {
         { min.x, min.y, min.z, 1.0f },
     };
 
-    auto transformMatrix = glm::inverse(tranform.getTransform());
+    auto transformMatrix = tranform.getInverseTransform();
 
     BoundingBox bbRes = {};
     for (int i =0; i < 8; ++i) {
@@ -55,94 +68,229 @@ BoundingBox BoundingBox::transform(const Transform& tranform) const {
 }
 
 
-AABBHierarchy::AABBHierarchy(const Scene& scene) : scene(scene) {
+AABBHierarchy::AABBHierarchy(const Scene& scene) : geometryBounds(computeGeometryBounds(scene)), scene(scene) {
     rebuild();
 }
 
-using AABBNodeList = vector<std::shared_ptr<AABBNode>>;
+void AABBHierarchy::updateGeometryBounds() {
+    geometryBounds = computeGeometryBounds(scene);
+}
+
+// model box referenced during build
+struct BuildEntry {
+    BoundingBox box;
+    glm::vec3   center;
+    int         modelId;
+};
+
+// levels of balanced tree over count leaves below its root
+static int ceilLog2(size_t count) {
+    int levels = 0;
+    while ((size_t(1) << levels) < count) {
+        ++levels;
+    }
+    return levels;
+}
+
+/**
+ * Top-down binned SAH build over entries[begin, end) emitting nodes in depth-first order, see:
+ * https://www.sci.utah.edu/~wald/Publications/2007/ParallelBVHBuild/fastbuild.pdf
+ */
+void buildSAHNode(vector<BuildEntry>& entries, size_t begin, size_t end, int level, vector<BVHNode>& nodes, BVHBuildReport& report) {
+    report.depth = glm::max(report.depth, level + 1);
+
+    auto nodeIndex = nodes.size();
+    nodes.emplace_back();
+
+    if (end - begin == 1) {
+        nodes[nodeIndex].bbMin  = entries[begin].box.min;
+        nodes[nodeIndex].bbMax  = entries[begin].box.max;
+        nodes[nodeIndex].model  = entries[begin].modelId;
+        nodes[nodeIndex].escape = nodes.size();
+        return;
+    }
+
+    BoundingBox bounds         = {};
+    BoundingBox centroidBounds = {};
+    for (size_t i = begin; i < end; ++i) {
+        bounds         = bounds.add(entries[i].box);
+        centroidBounds = centroidBounds.add({ entries[i].center, entries[i].center });
+    }
 
-AABBNodeList mergeAABBNodeListInHalf(AABBNodeList nodes) {
+    // split along axis of the largest centroid extent
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    size_t middle = begin + (end - begin) / 2;
+    if (extent[axis] > 0.0f) {
+        constexpr int BINS = AABBHierarchy::SAH_BINS;
+        auto binOf = [&](const BuildEntry& entry) {
+            float relative = (entry.center[axis] - centroidBounds.min[axis]) / extent[axis];
+            return glm::min(int(relative * BINS), BINS - 1);
+        };
+
+        BoundingBox binBoxes[BINS] = {};
+        int         binCounts[BINS] = {};
+        for (size_t i = begin; i < end; ++i) {
+            int bin = binOf(entries[i]);
+            binBoxes[bin] = binBoxes[bin].add(entries[i].box);
+            ++binCounts[bin];
+        }
 
-    AABBNodeList result;
-    result.reserve(glm::ceil(nodes.size() / 2));
-    vector<bool> used(nodes.size(), false);
+        // sweep from the right to get cost of right parts, then from the left to evaluate splits after each bin
+        float       rightCosts[BINS] = {};
+        BoundingBox rightBox         = {};
+        int         rightCount       = 0;
+        for (int bin = BINS - 1; bin > 0; --bin) {
+            rightBox = rightBox.add(binBoxes[bin]);
+            rightCount += binCounts[bin];
+            rightCosts[bin - 1] = rightCount > 0 ? rightBox.area() * rightCount : 0.0f;
+        }
 
-    // compute pair distance
-    multimap<float, tuple<int, int>> distancePairs;
-    for (int actIndex = 0; actIndex < nodes.size(); ++actIndex) {
-        auto actNode = nodes[actIndex];
-        if (actIndex + 1 == nodes.size()) {
-            if (nodes.size() % 2 == 1) { // send the odd one to result directly
-                used[actIndex] = true;
-                result.push_back(actNode);
+        float       bestCost  = FLT_MAX;
+        int         bestSplit = -1;
+        BoundingBox leftBox   = {};
+        int         leftCount = 0;
+        for (int bin = 0; bin < BINS - 1; ++bin) {
+            leftBox = leftBox.add(binBoxes[bin]);
+            leftCount += binCounts[bin];
+            if (leftCount == 0 || leftCount == int(end - begin)) {
+                continue;
             }
-        } else {
-            for (int otherIndex = actIndex + 1; otherIndex < nodes.size(); ++otherIndex) {
-                auto other = nodes[otherIndex];
-                auto dist = actNode->distance(*other);
-                distancePairs.emplace(dist, make_tuple(actIndex, otherIndex));
+            float cost = leftBox.area() * leftCount + rightCosts[bin];
+            if (cost < bestCost) {
+                bestCost  = cost;
+                bestSplit = bin;
             }
         }
-    }
 
-    // get the closest pairs and create result list
-    for (const auto& pair : distancePairs) {
-        auto firstIndex = get<0>(pair.second);
-        auto secondIndex = get<1>(pair.second);
-        if (!used[firstIndex] && !used[secondIndex]) {
-            auto firstNode = nodes[firstIndex];
-            auto secondNode = nodes[secondIndex];
-            auto newNode = make_shared<AABBNode>();
-            newNode->box = firstNode->box.add(secondNode->box);
-            newNode->left = firstNode;
-            newNode->right = secondNode;
-            result.push_back(newNode);
-            used[firstIndex] = true;
-            used[secondIndex] = true;
-
-            // check if all indices were used.
-            if (all_of(used.begin(), used.end(), [](bool v) { return v; })) {
-                break;
-            }
+        if (bestSplit >= 0) {
+            auto splitIt = partition(entries.begin() + begin, entries.begin() + end, [&](const BuildEntry& entry) {
+                return binOf(entry) <= bestSplit;
+            });
+            middle = splitIt - entries.begin();
         }
     }
 
-    return move(result);
+    // median split keeps the depth within traversal stacks when SAH split leaves too few levels for the larger child
+    size_t largerChild = glm::max(middle - begin, end - middle);
+    if (level + 2 + ceilLog2(largerChild) > AABBHierarchy::MAX_DEPTH) {
+        middle = begin + (end - begin) / 2;
+        nth_element(entries.begin() + begin, entries.begin() + middle, entries.begin() + end, [&](const BuildEntry& a, const BuildEntry& b) {
+            return a.center[axis] < b.center[axis];
+        });
+    }
+
+    buildSAHNode(entries, begin, middle, level + 1, nodes, report);
+    buildSAHNode(entries, middle, end, level + 1, nodes, report);
+
+    nodes[nodeIndex].bbMin  = bounds.min;
+    nodes[nodeIndex].bbMax  = bounds.max;
+    nodes[nodeIndex].escape = nodes.size();
 }
 
-void AABBHierarchy::rebuild() {
+void AABBHierarchy::rebuild(const vector<bool>& removedModels) {
+    auto start = chrono::steady_clock::now();
 
-    AABBNodeList nodes;
+    vector<BuildEntry> entries;
+    entries.reserve(scene.models.size());
 
     int id = 0;
     for (const auto& model : scene.models) {
-        auto newNode = make_shared<AABBNode>();
-        newNode->box = geometryBB(model.geometryIdent).transform(model.transform);
-        newNode->modelId = id;
-        nodes.push_back(newNode);
+        if (id >= int(removedModels.size()) || !removedModels[id]) {
+            auto box = modelBB(model);
+            entries.push_back({ box, box.center(), id });
+        }
         ++id;
     }
-    while (nodes.size() > 1) {
-        nodes = mergeAABBNodeListInHalf(nodes);
+
+    report = {};
+    nodes.clear();
+    if (entries.empty()) {
+        nodes.emplace_back(); // empty root has an inverted box which intersectBB never hits
+        nodes.front().bbMin  = BoundingBox().min;
+        nodes.front().bbMax  = BoundingBox().max;
+        nodes.front().escape = 1;
+    } else {
+        nodes.reserve(entries.size() * 2 - 1);
+        buildSAHNode(entries, 0, entries.size(), 0, nodes, report);
+    }
+
+    // links for refitting
+    parents.assign(nodes.size(), -1);
+    leaves.assign(scene.models.size(), -1);
+    for (int index = 0; index < int(nodes.size()); ++index) {
+        if (nodes[index].isLeaf()) {
+            leaves[nodes[index].model] = index;
+        } else if (index + 1 < int(nodes.size())) {
+            parents[left(index)]  = index;
+            parents[right(index)] = index;
+        }
     }
 
-    root = nodes.front();
+    report.buildTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    report.nodeCount = nodes.size();
+
+    // expected cost relative to the root box
+    float rootArea = nodes.front().box().area();
+    for (const auto& node : nodes) {
+        float probability = rootArea > 0.0f ? node.box().area() / rootArea : 1.0f;
+        report.sahCost += probability * (node.isLeaf() ? MODEL_COST : TRAVERSAL_COST);
+    }
 }
 
-#ifdef DEBUG
+void AABBHierarchy::setLeaf(int nodeIndex, int modelId, const BoundingBox& box, vector<int>& changedNodes) {
+    nodes[nodeIndex].bbMin = box.min;
+    nodes[nodeIndex].bbMax = box.max;
+    nodes[nodeIndex].model = modelId;
+    changedNodes.push_back(nodeIndex);
 
-void AABBNode::debugPrint(int level) {
-    auto prefix = string(level * 2, ' ');
+    // ancestors are refitted until their box stays the same, empty box of removed leaf does not affect the union
+    for (int index = parents[nodeIndex]; index >= 0; index = parents[index]) {
+        auto fitted = nodes[left(index)].box().add(nodes[right(index)].box());
+        if (fitted.min == nodes[index].bbMin && fitted.max == nodes[index].bbMax) {
+            break;
+        }
+        nodes[index].bbMin = fitted.min;
+        nodes[index].bbMax = fitted.max;
+        changedNodes.push_back(index);
+    }
+}
 
-    if (left != nullptr) {
-        LOG_DEBUG(prefix << "Child 1:");
-        left->debugPrint(level + 1);
+bool AABBHierarchy::updateModel(int modelId, vector<int>& changedNodes) {
+    if (modelId >= int(leaves.size()) || leaves[modelId] < 0) {
+        return false;
     }
-    if (right != nullptr) {
-        LOG_DEBUG(prefix << "Child 2:");
-        right->debugPrint(level + 1);
+    const auto& model = scene.models[modelId];
+    setLeaf(leaves[modelId], modelId, modelBB(model), changedNodes);
+    return true;
+}
+
+bool AABBHierarchy::removeModel(int modelId, vector<int>& changedNodes) {
+    if (modelId >= int(leaves.size()) || leaves[modelId] < 0) {
+        return false;
     }
-    LOG_DEBUG(prefix << "BBCenter: " << glm::to_string(box.center()));
+    setLeaf(leaves[modelId], -1, {}, changedNodes);
+    return true;
 }
 
-#endif
\ No newline at end of file
+#ifdef DEBUG
+
+void AABBHierarchy::debugPrint() const {
+    vector<int> escapes; // escape indices of open subtrees give current level
+    for (int index = 0; index < int(nodes.size()); ++index) {
+        while (!escapes.empty() && escapes.back() <= index) {
+            escapes.pop_back();
+        }
+        auto prefix = string(escapes.size() * 2, ' ');
+        const auto& node = nodes[index];
+        if (node.isLeaf()) {
+            LOG_DEBUG(prefix << "Model " << node.model << " BBCenter: " << glm::to_string(node.box().center()));
+        } else {
+            LOG_DEBUG(prefix << "Node " << index << " BBCenter: " << glm::to_string(node.box().center()));
+        }
+        escapes.push_back(node.escape);
+    }
+}
+
+#endif
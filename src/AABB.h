@@ -3,6 +3,10 @@
 
 #include <scene/Scene.h>
 
+#include <chrono>
+#include <ostream>
+#include <vector>
+
 struct BoundingBox {
     glm::vec3 min = glm::vec3(FLT_MAX);
     glm::vec3 max = glm::vec3(-FLT_MAX);
@@ -13,36 +17,91 @@ struct BoundingBox {
     inline glm::vec3 center()                          const { return min + (max-min) / 2.0f; }
     inline BoundingBox add(const BoundingBox& otherBb) const { return { glm::min(min, otherBb.min), glm::max(max, otherBb.max) }; }
     inline float distance(const BoundingBox& otherBb)  const { return glm::distance(center(), otherBb.center()); }
+    inline float area()                                const { glm::vec3 d = glm::max(max - min, 0.0f); return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x); }
 
     BoundingBox transform(const Transform& transform)  const;
 };
 
 
-class AABBNode
-{
-    public:
-        std::shared_ptr<AABBNode> left = nullptr;
-        std::shared_ptr<AABBNode> right = nullptr;
-        BoundingBox box = {};
-        int modelId = -1;
+/**
+ * Node of flat BVH in depth-first order, layout is shared by GPU buffers (std140/std430 compatible) and the CPU renderer.
+ * Left child of internal node directly follows it, right child starts at escape index of the left child.
+ * Escape index points to the first node after the node's subtree, it equals node count for the last subtree.
+ */
+struct BVHNode {
+    glm::vec3 bbMin  = glm::vec3(0);
+    glm::i32  model  = -1; // model id for leaf, -1 for internal node
+    glm::vec3 bbMax  = glm::vec3(0);
+    glm::i32  escape = -1;
 
-        inline float distance(const AABBNode& other) const { return box.distance(other.box); }
+    inline bool        isLeaf() const { return model >= 0; }
+    inline BoundingBox box()    const { return { bbMin, bbMax }; }
+};
 
-        #ifdef DEBUG
-        void debugPrint(int level = 0);
-        #endif
+static_assert(sizeof(BVHNode) == 32, "BVHNode must match shader struct layout");
+
+struct BVHBuildReport {
+    std::chrono::microseconds buildTime = {};
+    int   nodeCount = 0;
+    int   depth     = 0;
+    float sahCost   = 0; // expected cost of tracing a random ray hitting the root box
 };
 
+inline std::ostream& operator<<(std::ostream& stream, const BVHBuildReport& report) {
+    return stream << "BVH: " << report.nodeCount << " nodes, depth " << report.depth
+                  << ", SAH cost " << report.sahCost << ", built in " << report.buildTime.count() << " us";
+}
+
 class AABBHierarchy
 {
     public:
-        std::shared_ptr<AABBNode> root;
+        // SAH cost of traversing node box and of marching a model in a leaf
+        static constexpr float TRAVERSAL_COST = 1.0f;
+        static constexpr float MODEL_COST     = 1.0f;
+        static constexpr int   SAH_BINS       = 16;
+        // levels of the tree, fixed traversal stacks of the renderers hold at most one node per level
+        static constexpr int   MAX_DEPTH      = 32;
+
+        std::vector<BVHNode> nodes   = {};
+        std::vector<int>     parents = {}; // parent node index, -1 for root
+        std::vector<int>     leaves  = {}; // leaf node index per model id, -1 when model is not in hierarchy
+        BVHBuildReport       report  = {};
 
         AABBHierarchy(const Scene& scene);
-        void rebuild();
 
-        BoundingBox geometryBB(const std::string& geometryId);
-        BoundingBox bbForPrimitive(const Primitive& primitive);
+        // models marked as removed are left out of the hierarchy
+        void rebuild(const std::vector<bool>& removedModels = {});
+
+        /**
+         * Refit of the model leaf and its ancestors after the model was moved, changed node indices are appended to changedNodes.
+         * Removed model keeps its leaf with empty box which is traversed as internal node without children, the leaf is reused by updateModel.
+         * Returns false when the model has no leaf and hierarchy has to be rebuilt.
+         */
+        bool updateModel(int modelId, std::vector<int>& changedNodes);
+        bool removeModel(int modelId, std::vector<int>& changedNodes);
+
+        // children of internal node at index
+        inline int left(int index)  const { return index + 1; }
+        inline int right(int index) const { return nodes[index + 1].escape; }
+
+        // recomputes boxes of geometries after their primitives changed, models using them have to be updated after
+        void updateGeometryBounds();
+
+        // box of geometry in its space by geometry handle, see Scene::internIdentifiers
+        inline const BoundingBox& geometryBB(int32_t geometryHandle) const { return geometryBounds[geometryHandle]; }
+
+        // box of model in world space
+        BoundingBox modelBB(const Model& model) const;
+
+        // box of primitive in space of its geometry
+        static BoundingBox bbForPrimitive(const Primitive& primitive);
+
+        #ifdef DEBUG
+        void debugPrint() const;
+        #endif
     private:
-        const Scene& scene;
+        std::vector<BoundingBox> geometryBounds; // per geometry handle
+        const Scene&             scene;
+
+        void setLeaf(int nodeIndex, int modelId, const BoundingBox& box, std::vector<int>& changedNodes);
 };
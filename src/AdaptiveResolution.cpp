@@ -0,0 +1,64 @@
+
+#include <AdaptiveResolution.h>
+
+#include <glm/glm.hpp>
+
+using namespace std;
+
+// rendered pixels an estimate is made from, times of a few small frames say more about fixed costs than about ray marching
+#define ESTIMATE_FRACTION 1.0
+
+AdaptiveFrame AdaptiveResolution::nextFrame() {
+    auto frame = AdaptiveFrame();
+    frame.type = AdaptiveFrameType::afPresent;
+
+    if (changed) {
+        changed      = false;
+        stillFrames  = 0;
+        refineStride = getRefineStride();
+        refinePhase  = 0;
+        frame.type   = AdaptiveFrameType::afMotion;
+        frame.scale  = getMotionScale();
+        complete     = frame.scale >= 1.0f; // full resolution motion frame needs no refinement
+    } else if (complete) {
+        // converged image is shown until something changes
+    } else if (stillFrames < options.settleFrames) {
+        // camera events come in bursts, refinement would restart on every one of them
+        ++stillFrames;
+    } else {
+        frame.type   = AdaptiveFrameType::afRefine;
+        frame.stride = refineStride;
+        frame.phase  = refinePhase++;
+        complete     = refinePhase == refineStride * refineStride;
+    }
+    return frame;
+}
+
+void AdaptiveResolution::addRenderTime(chrono::microseconds time, double fraction) {
+    reportTime     += time;
+    reportFraction += fraction;
+    if (reportFraction >= ESTIMATE_FRACTION) {
+        auto estimate = chrono::microseconds(int64_t(reportTime.count() / reportFraction));
+        fullFrameTime = fullFrameTime.count() > 0 ? (fullFrameTime + estimate) / 2 : estimate;
+        reportTime     = {};
+        reportFraction = 0;
+    }
+}
+
+// half resolution until frame time is known
+float AdaptiveResolution::getMotionScale() const {
+    if (fullFrameTime.count() <= 0) {
+        return 0.5f;
+    }
+    float scale = glm::sqrt(float(options.frameBudget.count()) / float(fullFrameTime.count()));
+    return glm::clamp(scale, options.minScale, 1.0f);
+}
+
+// smallest checkerboard whose single phase fits the budget
+uint32_t AdaptiveResolution::getRefineStride() const {
+    if (fullFrameTime.count() <= 0) {
+        return 2;
+    }
+    float stride = glm::ceil(glm::sqrt(float(fullFrameTime.count()) / float(options.frameBudget.count())));
+    return uint32_t(glm::clamp(stride, 1.0f, float(options.maxStride)));
+}
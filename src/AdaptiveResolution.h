@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+struct AdaptiveResolutionOptions {
+    std::chrono::microseconds frameBudget  = std::chrono::microseconds(16000); // render time of motion and refine frames
+    float                     minScale     = 0.25f; // lowest resolution scale of motion frames
+    uint32_t                  maxStride    = 4;     // refine frames render at least one of maxStride^2 pixels
+    uint32_t                  settleFrames = 2;     // frames without change before refinement starts
+};
+
+enum AdaptiveFrameType {
+    afMotion,  // whole image at reduced resolution which is upscaled
+    afRefine,  // one phase of full resolution checkerboard, stride^2 phases complete the image
+    afPresent, // nothing changed, last image is shown again
+};
+
+struct AdaptiveFrame {
+    AdaptiveFrameType type   = AdaptiveFrameType::afMotion;
+    float             scale  = 1; // resolution scale of motion frame
+    uint32_t          stride = 1; // checkerboard of refine frame
+    uint32_t          phase  = 0;
+
+    // fraction of full resolution pixels the frame renders
+    inline double pixelFraction() const {
+        return type == AdaptiveFrameType::afMotion ? scale * scale : type == AdaptiveFrameType::afRefine ? 1.0 / (stride * stride) : 0.0;
+    }
+};
+
+/**
+ * Decides what to render in each frame so that frames stay within budget while the camera or scene changes
+ * and still images converge to full quality.
+ * Cost of full resolution frame is estimated from GPU times of rendered frames and the fraction of pixels they rendered,
+ * so frame rate caps and frames which only present the last image do not count.
+ */
+class AdaptiveResolution
+{
+    public:
+        AdaptiveResolution(AdaptiveResolutionOptions options = {}) : options(options) {}
+
+        // camera, scene or target size changed so the image has to be rendered again
+        inline void invalidate() { changed = true; }
+
+        AdaptiveFrame nextFrame();
+
+        // GPU time of a motion or refine frame which rendered fraction of full resolution pixels
+        void addRenderTime(std::chrono::microseconds time, double fraction);
+
+        // 0 until frames rendered pixels of the whole image
+        inline std::chrono::microseconds getFullFrameTime() const { return fullFrameTime; }
+
+        float    getMotionScale() const;
+        uint32_t getRefineStride() const;
+
+    private:
+        AdaptiveResolutionOptions options;
+        std::chrono::microseconds fullFrameTime = {};
+
+        bool     changed      = true;
+        uint32_t stillFrames  = 0;
+        uint32_t refineStride = 1;
+        uint32_t refinePhase  = 0;
+        bool     complete     = false;
+
+        // since the last estimate
+        std::chrono::microseconds reportTime     = {};
+        double                    reportFraction = 0; // sum of rendered pixel fractions
+};
@@ -0,0 +1,24 @@
+#include <CommandLine.h>
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+unsigned long toUnsigned(const string& value) {
+    if (value.find('-') != string::npos) {
+        throw out_of_range(value);
+    }
+    return stoul(value);
+}
+
+bool parseArgumentValue(const string& arg, const string& value, const function<bool()>& parse) {
+    try {
+        return parse();
+    } catch (const invalid_argument&) {
+        cerr << "Invalid value " << value << " of argument " << arg << endl;
+    } catch (const out_of_range&) {
+        cerr << "Value " << value << " of argument " << arg << " is out of range" << endl;
+    }
+    return false;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+// stoul which rejects negative numbers instead of wrapping them around, throws invalid_argument or out_of_range as stoul
+unsigned long toUnsigned(const std::string& value);
+
+/**
+ * Calls parse which converts the value of the argument. Malformed and out of range values are reported to cerr
+ * and give false, otherwise the result of parse is returned, which reports its own errors such as unknown arguments.
+ */
+bool parseArgumentValue(const std::string& arg, const std::string& value, const std::function<bool()>& parse);
@@ -0,0 +1,156 @@
+
+#include <CompiledScene.h>
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char COMPILED_SCENE_MAGIC[8] = { 'P', 'R', 'G', 'S', 'C', 'E', 'N', 'E' };
+
+static uint64_t alignSection(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+template<typename T>
+static CompiledSceneSection makeSection(uint64_t& offset, const vector<T>& data) {
+    auto section = CompiledSceneSection{ alignSection(offset), data.size(), sizeof(T), 0 };
+    offset = section.offset + data.size() * sizeof(T);
+    return section;
+}
+
+template<typename T>
+static void writeSection(ofstream& stream, const CompiledSceneSection& section, const vector<T>& data) {
+    static const char zeros[16] = {};
+    stream.write(zeros, section.offset - uint64_t(stream.tellp()));
+    stream.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+}
+
+bool writeCompiledScene(const string& file, const ShaderSceneData& data) {
+    auto header = CompiledSceneHeader();
+    memcpy(header.magic, COMPILED_SCENE_MAGIC, sizeof(header.magic));
+    header.version      = COMPILED_SCENE_VERSION;
+    header.sectionCount = 5;
+
+    uint64_t offset = sizeof(CompiledSceneHeader);
+    header.primitives = makeSection(offset, data.primitives);
+    header.materials  = makeSection(offset, data.materials);
+    header.models     = makeSection(offset, data.models);
+    header.bvh        = makeSection(offset, data.bvh);
+    header.volumes    = makeSection(offset, data.volumes.distances);
+    header.bvhDepth   = data.bvhReport.depth;
+    header.bvhSahCost = data.bvhReport.sahCost;
+    header.volumeResolution = data.volumes.resolution;
+    header.volumeCount      = data.volumes.count;
+
+    ofstream stream(file, ios::binary | ios::trunc);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(stream, header.primitives, data.primitives);
+    writeSection(stream, header.materials,  data.materials);
+    writeSection(stream, header.models,     data.models);
+    writeSection(stream, header.bvh,        data.bvh);
+    writeSection(stream, header.volumes,    data.volumes.distances);
+    return stream.good();
+}
+
+CompiledScene::CompiledScene(const string& file) {
+    #ifdef _WIN32
+    ifstream stream(file, ios::binary | ios::ate);
+    if (!stream.good()) {
+        errorMessage = "Cannot open compiled scene " + file;
+        return;
+    }
+    size = size_t(stream.tellg());
+    auto buffer = new uint8_t[size];
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(buffer), size);
+    mapping = buffer;
+    #else
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        errorMessage = "Cannot open compiled scene " + file;
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        size = size_t(info.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        mapping = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapped);
+    }
+    close(fd);
+    if (mapping == nullptr) {
+        size = 0;
+        errorMessage = "Cannot map compiled scene " + file;
+        return;
+    }
+    #endif
+
+    if (size < sizeof(CompiledSceneHeader) || memcmp(header()->magic, COMPILED_SCENE_MAGIC, sizeof(COMPILED_SCENE_MAGIC)) != 0) {
+        errorMessage = file + " is not a compiled scene";
+        return;
+    }
+    if (header()->version != COMPILED_SCENE_VERSION) {
+        errorMessage = file + " has version " + to_string(header()->version) + ", expected " + to_string(COMPILED_SCENE_VERSION) + ", compile the scene again";
+        return;
+    }
+    if (!mapSection(header()->primitives, primitives) || !mapSection(header()->materials, materials)
+        || !mapSection(header()->models, models) || !mapSection(header()->bvh, bvh) || !mapSection(header()->volumes, volumes)
+        || volumes.count != size_t(header()->volumeResolution) * header()->volumeResolution * header()->volumeResolution * header()->volumeCount) {
+        errorMessage = file + " is corrupted";
+        return;
+    }
+    if (header()->bvhDepth > AABBHierarchy::MAX_DEPTH) {
+        errorMessage = file + " has BVH deeper than " + to_string(AABBHierarchy::MAX_DEPTH) + " levels, compile the scene again";
+    }
+}
+
+CompiledScene::~CompiledScene() {
+    #ifdef _WIN32
+    delete[] mapping;
+    #else
+    if (mapping != nullptr) {
+        munmap(const_cast<uint8_t*>(mapping), size);
+    }
+    #endif
+}
+
+template<typename T>
+bool CompiledScene::mapSection(const CompiledSceneSection& section, ArrayView<T>& view) {
+    if (section.elementSize != sizeof(T) || section.offset % 16 != 0 || section.offset > size
+        || section.count > (size - section.offset) / sizeof(T)) {
+        return false;
+    }
+    view.data  = reinterpret_cast<const T*>(mapping + section.offset);
+    view.count = section.count;
+    return true;
+}
+
+BVHBuildReport CompiledScene::getBVHReport() const {
+    auto report      = BVHBuildReport();
+    report.nodeCount = bvh.count;
+    report.depth     = header()->bvhDepth;
+    report.sahCost   = header()->bvhSahCost;
+    return report;
+}
+
+ShaderSceneData CompiledScene::toShaderSceneData() const {
+    auto data = ShaderSceneData();
+    data.primitives.assign(primitives.begin(), primitives.end());
+    data.materials.assign(materials.begin(), materials.end());
+    data.models.assign(models.begin(), models.end());
+    data.bvh.assign(bvh.begin(), bvh.end());
+    data.bvhReport           = getBVHReport();
+    data.volumes.resolution  = header()->volumeResolution;
+    data.volumes.count       = header()->volumeCount;
+    data.volumes.distances.assign(volumes.begin(), volumes.end());
+    return data;
+}
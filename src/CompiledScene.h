@@ -0,0 +1,99 @@
+#pragma once
+
+#include <sceneUtils.h>
+
+#include <cstdint>
+#include <string>
+
+#define COMPILED_SCENE_EXTENSION ".prgscene"
+#define COMPILED_SCENE_VERSION   4
+
+// read only array inside of mapped file
+template<typename T>
+struct ArrayView {
+    const T* data  = nullptr;
+    size_t   count = 0;
+
+    inline size_t   byteSize()            const { return count * sizeof(T); }
+    inline const T* begin()               const { return data; }
+    inline const T* end()                 const { return data + count; }
+    inline const T& operator[](size_t i)  const { return data[i]; }
+};
+
+/**
+ * Scene compiled to the final shader arrays, file layout is:
+ *   CompiledSceneHeader | primitives | materials | models | bvh | baked SDF volumes
+ * every section starts at 16 byte aligned offset and holds structs exactly as they are uploaded to GPU.
+ */
+struct CompiledSceneSection {
+    uint64_t offset;
+    uint64_t count;
+    uint32_t elementSize;
+    uint32_t padding;
+};
+
+struct CompiledSceneHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+
+    CompiledSceneSection primitives;
+    CompiledSceneSection materials;
+    CompiledSceneSection models;
+    CompiledSceneSection bvh;
+    CompiledSceneSection volumes;
+
+    int32_t  bvhDepth;
+    float    bvhSahCost;
+    uint32_t volumeResolution;
+    uint32_t volumeCount;
+};
+
+// writes shader data of a scene, false on I/O error
+bool writeCompiledScene(const std::string& file, const ShaderSceneData& data);
+
+inline bool isCompiledSceneFile(const std::string& file) {
+    std::string extension = COMPILED_SCENE_EXTENSION;
+    return file.size() >= extension.size() && file.compare(file.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+/**
+ * Compiled scene mapped to memory, arrays point directly into the mapping and are valid while the object lives.
+ */
+class CompiledScene
+{
+    public:
+        CompiledScene(const std::string& file);
+        ~CompiledScene();
+
+        CompiledScene(const CompiledScene&) = delete;
+        CompiledScene& operator=(const CompiledScene&) = delete;
+
+        inline bool               isValid()         const { return errorMessage.empty(); }
+        inline const std::string& getErrorMessage() const { return errorMessage; }
+
+        ArrayView<ShaderPrimitive> primitives;
+        ArrayView<ShaderMaterial>  materials;
+        ArrayView<ShaderModel>     models;
+        ArrayView<BVHNode>         bvh;
+        ArrayView<float>           volumes; // see SdfVolumeAtlas
+
+        inline uint32_t getVolumeResolution() const { return header()->volumeResolution; }
+        inline uint32_t getVolumeCount()      const { return header()->volumeCount; }
+
+        // depth and SAH cost stored at compilation, build time is not known
+        BVHBuildReport getBVHReport() const;
+
+        // copy for consumers owning their data such as the CPU renderer
+        ShaderSceneData toShaderSceneData() const;
+
+    private:
+        const uint8_t* mapping = nullptr;
+        size_t         size    = 0;
+        std::string    errorMessage;
+
+        const CompiledSceneHeader* header() const { return reinterpret_cast<const CompiledSceneHeader*>(mapping); }
+
+        template<typename T>
+        bool mapSection(const CompiledSceneSection& section, ArrayView<T>& view);
+};
@@ -0,0 +1,240 @@
+
+#include <DynamicScene.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace std;
+
+// merges sorted unique indices to ranges of consecutive elements
+template<typename It>
+static vector<DirtyRange> toRanges(It begin, It end) {
+    vector<DirtyRange> ranges;
+    for (auto it = begin; it != end; ++it) {
+        uint32_t index = *it;
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == index) {
+            ++ranges.back().count;
+        } else {
+            ranges.push_back({ index, 1 });
+        }
+    }
+    return ranges;
+}
+
+DynamicScene::DynamicScene(unique_ptr<Scene> scene) :
+    scene(move(scene)),
+    hierarchy(*this->scene),
+    data(prepareShaderSceneData(*this->scene, hierarchy)),
+    removed(this->scene->models.size(), false) {}
+
+void DynamicScene::moveModel(uint32_t modelId, const Transform& transform) {
+    scene->models[modelId].transform = transform;
+    dirtyModels.insert(modelId);
+}
+
+uint32_t DynamicScene::addModel(const Model& model) {
+    uint32_t modelId;
+    if (!freeModels.empty()) {
+        modelId = freeModels.back();
+        freeModels.pop_back();
+        scene->models[modelId] = model;
+        removed[modelId]       = false;
+        scene->intern(scene->models[modelId]);
+    } else {
+        modelId = scene->models.size();
+        scene->models.push_back(model);
+        scene->intern(scene->models.back());
+        data.models.emplace_back();
+        removed.push_back(false);
+        rebuildHierarchy = true;
+    }
+    dirtyModels.insert(modelId);
+    return modelId;
+}
+
+void DynamicScene::removeModel(uint32_t modelId) {
+    if (removed[modelId]) {
+        return;
+    }
+    removed[modelId] = true;
+    freeModels.push_back(modelId);
+    dirtyModels.insert(modelId);
+}
+
+static bool sameTransform(const Transform& a, const Transform& b) {
+    return a.position == b.position && a.rotation == b.rotation && a.size == b.size;
+}
+
+// consecutive positions of a game change a few models and refit the BVH, added models reuse slots of removed ones
+void DynamicScene::setModels(const vector<Model>& models) {
+    // live models by geometry and material in descending order, popped from the back they keep the ids of an unchanged board
+    auto live = map<pair<string, string>, vector<uint32_t>>();
+    for (uint32_t modelId = scene->models.size(); modelId-- > 0;) {
+        if (!removed[modelId]) {
+            live[{ scene->models[modelId].geometryIdent, scene->models[modelId].materialIdent }].push_back(modelId);
+        }
+    }
+
+    auto added = vector<const Model*>();
+    for (const auto& model : models) {
+        auto candidates = live.find({ model.geometryIdent, model.materialIdent });
+        if (candidates == live.end() || candidates->second.empty()) {
+            added.push_back(&model);
+            continue;
+        }
+        uint32_t modelId = candidates->second.back();
+        candidates->second.pop_back();
+        if (!sameTransform(scene->models[modelId].transform, model.transform)) {
+            moveModel(modelId, model.transform);
+        }
+    }
+
+    // removed first so that added models take their slots
+    for (const auto& [key, modelIds] : live) {
+        for (auto modelId : modelIds) {
+            removeModel(modelId);
+        }
+    }
+    for (const auto* model : added) {
+        addModel(*model);
+    }
+}
+
+ostream& operator<<(ostream& stream, const SceneReload& reload) {
+    if (reload.full) {
+        return stream << "Scene reload: full";
+    }
+    auto count = [](const vector<DirtyRange>& ranges) {
+        size_t total = 0;
+        for (const auto& range : ranges) {
+            total += range.count;
+        }
+        return total;
+    };
+    return stream << "Scene reload: " << count(reload.materials) << " materials, " << count(reload.primitives) << " primitives of "
+                  << reload.geometries.size() << " geometries";
+}
+
+template<typename T>
+static bool sameBytes(const T& a, const T& b) {
+    return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+bool DynamicScene::needsFullReload(const Scene& edited) const {
+    bool full = edited.geometryNames != scene->geometryNames || edited.materialNames != scene->materialNames;
+    for (size_t handle = 0; handle < edited.geometryNames.size() && !full; ++handle) {
+        full = edited.geometries.at(edited.geometryNames[handle]).primitives.size() != data.geometryRanges[handle].y;
+    }
+    return full;
+}
+
+vector<ShaderPrimitive> DynamicScene::reloadedPrimitives(const Scene& edited) const {
+    auto primitives = data.primitives;
+    for (size_t handle = 0; handle < edited.geometryNames.size(); ++handle) {
+        const auto& edits = edited.geometries.at(edited.geometryNames[handle]).primitives;
+        uint32_t    first = data.geometryRanges[handle].x;
+        for (uint32_t i = 0; i < edits.size(); ++i) {
+            primitives[first + i] = prepareShaderPrimitive(*edits[i]);
+        }
+    }
+    return primitives;
+}
+
+SceneReload DynamicScene::reload(const Scene& edited) {
+    auto result = SceneReload();
+    result.full = needsFullReload(edited);
+    if (result.full) {
+        return result;
+    }
+
+    // handles are indices to the shader arrays, so changed records are rewritten in place
+    auto changedMaterials = vector<uint32_t>();
+    for (uint32_t handle = 0; handle < edited.materialNames.size(); ++handle) {
+        const auto& name     = edited.materialNames[handle];
+        auto        material = prepareShaderMaterial(edited.materials.at(name));
+        if (!sameBytes(material, data.materials[handle])) {
+            data.materials[handle] = material;
+            scene->materials[name] = edited.materials.at(name);
+            changedMaterials.push_back(handle);
+        }
+    }
+    result.materials = toRanges(changedMaterials.begin(), changedMaterials.end());
+
+    auto changedPrimitives = vector<uint32_t>();
+    for (int32_t handle = 0; handle < int32_t(edited.geometryNames.size()); ++handle) {
+        const auto& name       = edited.geometryNames[handle];
+        const auto& primitives = edited.geometries.at(name).primitives;
+        uint32_t    first      = data.geometryRanges[handle].x;
+        bool        changed    = false;
+        for (uint32_t i = 0; i < primitives.size(); ++i) {
+            auto primitive = prepareShaderPrimitive(*primitives[i]);
+            if (!sameBytes(primitive, data.primitives[first + i])) {
+                data.primitives[first + i] = primitive;
+                changedPrimitives.push_back(first + i);
+                changed = true;
+            }
+        }
+        if (changed) {
+            scene->geometries.at(name)   = edited.geometries.at(name);
+            data.geometryVolumes[handle] = -1; // baked for the old primitives
+            result.geometries.push_back(handle);
+        }
+    }
+    result.primitives = toRanges(changedPrimitives.begin(), changedPrimitives.end());
+
+    // models of changed geometries get new bounds and volume, their leaves are refitted by update
+    if (!result.geometries.empty()) {
+        hierarchy.updateGeometryBounds();
+        for (auto handle : result.geometries) {
+            data.geometryBounds[handle] = hierarchy.geometryBB(handle);
+        }
+        for (uint32_t modelId = 0; modelId < scene->models.size(); ++modelId) {
+            auto handle = max(scene->models[modelId].geometryHandle, 0); // unknown geometry falls back to the first one
+            if (!removed[modelId] && find(result.geometries.begin(), result.geometries.end(), handle) != result.geometries.end()) {
+                dirtyModels.insert(modelId);
+            }
+        }
+    }
+
+    setModels(edited.models);
+    return result;
+}
+
+SceneUpdate DynamicScene::update() {
+    auto result = SceneUpdate();
+
+    for (auto modelId : dirtyModels) {
+        if (!removed[modelId]) {
+            data.models[modelId] = prepareShaderModel(scene->models[modelId], data);
+        }
+    }
+
+    vector<int> changedNodes;
+    for (auto modelId : dirtyModels) {
+        if (rebuildHierarchy) {
+            break;
+        }
+        bool refitted = removed[modelId] ? hierarchy.removeModel(modelId, changedNodes) : hierarchy.updateModel(modelId, changedNodes);
+        rebuildHierarchy = !refitted;
+    }
+
+    if (rebuildHierarchy) {
+        hierarchy.rebuild(removed);
+        data.bvh          = hierarchy.nodes;
+        data.bvhReport    = hierarchy.report;
+        result.reallocate = true;
+        rebuildHierarchy  = false;
+    } else {
+        sort(changedNodes.begin(), changedNodes.end());
+        changedNodes.erase(unique(changedNodes.begin(), changedNodes.end()), changedNodes.end());
+        for (int index : changedNodes) {
+            data.bvh[index] = hierarchy.nodes[index];
+        }
+        result.models = toRanges(dirtyModels.begin(), dirtyModels.end());
+        result.bvh    = toRanges(changedNodes.begin(), changedNodes.end());
+    }
+
+    dirtyModels.clear();
+    return result;
+}
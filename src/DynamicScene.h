@@ -0,0 +1,90 @@
+#pragma once
+
+#include <scene/Scene.h>
+#include <sceneUtils.h>
+#include <SdfVolume.h>
+#include <AABB.h>
+
+#include <memory>
+#include <ostream>
+#include <set>
+#include <vector>
+
+// elements [first, first + count) of a scene buffer
+struct DirtyRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// changes applied by DynamicScene::reload besides models, which are updated by DynamicScene::update
+struct SceneReload {
+    bool                    full = false; // geometries or materials were added or removed, or a geometry changed its primitive count
+    std::vector<DirtyRange> materials;
+    std::vector<DirtyRange> primitives;
+    std::vector<int32_t>    geometries; // handles of geometries with changed primitives
+};
+
+std::ostream& operator<<(std::ostream& stream, const SceneReload& reload);
+
+struct SceneUpdate {
+    std::vector<DirtyRange> models;
+    std::vector<DirtyRange> bvh;
+    bool reallocate = false; // buffers changed size and have to be uploaded whole
+};
+
+/**
+ * Scene with models changing at runtime, keeps shader data in sync and collects changed buffer ranges.
+ * Moved and removed models refit the BVH in O(log n). Added models reuse slots of removed ones,
+ * only when there is none the model buffer grows and the BVH is rebuilt.
+ */
+class DynamicScene
+{
+    public:
+        DynamicScene(std::unique_ptr<Scene> scene);
+
+        DynamicScene(const DynamicScene&) = delete;
+        DynamicScene& operator=(const DynamicScene&) = delete;
+
+        inline const Scene&           getScene() const { return *scene; }
+        inline const ShaderSceneData& getData()  const { return data; }
+
+        void     moveModel(uint32_t modelId, const Transform& transform);
+        uint32_t addModel(const Model& model); // handles of the model are resolved from its identifiers
+        void     removeModel(uint32_t modelId);
+
+        // replaces live models by the given ones, a model keeping its geometry and material is only moved
+        void setModels(const std::vector<Model>& models);
+
+        /**
+         * Takes edits of the scene: changed materials and primitives are rewritten in place, models of changed geometries
+         * are refitted and models are replaced as by setModels. Baked volumes of changed geometries are dropped.
+         * Nothing is applied when the result is full, the edited scene then has to be loaded anew.
+         */
+        SceneReload reload(const Scene& edited);
+
+        // reload of the edited scene would not be applied, see SceneReload::full
+        bool needsFullReload(const Scene& edited) const;
+
+        // shader primitives as reload of the edited scene would leave them, without applying anything,
+        // e.g. to generate SDF code before the reload, edited must not need a full reload
+        std::vector<ShaderPrimitive> reloadedPrimitives(const Scene& edited) const;
+
+        // bakes volumes of scene geometries, models added later use them as well
+        inline SdfVolumeBakeReport bakeVolumes(const SdfVolumeOptions& options) { return bakeSdfVolumes(data, options); }
+
+        inline bool isRemoved(uint32_t modelId) const { return removed[modelId]; }
+        inline bool hasChanges()                const { return !dirtyModels.empty(); }
+
+        // applies pending changes to shader data
+        SceneUpdate update();
+
+    private:
+        std::unique_ptr<Scene> scene;
+        AABBHierarchy          hierarchy;
+        ShaderSceneData        data;
+
+        std::vector<bool>     removed;
+        std::vector<uint32_t> freeModels;
+        std::set<uint32_t>    dirtyModels;
+        bool                  rebuildHierarchy = false;
+};
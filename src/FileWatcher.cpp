@@ -0,0 +1,98 @@
+
+#include <FileWatcher.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static string normalizedPath(const string& file) {
+    error_code error;
+    auto path = filesystem::absolute(file, error);
+    return (error ? filesystem::path(file) : path).lexically_normal().string();
+}
+
+FileWatcher::FileWatcher(chrono::milliseconds debounce) : debounce(debounce) {
+    #ifdef __linux__
+    inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    #endif
+}
+
+FileWatcher::~FileWatcher() {
+    #ifdef __linux__
+    if (inotify >= 0) {
+        close(inotify);
+    }
+    #endif
+}
+
+bool FileWatcher::watch(const string& file) {
+    auto path = normalizedPath(file);
+    #ifdef __linux__
+    auto directory = filesystem::path(path).parent_path().string();
+    int  descriptor = inotify < 0 ? -1 : inotify_add_watch(inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (descriptor < 0) {
+        return false;
+    }
+    directories[descriptor] = directory;
+    #else
+    error_code error;
+    writeTimes[path] = filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    #endif
+    files[path] = file;
+    return true;
+}
+
+// marks changed files as pending, every change restarts the debounce interval of its file
+void FileWatcher::readEvents() {
+    auto now = Clock::now();
+    #ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        auto length = read(inotify, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break; // EAGAIN when there are no more events
+        }
+        for (char* event = buffer; event < buffer + length;) {
+            auto* info = reinterpret_cast<inotify_event*>(event);
+            auto  directory = directories.find(info->wd);
+            if (directory != directories.end() && info->len > 0) {
+                auto changed = files.find((filesystem::path(directory->second) / info->name).string());
+                if (changed != files.end()) {
+                    pending[changed->second] = now;
+                }
+            }
+            event += sizeof(inotify_event) + info->len;
+        }
+    }
+    #else
+    for (auto& [path, writeTime] : writeTimes) {
+        error_code error;
+        auto time = filesystem::last_write_time(path, error);
+        if (!error && time != writeTime) {
+            writeTime            = time;
+            pending[files[path]] = now;
+        }
+    }
+    #endif
+}
+
+vector<string> FileWatcher::poll() {
+    readEvents();
+    auto settled = vector<string>();
+    auto now     = Clock::now();
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (now - it->second >= debounce) {
+            settled.push_back(it->first);
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return settled;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Reports watched files changed on disk. Directories of the files are watched, so editors saving by rename
+ * or by deleting and recreating the file are noticed as well. A change is reported once no other change of the file
+ * came for the debounce interval, so a save touching the file several times triggers one reload.
+ * Uses inotify on Linux, elsewhere modification times are compared on every poll.
+ */
+class FileWatcher
+{
+    public:
+        FileWatcher(std::chrono::milliseconds debounce = std::chrono::milliseconds(20));
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+
+        // false when the directory of the file cannot be watched
+        bool watch(const std::string& file);
+
+        // files whose changes settled, never blocks
+        std::vector<std::string> poll();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        std::chrono::milliseconds                debounce;
+        std::map<std::string, std::string>       files;   // absolute normalized path, path as given to watch
+        std::map<std::string, Clock::time_point> pending; // changed file as given to watch, time of its last change
+
+        #ifdef __linux__
+        int                        inotify = -1;
+        std::map<int, std::string> directories; // watch descriptor, directory
+        #else
+        std::map<std::string, std::filesystem::file_time_type> writeTimes;
+        #endif
+
+        void readEvents();
+};
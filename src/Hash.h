@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// FNV-1a, hashes of the shader program cache and of the baked SDF volume cache start with this basis
+constexpr uint64_t HASH_BASIS = 0xcbf29ce484222325ull;
+
+// FNV-1a
+inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint64_t hashString(uint64_t hash, const std::string& value) {
+    return hashBytes(hash, value.data(), value.size() + 1); // terminator separates consecutive strings
+}
@@ -0,0 +1,141 @@
+
+#include <PixelCounters.h>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+using json = nlohmann::json;
+
+const char* pixelCounterName(PixelCounter counter) {
+    switch (counter) {
+        case PixelCounter::pcSteps:         return "steps";
+        case PixelCounter::pcSdfCalls:      return "sdf_calls";
+        case PixelCounter::pcNodeVisits:    return "node_visits";
+        case PixelCounter::pcSecondaryRays: return "secondary_rays";
+    }
+    return "unknown";
+}
+
+uint64_t PixelCounters::total(PixelCounter counter) const {
+    uint64_t sum = 0;
+    for (size_t i = counter; i < values.size(); i += PIXEL_COUNTER_COUNT) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+CounterHistogram computeHistogram(const PixelCounters& counters, PixelCounter counter, uint32_t bucketCount) {
+    auto histogram    = CounterHistogram();
+    histogram.counter = counter;
+
+    auto samples = vector<uint32_t>();
+    samples.reserve(counters.values.size() / PIXEL_COUNTER_COUNT);
+    for (size_t i = counter; i < counters.values.size(); i += PIXEL_COUNTER_COUNT) {
+        samples.push_back(counters.values[i]);
+    }
+    if (samples.empty() || bucketCount == 0) {
+        return histogram;
+    }
+
+    sort(samples.begin(), samples.end());
+    for (auto value : samples) {
+        histogram.total += value;
+    }
+
+    // nearest rank, same as computeTimingStats of the benchmark
+    auto percentile = [&](double p) {
+        auto rank = size_t(max(1.0, ceil(p / 100.0 * samples.size())));
+        return samples[min(rank, samples.size()) - 1];
+    };
+    histogram.mean = double(histogram.total) / samples.size();
+    histogram.max  = samples.back();
+    histogram.p50  = percentile(50);
+    histogram.p90  = percentile(90);
+    histogram.p99  = percentile(99);
+
+    histogram.bucketWidth = max(1u, (histogram.max + bucketCount) / bucketCount);
+    histogram.buckets.assign(histogram.max / histogram.bucketWidth + 1, 0);
+    for (auto value : samples) {
+        ++histogram.buckets[value / histogram.bucketWidth];
+    }
+    return histogram;
+}
+
+ostream& operator<<(ostream& stream, const CounterHistogram& histogram) {
+    auto flags = stream.flags();
+    stream << left << setw(16) << pixelCounterName(histogram.counter) << right << fixed << setprecision(2)
+           << " mean " << setw(8) << histogram.mean
+           << "  p50 " << setw(6) << histogram.p50
+           << "  p90 " << setw(6) << histogram.p90
+           << "  p99 " << setw(6) << histogram.p99
+           << "  max " << setw(6) << histogram.max;
+    stream.flags(flags);
+    return stream;
+}
+
+// blue, green, yellow, red in equal thirds
+static glm::vec3 heatColor(float t) {
+    static const glm::vec3 ramp[] = {
+        { 0.0f, 0.0f, 0.5f },
+        { 0.0f, 0.8f, 0.2f },
+        { 1.0f, 0.9f, 0.0f },
+        { 1.0f, 0.0f, 0.0f },
+    };
+    t = glm::clamp(t, 0.0f, 1.0f) * 3.0f;
+    auto i = min(int(t), 2);
+    return glm::mix(ramp[i], ramp[i + 1], t - float(i));
+}
+
+Image counterHeatmap(const PixelCounters& counters, PixelCounter counter, uint32_t maxValue) {
+    if (maxValue == 0) {
+        // p99 keeps a few outliers from darkening the whole map
+        maxValue = max(1u, computeHistogram(counters, counter).p99);
+    }
+    auto image = Image(counters.width, counters.height);
+    for (uint32_t y = 0; y < counters.height; ++y) {
+        for (uint32_t x = 0; x < counters.width; ++x) {
+            image.setPixel(x, y, heatColor(float(counters.at(x, y, counter)) / float(maxValue)));
+        }
+    }
+    return image;
+}
+
+bool writePixelCounters(const PixelCounters& counters, const string& prefix) {
+    auto report = json {
+        { "width",    counters.width },
+        { "height",   counters.height },
+        { "counters", json::object() },
+    };
+
+    bool success = true;
+    for (uint32_t i = 0; i < PIXEL_COUNTER_COUNT; ++i) {
+        auto counter   = PixelCounter(i);
+        auto histogram = computeHistogram(counters, counter);
+        auto heatmap   = prefix + "_" + pixelCounterName(counter) + ".png";
+        success = counterHeatmap(counters, counter, max(1u, histogram.p99)).writePNG(heatmap) && success;
+
+        report["counters"][pixelCounterName(counter)] = {
+            { "total",       histogram.total },
+            { "mean",        histogram.mean },
+            { "max",         histogram.max },
+            { "p50",         histogram.p50 },
+            { "p90",         histogram.p90 },
+            { "p99",         histogram.p99 },
+            { "bucketWidth", histogram.bucketWidth },
+            { "buckets",     histogram.buckets },
+            { "heatmap",     heatmap },
+        };
+    }
+
+    ofstream stream(prefix + "_counters.json", ios::trunc);
+    if (!stream.good()) {
+        return false;
+    }
+    stream << report.dump(4) << "\n";
+    return success && stream.good();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cpu/Image.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum PixelCounter {
+    pcSteps         = 0, // marching steps of all rays and of depth prepass cones
+    pcSdfCalls      = 1, // sdModel evaluations, steps and normal samples
+    pcNodeVisits    = 2, // BVH node boxes tested
+    pcSecondaryRays = 3, // shadow and reflection rays
+};
+
+static constexpr uint32_t PIXEL_COUNTER_COUNT = 4;
+
+const char* pixelCounterName(PixelCounter counter);
+
+/**
+ * Work done for every pixel of one frame, filled by instrumented renders of SceneRenderer and CpuRenderer.
+ * Rows go top-down as in Image and counters of a pixel are stored together, same layout as PixelCountersBlock of fragment.fs.
+ * Depth prepass work of a cell is accounted to its corner pixel, the bottom-left one on GL and the top-left one on CPU.
+ */
+struct PixelCounters {
+    uint32_t              width  = 0;
+    uint32_t              height = 0;
+    std::vector<uint32_t> values = {};
+
+    PixelCounters() {}
+    PixelCounters(uint32_t width, uint32_t height) : width(width), height(height), values(size_t(width) * height * PIXEL_COUNTER_COUNT, 0) {}
+
+    inline uint32_t& at(uint32_t x, uint32_t y, PixelCounter counter)       { return values[(size_t(y) * width + x) * PIXEL_COUNTER_COUNT + counter]; }
+    inline uint32_t  at(uint32_t x, uint32_t y, PixelCounter counter) const { return values[(size_t(y) * width + x) * PIXEL_COUNTER_COUNT + counter]; }
+
+    uint64_t total(PixelCounter counter) const;
+};
+
+struct CounterHistogram {
+    PixelCounter counter     = PixelCounter::pcSteps;
+    uint64_t     total       = 0;
+    double       mean        = 0;
+    uint32_t     max         = 0;
+    uint32_t     p50         = 0;
+    uint32_t     p90         = 0;
+    uint32_t     p99         = 0;
+    uint32_t     bucketWidth = 1;
+    std::vector<uint32_t> buckets = {}; // pixel count of values in [i * bucketWidth, (i + 1) * bucketWidth)
+};
+
+CounterHistogram computeHistogram(const PixelCounters& counters, PixelCounter counter, uint32_t bucketCount = 32);
+
+// name, mean, percentiles and maximum on one line
+std::ostream& operator<<(std::ostream& stream, const CounterHistogram& histogram);
+
+// false colors from blue at 0 over green and yellow to red at maxValue, maxValue 0 takes p99 of the counter
+Image counterHeatmap(const PixelCounters& counters, PixelCounter counter, uint32_t maxValue = 0);
+
+/**
+ * Heatmap of every counter to <prefix>_<counter>.png and histograms to <prefix>_counters.json,
+ * false when some file cannot be written.
+ */
+bool writePixelCounters(const PixelCounters& counters, const std::string& prefix);
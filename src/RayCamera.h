@@ -0,0 +1,32 @@
+#pragma once
+
+#include <RenderBase/tools/camera.h>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+
+/**
+ * Camera as seen by the ray marcher - the exact values which are fed into camera uniforms of fragment.fs.
+ */
+struct RayCamera {
+    glm::vec3 position;
+    glm::vec3 direction;
+    glm::vec3 upRayDistorsion;
+    glm::vec3 leftRayDistorsion;
+
+    static inline RayCamera fromCamera(const std::shared_ptr<rb::Camera>& camera) {
+        float fovTangent = glm::tan(camera->getFov() / 2.0f);
+        return {
+            camera->getPosition(),
+            camera->getDirection(),
+            camera->getOrientationUp()   * fovTangent,
+            camera->getOrientationLeft() * fovTangent * camera->getAspectRatio(),
+        };
+    }
+
+    // ray direction for fragCoord in <-1, 1> range as computed by main() of fragment.fs
+    inline glm::vec3 rayDirection(glm::vec2 fragCoord) const {
+        return glm::normalize(direction + fragCoord.y * upRayDistorsion + fragCoord.x * leftRayDistorsion);
+    }
+};
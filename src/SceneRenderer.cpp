@@ -0,0 +1,619 @@
+
+#include <SceneRenderer.h>
+#include <CompiledScene.h>
+#include <SdfCodegen.h>
+
+#include <algorithm>
+#include <array>
+#include <exception>
+
+using namespace std;
+
+static chrono::microseconds since(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+}
+
+ostream& operator<<(ostream& stream, const SceneLoadReport& report) {
+    return stream << "Scene loaded in " << report.total.count() / 1000.0 << " ms"
+                  << " (parse " << report.parse.count() / 1000.0 << " ms, prepare " << report.prepare.count() / 1000.0
+                  << " ms, bake " << report.bake.count() / 1000.0 << " ms, upload " << report.upload.count() / 1000.0 << " ms)";
+}
+
+SceneRenderer::SceneRenderer() : geometrySdfSource(generateGeometrySdfGlsl({})) {
+    glCreateVertexArrays(1, &vao);
+    glCreateQueries(GL_TIME_ELAPSED, FRAME_QUERIES, timerQueries);
+    statsBuffer = make_unique<ShaderStorageBuffer>(vector<TraversalStats>(1));
+}
+
+SceneRenderer::~SceneRenderer() {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteQueries(FRAME_QUERIES, timerQueries);
+    glDeleteFramebuffers(2, frameBuffers);
+    glDeleteTextures(2, frameTextures);
+    glDeleteTextures(2, historyTextures);
+    glDeleteTextures(1, &prepassTexture);
+}
+
+bool SceneRenderer::loadProgram() {
+    return linkProgram(geometrySdfSource);
+}
+
+// the given geometry SDF becomes the current one only when the program links, otherwise nothing changes
+bool SceneRenderer::linkProgram(const string& sdfSource) {
+    auto loaded = programCache.get({
+        { GL_VERTEX_SHADER,   RESOURCE_SHADERS_VERTEX_VS },
+        { GL_FRAGMENT_SHADER, RESOURCE_SHADERS_PRIMITIVE_SDF_FS },
+        { GL_FRAGMENT_SHADER, RESOURCE_SHADERS_FRAGMENT_FS },
+        { GL_FRAGMENT_SHADER, "", sdfSource },
+    });
+    if (loaded == nullptr) {
+        errorMessage = programCache.getErrorMessage();
+        return false;
+    }
+    program           = loaded;
+    geometrySdfSource = sdfSource;
+    adaptiveResolution.invalidate();
+    historyValid = false;
+    return true;
+}
+
+// buffer of a scene loaded in the background, filled from prepared data by chunks
+struct BufferUpload {
+    ShaderStorageBuffer* buffer;
+    const uint8_t*       data;
+    size_t               size;
+    size_t               uploaded = 0;
+};
+
+// volumes of a scene loaded in the background, filled by z-slices
+struct VolumeUpload {
+    VolumeTexture* texture   = nullptr;
+    const float*   distances = nullptr;
+    uint32_t       sliceSize = 0; // distances in one slice
+    uint32_t       slices    = 0;
+    uint32_t       uploaded  = 0;
+};
+
+/**
+ * CPU side of a load without any GL call, so that it can run on a background thread. Json scenes are parsed,
+ * prepared and baked, compiled scenes are mapped. Buffers are then created on the GL thread, filled at once
+ * or chunk by chunk while the current scene is drawn.
+ */
+struct PreparedScene {
+    unique_ptr<DynamicScene>  scene;    // json scene
+    unique_ptr<CompiledScene> compiled; // compiled scene, stays mapped until it is uploaded
+    string                    geometrySdfSource;
+    string                    errorMessage;
+    SceneLoadReport           report;
+
+    SceneBuffers         buffers; // back buffers of a load in the background
+    vector<BufferUpload> uploads;
+    VolumeUpload         volumeUpload;
+};
+
+static unique_ptr<PreparedScene> prepareScene(const string& file, const SceneLoadOptions& options) {
+    auto  prepared = make_unique<PreparedScene>();
+    auto& report   = prepared->report;
+    auto  start    = chrono::steady_clock::now();
+
+    if (isCompiledSceneFile(file)) {
+        prepared->compiled = make_unique<CompiledScene>(file);
+        const auto& compiled = *prepared->compiled;
+        if (!compiled.isValid()) {
+            prepared->errorMessage = compiled.getErrorMessage();
+            return prepared;
+        }
+        report.parse = since(start);
+        report.bvh   = compiled.getBVHReport();
+        prepared->geometrySdfSource = generateGeometrySdfGlsl(options.specializeSdf ? foldGeometries(compiled.primitives, compiled.models) : vector<FoldedGeometry>());
+        return prepared;
+    }
+
+    try {
+        auto jsonScene = buildSceneFromJson(file);
+        if (options.modelCount > 0) {
+            replicateModels(*jsonScene, options.modelCount);
+        }
+        report.parse = since(start);
+
+        start = chrono::steady_clock::now();
+        prepared->scene = make_unique<DynamicScene>(move(jsonScene));
+        report.prepare  = since(start);
+    } catch (const exception& e) {
+        prepared->errorMessage = e.what();
+        return prepared;
+    }
+
+    if (options.sdfResolution > 0) {
+        auto volumeOptions       = SdfVolumeOptions();
+        volumeOptions.resolution = options.sdfResolution;
+        report.bake              = prepared->scene->bakeVolumes(volumeOptions).duration;
+    }
+
+    const auto& data = prepared->scene->getData();
+    prepared->geometrySdfSource = generateGeometrySdfGlsl(options.specializeSdf ? foldGeometries(data) : vector<FoldedGeometry>());
+    report.bvh = data.bvhReport;
+    return prepared;
+}
+
+template<typename T>
+static pair<const void*, size_t> bytesOf(const vector<T>& data) {
+    return { data.data(), data.size() * sizeof(T) };
+}
+
+// buffers and volumes are filled at once, or only allocated and filled by uploadChunk
+static void createBuffers(PreparedScene& prepared, bool fill) {
+    auto& buffers   = prepared.buffers;
+    auto  sources   = array<pair<const void*, size_t>, 4>();
+    auto  distances = static_cast<const float*>(nullptr);
+    if (prepared.compiled != nullptr) {
+        const auto& compiled = *prepared.compiled;
+        sources = { {
+            { compiled.primitives.data, compiled.primitives.byteSize() },
+            { compiled.materials.data,  compiled.materials.byteSize()  },
+            { compiled.models.data,     compiled.models.byteSize()     },
+            { compiled.bvh.data,        compiled.bvh.byteSize()        },
+        } };
+        distances                = compiled.volumes.data;
+        buffers.volumeResolution = compiled.getVolumeResolution();
+        buffers.volumeCount      = compiled.getVolumeCount();
+    } else {
+        const auto& data = prepared.scene->getData();
+        sources = { bytesOf(data.primitives), bytesOf(data.materials), bytesOf(data.models), bytesOf(data.bvh) };
+        distances                = data.volumes.distances.data();
+        buffers.volumeResolution = data.volumes.resolution;
+        buffers.volumeCount      = data.volumes.count;
+    }
+
+    buffers.volumes = make_unique<VolumeTexture>(fill ? distances : nullptr, buffers.volumeResolution, buffers.volumeCount);
+    if (!fill && buffers.volumeCount > 0) {
+        auto& upload     = prepared.volumeUpload;
+        upload.texture   = buffers.volumes.get();
+        upload.distances = distances;
+        upload.sliceSize = buffers.volumeResolution * buffers.volumeResolution;
+        upload.slices    = buffers.volumeResolution * buffers.volumeCount;
+    }
+
+    unique_ptr<ShaderStorageBuffer>* targets[] = { &buffers.primitives, &buffers.materials, &buffers.models, &buffers.bvh };
+    for (size_t i = 0; i < sources.size(); ++i) {
+        auto [data, size] = sources[i];
+        *targets[i] = make_unique<ShaderStorageBuffer>(fill ? data : nullptr, size);
+        if (!fill && size > 0) {
+            prepared.uploads.push_back({ targets[i]->get(), static_cast<const uint8_t*>(data), size });
+        }
+    }
+}
+
+// uploads at most budget bytes, true when all buffers and volumes are filled
+static bool uploadChunk(PreparedScene& prepared, size_t budget) {
+    for (auto& upload : prepared.uploads) {
+        size_t size = min(upload.size - upload.uploaded, budget);
+        if (size > 0) {
+            upload.buffer->update(upload.uploaded, upload.data + upload.uploaded, size);
+            upload.uploaded += size;
+            budget          -= size;
+        }
+        if (upload.uploaded < upload.size) {
+            return false;
+        }
+    }
+
+    // whole slices only, at least one per chunk so that a slice larger than the budget still gets uploaded
+    auto&  volumes    = prepared.volumeUpload;
+    size_t sliceBytes = size_t(volumes.sliceSize) * sizeof(float);
+    if (volumes.uploaded < volumes.slices && budget > 0) {
+        auto count = uint32_t(min(size_t(volumes.slices - volumes.uploaded), max(budget / sliceBytes, size_t(1))));
+        volumes.texture->update(volumes.uploaded, volumes.distances + size_t(volumes.uploaded) * volumes.sliceSize, count);
+        volumes.uploaded += count;
+    }
+    return volumes.uploaded == volumes.slices;
+}
+
+bool SceneRenderer::loadScene(const string& file, const SceneLoadOptions& options) {
+    auto start = chrono::steady_clock::now();
+    loadReport = {};
+    errorMessage.clear();
+
+    auto prepared = prepareScene(file, options);
+    if (!prepared->errorMessage.empty()) {
+        errorMessage = prepared->errorMessage;
+        return false;
+    }
+    auto uploadStart = chrono::steady_clock::now();
+    createBuffers(*prepared, true);
+    prepared->report.upload = since(uploadStart);
+
+    bool swapped = swapScene(*prepared);
+    loadReport.total = since(start);
+    return swapped;
+}
+
+bool SceneRenderer::loadSceneAsync(const string& file, const SceneLoadOptions& options) {
+    if (loadState == SceneLoadState::slPreparing || loadState == SceneLoadState::slUploading) {
+        return false;
+    }
+    loadStart = chrono::steady_clock::now();
+    loadState = SceneLoadState::slPreparing;
+    preparing = async(launch::async, prepareScene, file, options);
+    return true;
+}
+
+// one step of the load started by loadSceneAsync per draw, so that no frame waits for more than one chunk of upload
+void SceneRenderer::continueAsyncLoad() {
+    if (loadState == SceneLoadState::slPreparing) {
+        if (preparing.wait_for(chrono::seconds(0)) != future_status::ready) {
+            return;
+        }
+        uploading = preparing.get();
+        if (!uploading->errorMessage.empty()) {
+            errorMessage = uploading->errorMessage;
+            uploading    = nullptr;
+            loadState    = SceneLoadState::slFailed;
+            return;
+        }
+        auto start = chrono::steady_clock::now();
+        createBuffers(*uploading, false);
+        uploading->report.upload = since(start);
+        loadState = SceneLoadState::slUploading;
+    }
+
+    if (loadState == SceneLoadState::slUploading) {
+        auto start    = chrono::steady_clock::now();
+        bool uploaded = uploadChunk(*uploading, ASYNC_UPLOAD_BUDGET);
+        uploading->report.upload += since(start);
+        if (!uploaded) {
+            return;
+        }
+        errorMessage.clear();
+        bool swapped = swapScene(*uploading);
+        loadReport.total = since(loadStart);
+        uploading = nullptr;
+        loadState = swapped ? SceneLoadState::slLoaded : SceneLoadState::slFailed;
+    }
+}
+
+bool SceneRenderer::reloadScene(const string& file, const SceneLoadOptions& options, SceneReload& reload) {
+    reload = SceneReload();
+    if (scene == nullptr || isCompiledSceneFile(file)) {
+        reload.full = true; // compiled scenes are static
+        return true;
+    }
+    errorMessage.clear();
+
+    auto edited = unique_ptr<Scene>();
+    try {
+        edited = buildSceneFromJson(file);
+        if (options.modelCount > 0) {
+            replicateModels(*edited, options.modelCount);
+        }
+    } catch (const exception& e) {
+        errorMessage = e.what();
+        return false;
+    }
+    if (scene->needsFullReload(*edited)) {
+        reload.full = true;
+        return true;
+    }
+
+    // primitive data are literals of the generated geometry SDF, the program is linked before anything is applied
+    // so that a link failure leaves the scene and the program in sync
+    const auto& data = scene->getData();
+    if (options.specializeSdf) {
+        auto primitives = scene->reloadedPrimitives(*edited);
+        auto sdfSource  = generateGeometrySdfGlsl(foldGeometries(
+            { primitives.data(), primitives.size() }, { data.models.data(), data.models.size() }, data.geometryNames, data.geometryRanges
+        ));
+        if (sdfSource != geometrySdfSource && !linkProgram(sdfSource)) {
+            return false;
+        }
+    }
+
+    reload = scene->reload(*edited);
+    for (const auto& range : reload.materials) {
+        buffers.materials->update(data.materials, range.first, range.count);
+    }
+    for (const auto& range : reload.primitives) {
+        buffers.primitives->update(data.primitives, range.first, range.count);
+    }
+    adaptiveResolution.invalidate();
+    historyValid = false;
+    return true;
+}
+
+// filled back buffers become the drawn ones, program is relinked first when the generated geometry SDF changed
+// so that the current scene and its buffers stay drawn when linking fails
+bool SceneRenderer::swapScene(PreparedScene& prepared) {
+    if (program != nullptr && prepared.geometrySdfSource != geometrySdfSource && !linkProgram(prepared.geometrySdfSource)) {
+        return false;
+    }
+    scene             = move(prepared.scene);
+    buffers           = move(prepared.buffers);
+    geometrySdfSource = prepared.geometrySdfSource;
+    loadReport        = prepared.report;
+    bindSceneData();
+    adaptiveResolution.invalidate();
+    historyValid = false;
+    return true;
+}
+
+// binding points are fixed in shaders
+void SceneRenderer::bindSceneData() const {
+    buffers.primitives->bind(0);
+    buffers.materials->bind(1);
+    buffers.models->bind(2);
+    buffers.bvh->bind(3);
+    buffers.volumes->bind(0);
+}
+
+// uploads only changed models and BVH nodes, whole buffers when the BVH was rebuilt
+void SceneRenderer::uploadSceneChanges() {
+    auto update = scene->update();
+    const auto& data = scene->getData();
+    if (update.reallocate) {
+        buffers.models = make_unique<ShaderStorageBuffer>(data.models);
+        buffers.bvh    = make_unique<ShaderStorageBuffer>(data.bvh);
+        buffers.models->bind(2);
+        buffers.bvh->bind(3);
+        return;
+    }
+    for (const auto& range : update.models) {
+        buffers.models->update(data.models, range.first, range.count);
+    }
+    for (const auto& range : update.bvh) {
+        buffers.bvh->update(data.bvh, range.first, range.count);
+    }
+}
+
+void SceneRenderer::setAdaptiveResolution(bool enabled, const AdaptiveResolutionOptions& options) {
+    adaptive           = enabled;
+    adaptiveResolution = AdaptiveResolution(options);
+}
+
+void SceneRenderer::setReprojection(bool enabled) {
+    reprojection = enabled;
+    historyValid = false;
+}
+
+void SceneRenderer::draw() {
+    if (loadState == SceneLoadState::slPreparing || loadState == SceneLoadState::slUploading) {
+        continueAsyncLoad();
+    }
+    if (scene != nullptr && scene->hasChanges()) {
+        uploadSceneChanges();
+        adaptiveResolution.invalidate();
+        historyValid = false;
+    }
+
+    // uniforms are cheap to set every frame and stay valid when the program is replaced by reload
+    program->uniform("cameraPosition",    camera.position);
+    program->uniform("cameraDirection",   camera.direction);
+    program->uniform("upRayDistorsion",   camera.upRayDistorsion);
+    program->uniform("leftRayDistorsion", camera.leftRayDistorsion);
+    program->uniform("lightPosition",     lightPosition);
+    program->uniform("penumbraFactor",    penumbraFactor);
+    program->uniform("volumeResolution",  int(buffers.volumeResolution));
+    program->uniform("volumeCount",       int(buffers.volumeCount));
+    program->uniform("pixelStride",       1);
+    program->uniform("pixelPhase",        0);
+    program->uniform("prepass",           0);
+    program->uniform("collectStats",      int(traversalStats));
+    if (traversalStats) {
+        auto stats = TraversalStats();
+        statsBuffer->update(0, &stats, sizeof(stats));
+        statsBuffer->bind(4);
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    program->uniform("collectCounters", int(pixelCounters));
+    if (pixelCounters) {
+        bindPixelCounters(glm::uvec2(viewport[2], viewport[3]));
+    }
+
+    program->use();
+    glBindVertexArray(vao);
+    if (adaptive && !pixelCounters) { // counters describe a full resolution frame
+        drawAdaptive();
+        return;
+    }
+    glClear(GL_COLOR_BUFFER_BIT);
+    drawQuad(glm::uvec2(viewport[2], viewport[3]), true);
+}
+
+TraversalStats SceneRenderer::getTraversalStats() const {
+    auto stats = TraversalStats();
+    if (traversalStats) {
+        statsBuffer->read(0, &stats, sizeof(stats));
+    }
+    return stats;
+}
+
+// buffer is allocated for the viewport and cleared before every draw
+void SceneRenderer::bindPixelCounters(glm::uvec2 size) {
+    if (counterBuffer == nullptr || size != counterSize) {
+        counterBuffer = make_unique<ShaderStorageBuffer>(nullptr, size_t(size.x) * size.y * PIXEL_COUNTER_COUNT * sizeof(uint32_t));
+        counterSize   = size;
+    }
+    counterBuffer->clear();
+    counterBuffer->bind(5);
+    program->uniform("counterSize", glm::ivec2(size));
+}
+
+PixelCounters SceneRenderer::getPixelCounters() const {
+    if (!pixelCounters || counterBuffer == nullptr) {
+        return {};
+    }
+    auto counters = PixelCounters(counterSize.x, counterSize.y);
+    counterBuffer->read(0, counters.values.data(), counters.values.size() * sizeof(uint32_t));
+    return counters;
+}
+
+// viewport is the pass of given size, prepass and history are bound around it when enabled
+void SceneRenderer::drawQuad(glm::uvec2 size, bool writesHistory) {
+    program->uniform("depthPrepass", int(depthPrepass));
+    program->uniform("reprojection", int(reprojection));
+    if (depthPrepass) {
+        drawPrepass(size);
+    }
+    if (reprojection) {
+        bindHistory(size);
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    if (reprojection && writesHistory) {
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        historyIndex  = 1 - historyIndex;
+        historySize   = size;
+        historyCamera = camera;
+        historyValid  = true;
+    }
+}
+
+// one fragment per cell of the pass is cone marched, the prepass texture is then read by the pass
+void SceneRenderer::drawPrepass(glm::uvec2 size) {
+    auto cells = (size + PREPASS_CELL_SIZE - 1u) / PREPASS_CELL_SIZE;
+    if (cells.x > prepassTextureSize.x || cells.y > prepassTextureSize.y) {
+        glDeleteTextures(1, &prepassTexture);
+        glCreateTextures(GL_TEXTURE_2D, 1, &prepassTexture);
+        glTextureStorage2D(prepassTexture, 1, GL_R32F, cells.x, cells.y);
+        prepassTextureSize = cells;
+    }
+
+    GLint     viewport[4];
+    GLboolean colorMask[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+
+    program->uniform("prepass",         1);
+    program->uniform("prepassCellSize", int(PREPASS_CELL_SIZE));
+    program->uniform("prepassSize",     glm::ivec2(size));
+    glBindImageTexture(2, prepassTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glViewport(0, 0, cells.x, cells.y);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    program->uniform("prepass", 0);
+    glBindTextureUnit(2, prepassTexture);
+}
+
+// hits of the previous frame are read from one history texture while the other one is written
+void SceneRenderer::bindHistory(glm::uvec2 size) {
+    if (size.x > historyTextureSize.x || size.y > historyTextureSize.y) {
+        glDeleteTextures(2, historyTextures);
+        glCreateTextures(GL_TEXTURE_2D, 2, historyTextures);
+        for (int i = 0; i < 2; ++i) {
+            glTextureStorage2D(historyTextures[i], 1, GL_RG32F, size.x, size.y);
+        }
+        historyTextureSize = size;
+        historyValid       = false;
+    }
+    program->uniform("historyValid",             int(historyValid));
+    program->uniform("historySize",              glm::ivec2(historySize));
+    program->uniform("historyCameraPosition",    historyCamera.position);
+    program->uniform("historyCameraDirection",   historyCamera.direction);
+    program->uniform("historyUpRayDistorsion",   historyCamera.upRayDistorsion);
+    program->uniform("historyLeftRayDistorsion", historyCamera.leftRayDistorsion);
+    glBindTextureUnit(1, historyTextures[1 - historyIndex]);
+    glBindImageTexture(1, historyTextures[historyIndex], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+}
+
+/**
+ * Motion frames are upscaled by linear filtering. Refinement starts from the upscaled motion frame
+ * and overwrites one checkerboard phase of its pixels per frame, the last phase leaves the exact full resolution image.
+ * Phases are drawn as a grid of blocks rather than by discarding pixels, so a phase costs 1 / stride^2 of a full frame.
+ */
+void SceneRenderer::drawAdaptive() {
+    GLint target = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    auto size = glm::uvec2(viewport[2], viewport[3]);
+    if (size != frameSize) {
+        resizeFrameTextures(size);
+        adaptiveResolution.invalidate();
+    }
+
+    // only rendering is timed, frames which present the last image again and the final blit are not
+    readFrameTimes();
+    auto frame = adaptiveResolution.nextFrame();
+    auto query = find(begin(queryFractions), end(queryFractions), 0.0) - begin(queryFractions);
+    bool timed = frame.type != AdaptiveFrameType::afPresent && query < FRAME_QUERIES;
+    if (timed) {
+        glBeginQuery(GL_TIME_ELAPSED, timerQueries[query]);
+    }
+
+    if (frame.type == AdaptiveFrameType::afMotion) {
+        lowResSize = glm::max(glm::uvec2(glm::vec2(size) * frame.scale), glm::uvec2(1));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffers[0]);
+        glViewport(0, 0, lowResSize.x, lowResSize.y);
+        drawQuad(lowResSize, true);
+        presentLowRes = true;
+    } else if (frame.type == AdaptiveFrameType::afRefine && frame.stride == 1) {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffers[1]);
+        glViewport(0, 0, size.x, size.y);
+        drawQuad(size, true);
+        presentLowRes = false;
+    } else if (frame.type == AdaptiveFrameType::afRefine) {
+        if (frame.phase == 0) {
+            glBlitNamedFramebuffer(frameBuffers[0], frameBuffers[1], 0, 0, lowResSize.x, lowResSize.y,
+                                   0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
+        // one fragment per block of the full resolution image, which is written by imageStore
+        auto blocks = (size + frame.stride - 1u) / frame.stride;
+        program->uniform("pixelStride", int(frame.stride));
+        program->uniform("pixelPhase",  int(frame.phase));
+        program->uniform("refineSize",  glm::ivec2(size));
+        glBindImageTexture(0, frameTextures[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffers[0]);
+        glViewport(0, 0, blocks.x, blocks.y);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        drawQuad(size, false); // history is only read by checkerboard phases
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+        presentLowRes = false;
+    }
+
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryFractions[query] = frame.pixelFraction();
+    }
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    auto source = presentLowRes ? lowResSize : size;
+    glBlitNamedFramebuffer(frameBuffers[presentLowRes ? 0 : 1], target, 0, 0, source.x, source.y,
+                           viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+                           GL_COLOR_BUFFER_BIT, presentLowRes ? GL_LINEAR : GL_NEAREST);
+}
+
+// results of finished timer queries go to the frame time estimate, queries still running are left for later frames
+void SceneRenderer::readFrameTimes() {
+    for (int i = 0; i < FRAME_QUERIES; ++i) {
+        GLint available = GL_FALSE;
+        if (queryFractions[i] > 0) {
+            glGetQueryObjectiv(timerQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (available == GL_TRUE) {
+            GLuint64 time = 0;
+            glGetQueryObjectui64v(timerQueries[i], GL_QUERY_RESULT, &time);
+            adaptiveResolution.addRenderTime(chrono::microseconds(time / 1000), queryFractions[i]);
+            queryFractions[i] = 0;
+        }
+    }
+}
+
+void SceneRenderer::resizeFrameTextures(glm::uvec2 size) {
+    glDeleteFramebuffers(2, frameBuffers);
+    glDeleteTextures(2, frameTextures);
+    glCreateTextures(GL_TEXTURE_2D, 2, frameTextures);
+    glCreateFramebuffers(2, frameBuffers);
+    for (int i = 0; i < 2; ++i) {
+        glTextureStorage2D(frameTextures[i], 1, GL_RGBA8, size.x, size.y);
+        glNamedFramebufferTexture(frameBuffers[i], GL_COLOR_ATTACHMENT0, frameTextures[i], 0);
+    }
+    frameSize = size;
+}
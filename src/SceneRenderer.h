@@ -0,0 +1,213 @@
+#pragma once
+
+#include <ShaderProgramCache.h>
+#include <ShaderStorageBuffer.h>
+#include <VolumeTexture.h>
+#include <DynamicScene.h>
+#include <RayCamera.h>
+#include <AdaptiveResolution.h>
+#include <PixelCounters.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <string>
+
+struct SceneLoadOptions {
+    size_t   modelCount    = 0;    // replicate models of json scene to this count when set
+    uint32_t sdfResolution = 0;    // bake SDF volumes of json scene with this resolution when set
+    bool     specializeSdf = true; // geometries are evaluated by generated functions, see SdfCodegen.h
+};
+
+struct SceneLoadReport {
+    std::chrono::microseconds parse   = {}; // json parsing or mapping of compiled scene
+    std::chrono::microseconds prepare = {}; // BVH build and shader data preparation
+    std::chrono::microseconds bake    = {}; // SDF volumes
+    std::chrono::microseconds upload  = {};
+    std::chrono::microseconds total   = {};
+    BVHBuildReport            bvh;
+};
+
+std::ostream& operator<<(std::ostream& stream, const SceneLoadReport& report);
+
+enum SceneLoadState {
+    slIdle      = 0, // no load was started by loadSceneAsync
+    slPreparing = 1, // parsed, prepared and baked on a background thread
+    slUploading = 2, // uploaded to the back buffers by draws
+    slLoaded    = 3, // swapped in, see getLoadReport
+    slFailed    = 4, // the previous scene stays, see getErrorMessage
+};
+
+// GPU copy of scene data, a scene loaded in the background is uploaded to a second set while the current one is drawn
+struct SceneBuffers {
+    std::unique_ptr<ShaderStorageBuffer> primitives;
+    std::unique_ptr<ShaderStorageBuffer> materials;
+    std::unique_ptr<ShaderStorageBuffer> models;
+    std::unique_ptr<ShaderStorageBuffer> bvh;
+    std::unique_ptr<VolumeTexture>       volumes;
+    glm::u32                             volumeResolution = 0;
+    glm::u32                             volumeCount      = 0;
+};
+
+struct PreparedScene; // scene data ready for upload, see SceneRenderer.cpp
+
+// BVH traversal counters of one draw summed over all fragments
+struct TraversalStats {
+    uint32_t rays       = 0; // primary, reflection and shadow rays
+    uint32_t nodeVisits = 0; // node boxes tested by the rays and by cones of the depth prepass
+
+    inline double nodeVisitsPerRay() const { return rays > 0 ? double(nodeVisits) / double(rays) : 0.0; }
+};
+
+/**
+ * Ray marches scene with GL into currently bound framebuffer, owns the program and all scene GPU data.
+ * Json scenes are kept in DynamicScene and their changes are uploaded before drawing, compiled scenes are static.
+ * With adaptive resolution frames are rendered to own textures, see AdaptiveResolution, and copied to the framebuffer.
+ */
+class SceneRenderer
+{
+    public:
+        static constexpr uint32_t PREPASS_CELL_SIZE = 8; // pixels along side of a cone of the depth prepass
+
+        static constexpr size_t ASYNC_UPLOAD_BUDGET = 4 << 20; // bytes uploaded by one draw while a scene loads in the background
+
+        SceneRenderer();
+        ~SceneRenderer();
+
+        SceneRenderer(const SceneRenderer&) = delete;
+        SceneRenderer& operator=(const SceneRenderer&) = delete;
+
+        // program is compiled only when shader sources changed, false on error see getErrorMessage
+        bool loadProgram();
+
+        // json or compiled scene, program is reloaded when the generated geometry SDF changed, false on error see getErrorMessage
+        bool loadScene(const std::string& file, const SceneLoadOptions& options = {});
+
+        // same as loadScene but the scene is prepared on a background thread and uploaded by following draws,
+        // which draw the current scene until the new one is swapped in at the start of a draw, see getLoadState.
+        // False when another load is still in progress.
+        bool loadSceneAsync(const std::string& file, const SceneLoadOptions& options = {});
+
+        inline SceneLoadState getLoadState() const { return loadState; }
+
+        /**
+         * Takes edits of the json scene loaded from the file, see DynamicScene::reload. Changed materials and primitives
+         * are uploaded in place and models on the next draw, the program is relinked only when the generated geometry SDF changed.
+         * When reload is full nothing was applied and the scene has to be loaded again. False on error see getErrorMessage,
+         * edits are applied only after the program linked, so the error leaves the current scene drawn as it was.
+         */
+        bool reloadScene(const std::string& file, const SceneLoadOptions& options, SceneReload& reload);
+
+        inline void setCamera(const RayCamera& camera)    { this->camera = camera; adaptiveResolution.invalidate(); }
+        inline void setLightPosition(glm::vec3 position)  { lightPosition = position; adaptiveResolution.invalidate(); }
+
+        // 0 (default) for hard shadows, otherwise k of soft shadows min(k * distance / t) where larger k gives sharper penumbra
+        inline void setPenumbraFactor(float factor) { penumbraFactor = factor; adaptiveResolution.invalidate(); }
+
+        // disabled by default, every frame then marches all pixels
+        void setAdaptiveResolution(bool enabled, const AdaptiveResolutionOptions& options = {});
+
+        // disabled by default, primary rays then start near hits of the previous frame reprojected to the current camera,
+        // expects viewport at the origin of the framebuffer
+        void setReprojection(bool enabled);
+
+        // disabled by default, primary rays then start at distance found by cone marching of a low resolution pass,
+        // expects viewport at the origin of the framebuffer
+        inline void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+
+        // disabled by default, fragments then count traversed rays and tested BVH nodes by atomics, see getTraversalStats
+        inline void setTraversalStats(bool enabled) { traversalStats = enabled; }
+
+        // counters of the last draw when enabled, waits for the draw to finish
+        TraversalStats getTraversalStats() const;
+
+        // disabled by default, fragments then add their steps, SDF evaluations, node visits and secondary rays to their pixel,
+        // every frame is then drawn at full resolution, see getPixelCounters
+        inline void setPixelCounters(bool enabled) { pixelCounters = enabled; adaptiveResolution.invalidate(); }
+
+        // counters of the last draw when enabled, waits for the draw to finish
+        PixelCounters getPixelCounters() const;
+
+        // swaps in a scene loaded in the background, uploads pending scene changes and draws full screen quad,
+        // or the adaptive frame into current viewport
+        void draw();
+
+        // frame time estimate, fed by GPU timer queries of adaptive frames so draw must not be enclosed in another GL_TIME_ELAPSED query
+        inline AdaptiveResolution& getAdaptiveResolution() { return adaptiveResolution; }
+
+        // nullptr for compiled scenes
+        inline DynamicScene* getScene() { return scene.get(); }
+
+        inline const std::string&       getErrorMessage()  const { return errorMessage; }
+        inline const ProgramLoadReport& getProgramReport() const { return programCache.getLastReport(); }
+        inline const SceneLoadReport&   getLoadReport()    const { return loadReport; }
+
+    private:
+        GLuint                         vao = 0;
+        ShaderProgramCache             programCache;
+        std::shared_ptr<CachedProgram> program;
+        std::unique_ptr<DynamicScene>  scene;
+        std::string                    errorMessage;
+        SceneLoadReport                loadReport;
+        std::string                    geometrySdfSource; // generated fragment shader linked with the program
+
+        RayCamera camera         = {};
+        glm::vec3 lightPosition  = glm::vec3(10, 10, 0);
+        float     penumbraFactor = 0;
+
+        SceneBuffers                         buffers;
+        std::unique_ptr<ShaderStorageBuffer> statsBuffer;   // TraversalStats
+        std::unique_ptr<ShaderStorageBuffer> counterBuffer; // PixelCounters of counterSize
+
+        // load started by loadSceneAsync, the future holds the background preparation, then the scene is uploaded
+        SceneLoadState                              loadState = SceneLoadState::slIdle;
+        std::future<std::unique_ptr<PreparedScene>> preparing;
+        std::unique_ptr<PreparedScene>              uploading;
+        std::chrono::steady_clock::time_point       loadStart;
+
+        // adaptive frames, 0 holds the last motion frame in its corner of lowResSize, 1 the full resolution image
+        bool               adaptive         = false;
+        AdaptiveResolution adaptiveResolution;
+        GLuint             frameTextures[2] = {};
+        GLuint             frameBuffers[2]  = {};
+        glm::uvec2         frameSize        = glm::uvec2(0);
+        glm::uvec2         lowResSize       = glm::uvec2(0);
+        bool               presentLowRes    = true;
+
+        // GPU time of rendered adaptive frames, results are read by later frames so that no frame waits for them
+        static constexpr int FRAME_QUERIES = 3;
+        GLuint timerQueries[FRAME_QUERIES]   = {};
+        double queryFractions[FRAME_QUERIES] = {}; // pixel fraction of the frame timed by the query, 0 when the query is free
+
+        // primary ray hits, historyIndex is written by the next frame while the other one holds the previous frame
+        bool       reprojection       = false;
+        GLuint     historyTextures[2] = {};
+        glm::uvec2 historyTextureSize = glm::uvec2(0);
+        uint32_t   historyIndex       = 0;
+        bool       historyValid       = false;
+        glm::uvec2 historySize        = glm::uvec2(0);
+        RayCamera  historyCamera      = {};
+
+        bool       depthPrepass       = false;
+        GLuint     prepassTexture     = 0;
+        glm::uvec2 prepassTextureSize = glm::uvec2(0);
+
+        bool traversalStats = false;
+
+        bool       pixelCounters = false;
+        glm::uvec2 counterSize   = glm::uvec2(0);
+
+        bool linkProgram(const std::string& sdfSource);
+        bool swapScene(PreparedScene& prepared);
+        void continueAsyncLoad();
+        void uploadSceneChanges();
+        void bindSceneData() const;
+        void drawAdaptive();
+        void readFrameTimes();
+        void drawQuad(glm::uvec2 size, bool writesHistory);
+        void drawPrepass(glm::uvec2 size);
+        void bindHistory(glm::uvec2 size);
+        void bindPixelCounters(glm::uvec2 size);
+        void resizeFrameTextures(glm::uvec2 size);
+};
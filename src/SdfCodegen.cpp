@@ -0,0 +1,201 @@
+#include <SdfCodegen.h>
+#include <cpu/Sdf.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// FOLDING
+///////////////////////////////////////////////////////////////////////////////
+
+static FoldedPrimitive foldPrimitive(const ShaderPrimitive& primitive) {
+    auto folded          = FoldedPrimitive();
+    folded.type          = PrimitiveType(primitive.type);
+    folded.operation     = PrimitiveOperation(primitive.operation);
+    folded.transformKind = TransformKind(primitive.transformKind);
+    folded.blending      = primitive.blending;
+    folded.rotation      = glm::transpose(glm::mat3(primitive.transform));
+    folded.translation   = packedTranslation(primitive.transform);
+    folded.data          = primitive.data;
+    folded.bound         = primitive.bound;
+    return folded;
+}
+
+vector<FoldedGeometry> foldGeometries(ArrayView<ShaderPrimitive> primitives, ArrayView<ShaderModel> models,
+                                      const vector<string>& geometryNames, const vector<glm::uvec2>& geometryRanges) {
+    // first primitive to name and primitive count
+    map<uint32_t, pair<string, uint32_t>> ranges;
+    for (const auto& model : models) {
+        ranges.insert({ model.geometryId, { "", model.primitiveCount } });
+    }
+    for (size_t handle = 0; handle < geometryRanges.size() && handle < geometryNames.size(); ++handle) {
+        if (geometryRanges[handle].y > 0) {
+            ranges[geometryRanges[handle].x] = { geometryNames[handle], geometryRanges[handle].y };
+        }
+    }
+
+    vector<FoldedGeometry> geometries;
+    for (const auto& [first, range] : ranges) {
+        const auto& [name, count] = range;
+        if (count == 0 || size_t(first) + count > primitives.count) {
+            continue;
+        }
+        auto geometry           = FoldedGeometry();
+        geometry.name           = name;
+        geometry.firstPrimitive = first;
+        for (uint32_t i = first; i < first + count; ++i) {
+            geometry.primitives.push_back(foldPrimitive(primitives[i]));
+        }
+        geometries.push_back(move(geometry));
+    }
+    return geometries;
+}
+
+vector<FoldedGeometry> foldGeometries(const ShaderSceneData& data) {
+    return foldGeometries({ data.primitives.data(), data.primitives.size() }, { data.models.data(), data.models.size() },
+                          data.geometryNames, data.geometryRanges);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GLSL
+///////////////////////////////////////////////////////////////////////////////
+
+// shortest literal which reads back as the same float
+static string glslFloat(float value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", value);
+    string literal = buffer;
+    if (literal.find_first_of(".e") == string::npos) {
+        literal += ".0";
+    }
+    return literal;
+}
+
+static string glslVec3(glm::vec3 v) {
+    return "vec3(" + glslFloat(v.x) + ", " + glslFloat(v.y) + ", " + glslFloat(v.z) + ")";
+}
+
+static string glslVec4(glm::vec4 v) {
+    return "vec4(" + glslFloat(v.x) + ", " + glslFloat(v.y) + ", " + glslFloat(v.z) + ", " + glslFloat(v.w) + ")";
+}
+
+static string glslMat3(const glm::mat3& m) {
+    string result = "mat3(";
+    for (int column = 0; column < 3; ++column) {
+        for (int row = 0; row < 3; ++row) {
+            result += glslFloat(m[column][row]) + (column == 2 && row == 2 ? ")" : ", ");
+        }
+    }
+    return result;
+}
+
+static string glslPosition(const FoldedPrimitive& primitive) {
+    switch (primitive.transformKind) {
+        case TransformKind::tkIdentity:    return "p";
+        case TransformKind::tkTranslation: return "p + " + glslVec3(primitive.translation);
+        case TransformKind::tkGeneral:     return glslMat3(primitive.rotation) + " * p + " + glslVec3(primitive.translation);
+    }
+    return "p";
+}
+
+// scaled distance to the primitive, same as sdPrimitive(p, primitive) * scale
+static string glslDistance(const FoldedPrimitive& primitive) {
+    const char* function = nullptr;
+    switch (primitive.type) {
+        case PrimitiveType::ptSphere:    function = "sdSphere";   break;
+        case PrimitiveType::ptCapsule:   function = "sdCapsule";  break;
+        case PrimitiveType::ptTorus:     function = "sdTorus";    break;
+        case PrimitiveType::ptBox:       function = "sdBox";      break;
+        case PrimitiveType::ptCilinder:  function = "sdCilinder"; break;
+        case PrimitiveType::ptCone:      function = "sdCone";     break;
+        case PrimitiveType::ptRoundCone: function = "roundCone";  break;
+        default: return glslFloat(SDF_MAX_DISTANCE) + " * scale";
+    }
+    return string(function) + "(" + glslPosition(primitive) + ", " + glslVec4(primitive.data) + ") * scale";
+}
+
+// statements of one primitive in the same order as the loop body of sdPrimitives
+static void generatePrimitive(ostream& stream, const FoldedPrimitive& primitive, bool first) {
+    string distance = glslDistance(primitive);
+    if (first && primitive.operation == PrimitiveOperation::Add) {
+        // smooth union with MAX_DISTANCE is the primitive itself
+        stream << "    float d = " << distance << ";\n";
+        return;
+    }
+    if (first) {
+        stream << "    float d = " << glslFloat(SDF_MAX_DISTANCE) << ";\n";
+    }
+
+    string blending   = glslFloat(primitive.blending) + " * scale";
+    string lowerBound = "(length(p - " + glslVec3(primitive.bound) + ") - " + glslFloat(primitive.bound.w) + ") * scale";
+    string indent     = "    ";
+    switch (primitive.operation) {
+        case PrimitiveOperation::Add:       stream << "    if (" << lowerBound << " < d + " << blending << ") {\n"; indent += "    "; break;
+        case PrimitiveOperation::Substract: stream << "    if (" << lowerBound << " < " << blending << " - d) {\n"; indent += "    "; break;
+        default: break;
+    }
+
+    bool hard = primitive.blending == 0.0f;
+    switch (primitive.operation) {
+        case PrimitiveOperation::Add:
+            stream << indent << "d = " << (hard ? "min(" + distance + ", d)" : "smoothMin(" + distance + ", d, " + blending + ")") << ";\n";
+            break;
+        case PrimitiveOperation::Substract:
+            stream << indent << "d = " << (hard ? "max(-" + distance + ", d)" : "smoothMax(-" + distance + ", d, " + blending + ")") << ";\n";
+            break;
+        case PrimitiveOperation::Intersect:
+            stream << indent << "d = " << (hard ? "max(" + distance + ", d)" : "smoothMax(" + distance + ", d, " + blending + ")") << ";\n";
+            break;
+        default:
+            break;
+    }
+    if (indent.size() > 4) {
+        stream << "    }\n";
+    }
+}
+
+string generateGeometrySdfGlsl(const vector<FoldedGeometry>& geometries) {
+    stringstream stream;
+    stream << "#version 460 core\n"
+              "\n"
+              "// generated by SdfCodegen, see generateGeometrySdfGlsl\n"
+              "\n"
+              "float smoothMin(float dist1, float dist2, float koeficient);\n"
+              "float smoothMax(float dist1, float dist2, float koeficient);\n"
+              "float sdPrimitives(vec3 p, uint geometryId, uint primitiveCount, float scale);\n"
+              "float sdSphere(vec3 p, vec4 data);\n"
+              "float sdCapsule(vec3 p, vec4 data);\n"
+              "float sdTorus(vec3 p, vec4 data);\n"
+              "float sdBox(vec3 p, vec4 data);\n"
+              "float sdCilinder(vec3 p, vec4 data);\n"
+              "float sdCone(vec3 p, vec4 data);\n"
+              "float roundCone(vec3 p, vec4 data);\n";
+
+    for (const auto& geometry : geometries) {
+        stream << "\n// " << (geometry.name.empty() ? "geometry" : geometry.name) << ", primitives " << geometry.firstPrimitive
+               << " to " << geometry.firstPrimitive + geometry.primitives.size() - 1 << "\n"
+               << "float sdGeometry" << geometry.firstPrimitive << "(vec3 p, float scale) {\n";
+        for (size_t i = 0; i < geometry.primitives.size(); ++i) {
+            generatePrimitive(stream, geometry.primitives[i], i == 0);
+        }
+        stream << "    return d;\n"
+                  "}\n";
+    }
+
+    stream << "\n"
+              "float sdGeometry(vec3 p, uint geometryId, uint primitiveCount, float scale) {\n";
+    if (!geometries.empty()) {
+        stream << "    switch (geometryId) {\n";
+        for (const auto& geometry : geometries) {
+            stream << "        case " << geometry.firstPrimitive << "u: return sdGeometry" << geometry.firstPrimitive << "(p, scale);\n";
+        }
+        stream << "    }\n";
+    }
+    stream << "    return sdPrimitives(p, geometryId, primitiveCount, scale);\n"
+              "}\n";
+    return stream.str();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <sceneUtils.h>
+#include <CompiledScene.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// primitive with its packed transform split to the parts evaluation needs
+struct FoldedPrimitive {
+    PrimitiveType      type;
+    PrimitiveOperation operation;
+    TransformKind      transformKind;
+    float              blending;
+    glm::mat3          rotation;
+    glm::vec3          translation;
+    glm::vec4          data;
+    glm::vec4          bound; // bounding sphere in geometry space, xyz center, w radius
+};
+
+struct FoldedGeometry {
+    std::string                  name;           // empty for compiled scenes which keep no geometry names
+    uint32_t                     firstPrimitive; // geometryId of its models
+    std::vector<FoldedPrimitive> primitives;
+};
+
+/**
+ * Geometries referenced by models and all named geometry ranges so that models added later to DynamicScene are covered,
+ * ordered by their first primitive.
+ */
+std::vector<FoldedGeometry> foldGeometries(ArrayView<ShaderPrimitive> primitives, ArrayView<ShaderModel> models,
+                                           const std::vector<std::string>& geometryNames = {},
+                                           const std::vector<glm::uvec2>&  geometryRanges = {});
+std::vector<FoldedGeometry> foldGeometries(const ShaderSceneData& data);
+
+/**
+ * Fragment shader defining sdGeometry of primitive_sdf.fs, one straight-line function per geometry with primitive data
+ * as literals and transforms reduced by their kind, dispatched by geometryId. Geometries which are not given,
+ * e.g. when the list is empty, fall back to the sdPrimitives interpreter.
+ */
+std::string generateGeometrySdfGlsl(const std::vector<FoldedGeometry>& geometries);
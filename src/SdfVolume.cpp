@@ -0,0 +1,153 @@
+
+#include <SdfVolume.h>
+#include <cpu/Sdf.h>
+#include <Hash.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct VolumeJob {
+    ShaderModel model; // geometry placed without transformation
+    uint64_t    hash;
+    uint32_t    volumeId;
+};
+
+static string cacheFile(const SdfVolumeOptions& options, uint64_t hash) {
+    stringstream name;
+    name << hex << setw(16) << setfill('0') << hash << ".sdf";
+    return (filesystem::path(options.cacheDirectory) / name.str()).string();
+}
+
+static bool loadVolume(const SdfVolumeOptions& options, uint64_t hash, float* distances, size_t count) {
+    if (options.cacheDirectory.empty()) {
+        return false;
+    }
+    ifstream stream(cacheFile(options, hash), ios::binary | ios::ate);
+    if (!stream.good() || size_t(stream.tellg()) != count * sizeof(float)) {
+        return false;
+    }
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(distances), count * sizeof(float));
+    return stream.good();
+}
+
+static void storeVolume(const SdfVolumeOptions& options, uint64_t hash, const float* distances, size_t count) {
+    if (options.cacheDirectory.empty()) {
+        return;
+    }
+    error_code error;
+    filesystem::create_directories(options.cacheDirectory, error);
+    ofstream stream(cacheFile(options, hash), ios::binary | ios::trunc);
+    stream.write(reinterpret_cast<const char*>(distances), count * sizeof(float));
+}
+
+ostream& operator<<(ostream& stream, const SdfVolumeBakeReport& report) {
+    return stream << "SDF volumes: " << report.baked << " baked, " << report.cached << " loaded from cache, "
+                  << report.bytes / (1024.0 * 1024.0) << " MB in " << report.duration.count() / 1000.0 << " ms";
+}
+
+SdfVolumeBakeReport bakeSdfVolumes(ShaderSceneData& data, const SdfVolumeOptions& options) {
+    auto start  = chrono::steady_clock::now();
+    auto report = SdfVolumeBakeReport();
+
+    uint32_t resolution = glm::max(options.resolution, 2u);
+    size_t   volumeSize = size_t(resolution) * resolution * resolution;
+
+    // geometry handles are ordered by their primitives so volume ids do not depend on model order
+    vector<pair<glm::uvec2, int32_t>> geometries;
+    for (int32_t handle = 0; handle < int32_t(data.geometryRanges.size()); ++handle) {
+        const auto& range = data.geometryRanges[handle];
+        const auto& bound = data.geometryBounds[handle];
+        if (range.y >= options.minPrimitives && glm::all(glm::lessThanEqual(bound.min, bound.max))) {
+            geometries.push_back({ range, handle });
+        }
+    }
+
+    data.volumes            = SdfVolumeAtlas();
+    data.volumes.resolution = resolution;
+    data.volumes.count      = geometries.size();
+    data.volumes.distances.resize(volumeSize * geometries.size());
+    data.geometryVolumes.assign(data.geometryRanges.size(), -1);
+
+    vector<VolumeJob> jobs;
+    for (uint32_t volumeId = 0; volumeId < geometries.size(); ++volumeId) {
+        const auto& [range, handle]  = geometries[volumeId];
+        const auto& bound            = data.geometryBounds[handle];
+        data.geometryVolumes[handle] = int32_t(volumeId);
+
+        auto model           = ShaderModel();
+        model.transform      = packTransform(glm::mat4(1.0f));
+        model.transformKind  = TransformKind::tkIdentity;
+        model.geometryId     = range.x;
+        model.primitiveCount = range.y;
+        model.scale          = 1.0f;
+        model.boundMin       = bound.min;
+        model.boundMax       = bound.max;
+        model.volumeId       = -1;
+
+        // primitives are what geometry JSON compiles to, formatting of the file does not invalidate the cache
+        uint64_t hash = HASH_BASIS;
+        uint32_t key[2] = { SDF_VOLUME_VERSION, resolution };
+        hash = hashBytes(hash, key, sizeof(key));
+        hash = hashBytes(hash, data.primitives.data() + range.x, range.y * sizeof(ShaderPrimitive));
+
+        if (loadVolume(options, hash, data.volumes.distances.data() + volumeId * volumeSize, volumeSize)) {
+            ++report.cached;
+        } else {
+            jobs.push_back({ model, hash, volumeId });
+        }
+    }
+
+    // z slices of all baked volumes are spread over threads
+    uint32_t threadCount = options.threads > 0 ? options.threads : glm::max(thread::hardware_concurrency(), 1u);
+    uint32_t sliceCount  = jobs.size() * resolution;
+    atomic<uint32_t> nextSlice = 0;
+
+    auto worker = [&]() {
+        for (uint32_t slice = nextSlice++; slice < sliceCount; slice = nextSlice++) {
+            const auto& job = jobs[slice / resolution];
+            uint32_t    z   = slice % resolution;
+
+            glm::vec3 volumeMin = job.model.boundMin - SDF_VOLUME_MARGIN;
+            glm::vec3 cellSize  = (job.model.boundMax - job.model.boundMin + 2.0f * SDF_VOLUME_MARGIN) / float(resolution - 1);
+            float*    samples   = data.volumes.distances.data() + job.volumeId * volumeSize + size_t(z) * resolution * resolution;
+            for (uint32_t y = 0; y < resolution; ++y) {
+                for (uint32_t x = 0; x < resolution; ++x) {
+                    glm::vec3 position = volumeMin + glm::vec3(x, y, z) * cellSize;
+                    samples[y * resolution + x] = sdModel(position, job.model, data.primitives.data());
+                }
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (uint32_t i = 1; i < glm::min(threadCount, sliceCount); ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    for (const auto& job : jobs) {
+        storeVolume(options, job.hash, data.volumes.distances.data() + job.volumeId * volumeSize, volumeSize);
+    }
+
+    for (auto& model : data.models) {
+        auto geometry  = find_if(geometries.begin(), geometries.end(), [&](const auto& g) { return g.first.x == model.geometryId; });
+        model.volumeId = geometry != geometries.end() ? int32_t(geometry - geometries.begin()) : -1;
+    }
+
+    report.baked    = jobs.size();
+    report.bytes    = data.volumes.distances.size() * sizeof(float);
+    report.duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    return report;
+}
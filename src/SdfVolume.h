@@ -0,0 +1,34 @@
+#pragma once
+
+#include <sceneUtils.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#define SDF_VOLUME_VERSION 1 // part of cache keys, increase when SDF functions change
+
+struct SdfVolumeOptions {
+    uint32_t    resolution     = 32;
+    uint32_t    threads        = 0; // 0 means one thread per hardware thread
+    uint32_t    minPrimitives  = 2; // geometries with fewer primitives are cheap to evaluate and are not baked
+    std::string cacheDirectory = "sdf_cache"; // empty disables disk cache
+};
+
+struct SdfVolumeBakeReport {
+    uint32_t                  baked    = 0;
+    uint32_t                  cached   = 0; // loaded from disk cache
+    size_t                    bytes    = 0;
+    std::chrono::microseconds duration = {};
+};
+
+std::ostream& operator<<(std::ostream& stream, const SdfVolumeBakeReport& report);
+
+/**
+ * Samples SDF of every geometry on a grid covering its bound grown by SDF_VOLUME_MARGIN and stores it to data.volumes,
+ * models are updated to reference volumes of their geometries. Marching then costs one trilinear lookup per step
+ * regardless of geometry complexity, primitives are evaluated only near the surface (see sdModel in Sdf.h).
+ * Volumes are cached on disk keyed by hash of the geometry primitives, resolution and SDF_VOLUME_VERSION.
+ */
+SdfVolumeBakeReport bakeSdfVolumes(ShaderSceneData& data, const SdfVolumeOptions& options = {});
@@ -0,0 +1,255 @@
+
+#include <ShaderProgramCache.h>
+#include <Hash.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// PROGRAM
+///////////////////////////////////////////////////////////////////////////////
+
+CachedProgram::~CachedProgram() {
+    glDeleteProgram(id);
+}
+
+void CachedProgram::use() const {
+    glUseProgram(id);
+}
+
+void CachedProgram::uniform(const string& name, int value) const {
+    glProgramUniform1i(id, glGetUniformLocation(id, name.c_str()), value);
+}
+
+void CachedProgram::uniform(const string& name, float value) const {
+    glProgramUniform1f(id, glGetUniformLocation(id, name.c_str()), value);
+}
+
+void CachedProgram::uniform(const string& name, glm::vec3 value) const {
+    glProgramUniform3fv(id, glGetUniformLocation(id, name.c_str()), 1, glm::value_ptr(value));
+}
+
+void CachedProgram::uniform(const string& name, glm::ivec2 value) const {
+    glProgramUniform2iv(id, glGetUniformLocation(id, name.c_str()), 1, glm::value_ptr(value));
+}
+
+ostream& operator<<(ostream& stream, const ProgramLoadReport& report) {
+    const char* origins[] = { "reused from memory", "loaded from disk cache", "compiled" };
+    return stream << "Program " << hex << setw(16) << setfill('0') << report.hash << dec << setfill(' ')
+                  << " " << origins[report.origin] << " in " << report.duration.count() / 1000.0 << " ms";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CACHE
+///////////////////////////////////////////////////////////////////////////////
+
+static string glString(GLenum name) {
+    auto value = reinterpret_cast<const char*>(glGetString(name));
+    return value == nullptr ? "" : value;
+}
+
+// defines are placed after #version which has to be the first directive
+static string injectDefines(const string& source, const ShaderDefines& defines) {
+    if (defines.empty()) {
+        return source;
+    }
+    string block;
+    for (const auto& [name, value] : defines) {
+        block += "#define " + name + " " + value + "\n";
+    }
+    size_t insert  = 0;
+    size_t version = source.find("#version");
+    if (version != string::npos) {
+        size_t lineEnd = source.find('\n', version);
+        insert = lineEnd == string::npos ? source.size() : lineEnd + 1;
+    }
+    return source.substr(0, insert) + block + source.substr(insert);
+}
+
+ShaderProgramCache::ShaderProgramCache(string directory) : directory(move(directory)) {}
+
+shared_ptr<CachedProgram> ShaderProgramCache::get(const vector<ShaderSource>& shaders, const ShaderDefines& defines) {
+    auto start = chrono::steady_clock::now();
+    errorMessage.clear();
+
+    // sources are read every time so that edited files produce a new hash
+    vector<pair<GLenum, string>> sources;
+    uint64_t hash = HASH_BASIS;
+    for (const auto& shader : shaders) {
+        stringstream content;
+        if (shader.source.empty()) {
+            ifstream stream(shader.file, ios::binary);
+            if (!stream.good()) {
+                errorMessage = "Cannot read shader file " + shader.file;
+                return nullptr;
+            }
+            content << stream.rdbuf();
+        } else {
+            content << shader.source;
+        }
+        sources.push_back({ shader.type, injectDefines(content.str(), defines) });
+        hash = hashBytes(hash, &shader.type, sizeof(shader.type));
+        hash = hashString(hash, sources.back().second);
+    }
+
+    lastReport      = {};
+    lastReport.hash = hash;
+
+    shared_ptr<CachedProgram> program;
+    auto cached = programs.find(hash);
+    if (cached != programs.end()) {
+        lastReport.origin = ProgramOrigin::poMemory;
+        program = cached->second.program;
+        cached->second.lastUse = ++useCounter;
+    } else {
+        GLuint id = loadBinary(hash);
+        if (id != 0) {
+            lastReport.origin = ProgramOrigin::poDisk;
+        } else {
+            id = compile(sources);
+            if (id == 0) {
+                return nullptr;
+            }
+            lastReport.origin = ProgramOrigin::poCompiled;
+            storeBinary(hash, id);
+        }
+        program = make_shared<CachedProgram>(id);
+        programs[hash] = { program, ++useCounter };
+        evictUnused();
+    }
+
+    lastReport.duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    return program;
+}
+
+void ShaderProgramCache::evictUnused() {
+    // programs referenced only by the cache, others are in use and must stay
+    vector<unordered_map<uint64_t, Entry>::iterator> unused;
+    for (auto it = programs.begin(); it != programs.end(); ++it) {
+        if (it->second.program.use_count() == 1) {
+            unused.push_back(it);
+        }
+    }
+    if (unused.size() <= MAX_UNUSED_PROGRAMS) {
+        return;
+    }
+    sort(unused.begin(), unused.end(), [](const auto& a, const auto& b) { return a->second.lastUse < b->second.lastUse; });
+    for (size_t i = 0; i < unused.size() - MAX_UNUSED_PROGRAMS; ++i) {
+        programs.erase(unused[i]); // deletes the GL program
+    }
+}
+
+string ShaderProgramCache::binaryFile(uint64_t hash) const {
+    // binaries are valid only for the driver which produced them
+    uint64_t driverHash = hashString(hashString(hashString(hash, glString(GL_VENDOR)), glString(GL_RENDERER)), glString(GL_VERSION));
+    stringstream name;
+    name << hex << setw(16) << setfill('0') << driverHash << ".bin";
+    return (filesystem::path(directory) / name.str()).string();
+}
+
+GLuint ShaderProgramCache::loadBinary(uint64_t hash) const {
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (directory.empty() || formatCount <= 0) {
+        return 0;
+    }
+
+    ifstream stream(binaryFile(hash), ios::binary);
+    if (!stream.good()) {
+        return 0;
+    }
+    GLenum format = 0;
+    stream.read(reinterpret_cast<char*>(&format), sizeof(format));
+    vector<char> binary((istreambuf_iterator<char>(stream)), istreambuf_iterator<char>());
+    if (!stream.good() || binary.empty()) {
+        return 0;
+    }
+
+    GLuint id = glCreateProgram();
+    glProgramBinary(id, format, binary.data(), GLsizei(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        glDeleteProgram(id); // driver update or corrupted file
+        return 0;
+    }
+    return id;
+}
+
+void ShaderProgramCache::storeBinary(uint64_t hash, GLuint program) const {
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (directory.empty() || formatCount <= 0) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    error_code error;
+    filesystem::create_directories(directory, error);
+    ofstream stream(binaryFile(hash), ios::binary | ios::trunc);
+    stream.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    stream.write(binary.data(), length);
+}
+
+GLuint ShaderProgramCache::compile(const vector<pair<GLenum, string>>& sources) {
+    GLuint id = glCreateProgram();
+    vector<GLuint> shaderIds;
+    for (const auto& [type, source] : sources) {
+        GLuint shader = glCreateShader(type);
+        const char* text = source.c_str();
+        glShaderSource(shader, 1, &text, nullptr);
+        glCompileShader(shader);
+
+        GLint compiled = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (compiled != GL_TRUE) {
+            GLint length = 0;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+            string log(glm::max(length, 1), '\0');
+            glGetShaderInfoLog(shader, length, nullptr, log.data());
+            errorMessage += log;
+        }
+        glAttachShader(id, shader);
+        shaderIds.push_back(shader);
+    }
+
+    if (errorMessage.empty()) {
+        glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(id);
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(id, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE) {
+            GLint length = 0;
+            glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length);
+            string log(glm::max(length, 1), '\0');
+            glGetProgramInfoLog(id, length, nullptr, log.data());
+            errorMessage += log;
+        }
+    }
+
+    for (auto shader : shaderIds) {
+        glDetachShader(id, shader);
+        glDeleteShader(shader);
+    }
+    if (!errorMessage.empty()) {
+        glDeleteProgram(id);
+        return 0;
+    }
+    return id;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ShaderSource {
+    GLenum      type;
+    std::string file;
+    std::string source = {}; // used instead of the file when not empty, e.g. for generated shaders
+};
+
+// name and value of a define injected after the #version line of every shader
+using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * Linked GL program owned by the cache, uniforms are set by glProgramUniform so program does not need to be bound.
+ */
+class CachedProgram
+{
+    public:
+        CachedProgram(GLuint id) : id(id) {}
+
+        CachedProgram(const CachedProgram&) = delete;
+        CachedProgram& operator=(const CachedProgram&) = delete;
+
+        ~CachedProgram();
+
+        void use() const;
+
+        void uniform(const std::string& name, int value) const;
+        void uniform(const std::string& name, float value) const;
+        void uniform(const std::string& name, glm::vec3 value) const;
+        void uniform(const std::string& name, glm::ivec2 value) const;
+
+        inline GLuint getId() const { return id; }
+
+    private:
+        GLuint id;
+};
+
+enum ProgramOrigin {
+    poMemory,   // same sources were already used
+    poDisk,     // binary loaded from disk cache
+    poCompiled, // compiled from GLSL
+};
+
+struct ProgramLoadReport {
+    ProgramOrigin             origin   = ProgramOrigin::poCompiled;
+    uint64_t                  hash     = 0;
+    std::chrono::microseconds duration = {};
+};
+
+std::ostream& operator<<(std::ostream& stream, const ProgramLoadReport& report);
+
+/**
+ * Programs are keyed by hash of their shader sources and defines so reload with unchanged sources reuses the program.
+ * At most MAX_UNUSED_PROGRAMS programs no longer held outside the cache are kept, least recently requested go first.
+ * When driver supports program binaries they are stored in cache directory and loaded instead of compiling GLSL,
+ * binaries are also keyed by GL vendor, renderer and version and fall back to compilation when rejected.
+ */
+class ShaderProgramCache
+{
+    public:
+        static constexpr size_t MAX_UNUSED_PROGRAMS = 8;
+
+        // empty directory disables disk cache
+        ShaderProgramCache(std::string directory = "shader_cache");
+
+        // nullptr when program cannot be created, see getErrorMessage
+        std::shared_ptr<CachedProgram> get(const std::vector<ShaderSource>& shaders, const ShaderDefines& defines = {});
+
+        inline const std::string&       getErrorMessage() const { return errorMessage; }
+        inline const ProgramLoadReport& getLastReport()   const { return lastReport; }
+
+    private:
+        std::string       directory;
+        std::string       errorMessage;
+        ProgramLoadReport lastReport;
+
+        struct Entry {
+            std::shared_ptr<CachedProgram> program;
+            uint64_t                       lastUse = 0; // value of useCounter when the program was requested
+        };
+
+        std::unordered_map<uint64_t, Entry> programs;
+        uint64_t                            useCounter = 0;
+
+        void        evictUnused();
+        std::string binaryFile(uint64_t hash) const;
+        GLuint      loadBinary(uint64_t hash) const;
+        void        storeBinary(uint64_t hash, GLuint program) const;
+        GLuint      compile(const std::vector<std::pair<GLenum, std::string>>& sources);
+};
@@ -0,0 +1,33 @@
+
+#include <ShaderStorageBuffer.h>
+
+ShaderStorageBuffer::ShaderStorageBuffer(const void* data, size_t size) : size(size) {
+    glCreateBuffers(1, &id);
+    if (size > 0) {
+        glNamedBufferData(id, size, data, GL_STATIC_DRAW);
+    } else {
+        glNamedBufferData(id, 16, nullptr, GL_STATIC_DRAW); // empty buffer cannot be bound
+    }
+}
+
+ShaderStorageBuffer::~ShaderStorageBuffer() {
+    glDeleteBuffers(1, &id);
+}
+
+void ShaderStorageBuffer::bind(GLuint binding) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, id);
+}
+
+void ShaderStorageBuffer::update(size_t offset, const void* data, size_t size) {
+    glNamedBufferSubData(id, offset, size, data);
+}
+
+void ShaderStorageBuffer::clear() {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glClearNamedBufferData(id, GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+}
+
+void ShaderStorageBuffer::read(size_t offset, void* data, size_t size) const {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetNamedBufferSubData(id, offset, size, data);
+}
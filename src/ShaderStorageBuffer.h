@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * Shader storage buffer holding runtime sized array of std430 structures.
+ */
+class ShaderStorageBuffer
+{
+    public:
+        ShaderStorageBuffer(const void* data, size_t size);
+
+        template<typename T>
+        ShaderStorageBuffer(const std::vector<T>& data) : ShaderStorageBuffer(data.data(), data.size() * sizeof(T)) {}
+
+        ShaderStorageBuffer(const ShaderStorageBuffer&) = delete;
+        ShaderStorageBuffer& operator=(const ShaderStorageBuffer&) = delete;
+
+        ~ShaderStorageBuffer();
+
+        // binds buffer to the binding point of the shader buffer block
+        void bind(GLuint binding) const;
+
+        // rewrites bytes [offset, offset + size) of the buffer
+        void update(size_t offset, const void* data, size_t size);
+
+        // rewrites elements [first, first + count) from the vector the buffer was created from
+        template<typename T>
+        void update(const std::vector<T>& data, size_t first, size_t count) { update(first * sizeof(T), data.data() + first, count * sizeof(T)); }
+
+        // sets all bytes of the buffer to zero, waits for preceding shader writes
+        void clear();
+
+        // copies bytes [offset, offset + size) of the buffer to data, waits for preceding shader writes
+        void read(size_t offset, void* data, size_t size) const;
+
+        inline GLuint getId()   const { return id; }
+        inline size_t getSize() const { return size; }
+
+    private:
+        GLuint id   = 0;
+        size_t size = 0;
+};
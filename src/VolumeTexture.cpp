@@ -0,0 +1,31 @@
+
+#include <VolumeTexture.h>
+
+VolumeTexture::VolumeTexture(const float* distances, uint32_t resolution, uint32_t count) : resolution(resolution) {
+    glCreateTextures(GL_TEXTURE_3D, 1, &id);
+    glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    if (count > 0) {
+        glTextureStorage3D(id, 1, GL_R32F, resolution, resolution, resolution * count);
+        if (distances != nullptr) {
+            update(0, distances, resolution * count);
+        }
+    } else {
+        glTextureStorage3D(id, 1, GL_R32F, 1, 1, 1); // sampler still needs a complete texture
+    }
+}
+
+VolumeTexture::~VolumeTexture() {
+    glDeleteTextures(1, &id);
+}
+
+void VolumeTexture::update(uint32_t first, const float* slices, uint32_t count) {
+    glTextureSubImage3D(id, 0, 0, 0, first, resolution, resolution, count, GL_RED, GL_FLOAT, slices);
+}
+
+void VolumeTexture::bind(GLuint unit) const {
+    glBindTextureUnit(unit, id);
+}
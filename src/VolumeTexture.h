@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+/**
+ * Single channel float 3D texture with trilinear filtering holding volumes of SdfVolumeAtlas stacked along z.
+ */
+class VolumeTexture
+{
+    public:
+        // storage is only allocated when distances are nullptr, see update
+        VolumeTexture(const float* distances, uint32_t resolution, uint32_t count);
+
+        VolumeTexture(const VolumeTexture&) = delete;
+        VolumeTexture& operator=(const VolumeTexture&) = delete;
+
+        ~VolumeTexture();
+
+        // rewrites z-slices [first, first + count) of the stacked volumes, each slice holds resolution^2 distances
+        void update(uint32_t first, const float* slices, uint32_t count);
+
+        // binds texture to the texture unit of the shader sampler
+        void bind(GLuint unit) const;
+
+        inline GLuint getId() const { return id; }
+
+    private:
+        GLuint   id         = 0;
+        uint32_t resolution = 0;
+};
@@ -0,0 +1,264 @@
+
+#include <batch/Batch.h>
+#include <batch/ImageWriterPool.h>
+#include <chess/ChessScene.h>
+#include <cpu/CpuRenderer.h>
+#include <sceneUtils.h>
+#include <CommandLine.h>
+#include <CompiledScene.h>
+#include <SdfVolume.h>
+
+#include <RenderBase/tools/camera.h>
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+using json = nlohmann::json;
+
+///////////////////////////////////////////////////////////////////////////////
+// OPTIONS
+///////////////////////////////////////////////////////////////////////////////
+
+bool parseBatchOptions(int argc, char* argv[], BatchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--cpu") {
+            options.cpu = true;
+            continue;
+        }
+        if (arg == "--depth-prepass") {
+            options.depthPrepass = true;
+            continue;
+        }
+        if (arg == "--generic-sdf") {
+            options.genericSdf = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for argument " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        bool parsed = parseArgumentValue(arg, value, [&]() {
+            if      (arg == "--jobs")        options.jobs       = value;
+            else if (arg == "--threads")     options.threads    = toUnsigned(value);
+            else if (arg == "--writers")     options.writers    = toUnsigned(value);
+            else if (arg == "--max-pending") options.maxPending = toUnsigned(value);
+            else if (arg == "--simd")        options.kernels    = packetKernelTypeFromString(value);
+            else if (arg == "--models")      options.models     = toUnsigned(value);
+            else if (arg == "--bake-sdf")    options.bakeSdf    = toUnsigned(value);
+            else if (arg == "--penumbra")    options.penumbra   = stof(value);
+            else {
+                cerr << "Unknown argument " << arg << endl;
+                return false;
+            }
+            return true;
+        });
+        if (!parsed) {
+            return false;
+        }
+    }
+    return options.writers > 0 && options.maxPending > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// JOBS
+///////////////////////////////////////////////////////////////////////////////
+
+RayCamera BatchJob::camera() const {
+    auto cam = make_shared<rb::Camera>(glm::vec3(0, 1, 0));
+    cam->setFov(glm::radians(fov));
+    cam->setAspectRatio(float(resolution.x) / float(resolution.y));
+    cam->setPosition(cameraPosition);
+    cam->setTargetPosition(cameraTarget);
+    return RayCamera::fromCamera(cam);
+}
+
+static glm::vec3 jsonToVec3(const json& value) {
+    return glm::vec3(value.at(0).get<float>(), value.at(1).get<float>(), value.at(2).get<float>());
+}
+
+// throws json exceptions on values of wrong type, false with error message on malformed FEN
+static bool parseJob(const json& value, BatchJob& job, string& error) {
+    job.output = value.at("output").get<string>();
+    if (value.contains("scene")) {
+        job.scene = value["scene"].get<string>();
+    }
+    if (value.contains("resolution")) {
+        job.resolution = glm::uvec2(value["resolution"].at(0).get<uint32_t>(), value["resolution"].at(1).get<uint32_t>());
+    }
+    if (value.contains("camera")) {
+        const auto& camera = value["camera"];
+        if (camera.contains("position")) job.cameraPosition = jsonToVec3(camera["position"]);
+        if (camera.contains("target"))   job.cameraTarget   = jsonToVec3(camera["target"]);
+        if (camera.contains("fov"))      job.fov            = camera["fov"].get<float>();
+    }
+    if (value.contains("models")) {
+        job.replaceModels = true;
+        for (const auto& model : value["models"]) {
+            job.models.push_back(buildModelFromJson(model));
+        }
+    }
+    if (value.contains("fen")) {
+        job.setPosition = true;
+        return job.position.setFen(value["fen"].get<string>(), error);
+    }
+    return true;
+}
+
+bool BatchJobReader::next(BatchJob& job) {
+    string text;
+    while (getline(stream, text)) {
+        ++line;
+        auto begin = text.find_first_not_of(" \t\r");
+        if (begin == string::npos || text[begin] == '#') {
+            continue;
+        }
+
+        job       = BatchJob();
+        job.line  = line;
+        job.scene = scene.empty() ? RESOURCE_SCENE_JSON : scene;
+        auto value = json::parse(text, nullptr, false);
+        if (value.is_discarded() || !value.is_object()) {
+            cerr << "Line " << line << ": job is not a json object" << endl;
+            ++errors;
+            continue;
+        }
+        try {
+            string error;
+            if (!parseJob(value, job, error)) {
+                cerr << "Line " << line << ": " << error << endl;
+                ++errors;
+                continue;
+            }
+        } catch (const json::exception& e) {
+            cerr << "Line " << line << ": " << e.what() << endl;
+            ++errors;
+            continue;
+        }
+        if (job.output.empty() || job.resolution.x == 0 || job.resolution.y == 0) {
+            cerr << "Line " << line << ": job needs output and non-zero resolution" << endl;
+            ++errors;
+            continue;
+        }
+        scene = job.scene;
+        return true;
+    }
+    return false;
+}
+
+vector<Model> jobModels(const BatchJob& job, const vector<Model>& board) {
+    return job.setPosition ? positionModels(job.position, board) : job.models;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CPU BATCH
+///////////////////////////////////////////////////////////////////////////////
+
+// json scenes are kept in DynamicScene so that board states only update models, compiled scenes are static
+// false with error message, a malformed scene fails only the job
+static bool loadCpuScene(const BatchOptions& options, const BatchJob& job, unique_ptr<DynamicScene>& scene, unique_ptr<CpuRenderer>& renderer) {
+    const auto& file = job.scene;
+    scene    = nullptr;
+    renderer = nullptr;
+    if (!ifstream(file).good()) {
+        cerr << "Cannot open scene " << file << endl;
+        return false;
+    }
+
+    auto data = ShaderSceneData();
+    if (isCompiledSceneFile(file)) {
+        auto compiled = CompiledScene(file);
+        if (!compiled.isValid()) {
+            cerr << compiled.getErrorMessage() << endl;
+            return false;
+        }
+        data = compiled.toShaderSceneData();
+    } else {
+        try {
+            auto jsonScene = buildSceneFromJson(file);
+            if (options.models > 0) {
+                replicateModels(*jsonScene, options.models);
+            }
+            scene = make_unique<DynamicScene>(move(jsonScene));
+        } catch (const exception& e) {
+            cerr << "Line " << job.line << ": error while loading a scene: " << e.what() << endl;
+            return false;
+        }
+        if (options.bakeSdf > 0) {
+            auto volumeOptions       = SdfVolumeOptions();
+            volumeOptions.resolution = options.bakeSdf;
+            volumeOptions.threads    = options.threads;
+            scene->bakeVolumes(volumeOptions);
+        }
+        data = scene->getData();
+    }
+
+    renderer = make_unique<CpuRenderer>(move(data), options.kernels);
+    renderer->depthPrepass   = options.depthPrepass;
+    renderer->penumbraFactor = options.penumbra;
+    renderer->specializedSdf = !options.genericSdf;
+    return true;
+}
+
+int runCpuBatch(const BatchOptions& options) {
+    auto file = ifstream();
+    if (options.jobs != "-") {
+        file.open(options.jobs);
+        if (!file.good()) {
+            cerr << "Cannot open job list " << options.jobs << endl;
+            return 1;
+        }
+    }
+    auto reader  = BatchJobReader(options.jobs == "-" ? cin : file);
+    auto writers = ImageWriterPool(options.writers, options.maxPending);
+
+    unique_ptr<DynamicScene> scene;
+    unique_ptr<CpuRenderer>  renderer;
+    vector<Model>            board; // scene models which are not pieces, FEN positions are placed on them
+    string loadedScene;
+    size_t rendered = 0;
+    size_t failed   = 0;
+    auto   start    = chrono::steady_clock::now();
+
+    auto job = BatchJob();
+    while (reader.next(job)) {
+        if (job.scene != loadedScene || renderer == nullptr) {
+            loadedScene = job.scene;
+            if (!loadCpuScene(options, job, scene, renderer)) {
+                ++failed;
+                continue;
+            }
+            board = scene != nullptr ? boardModels(scene->getScene()) : vector<Model>();
+        }
+        if (job.replaceModels || job.setPosition) {
+            if (scene == nullptr) {
+                cerr << "Line " << job.line << ": models of compiled scene " << job.scene << " cannot be replaced" << endl;
+                ++failed;
+                continue;
+            }
+            scene->setModels(jobModels(job, board));
+            if (scene->hasChanges()) {
+                scene->update();
+                renderer->updateModels(scene->getData());
+            }
+        }
+
+        // the image is encoded by a writer while the next job renders
+        auto image = Image(job.resolution.x, job.resolution.y);
+        renderer->render(job.camera(), image, options.threads);
+        writers.submit(move(image), job.output);
+        ++rendered;
+    }
+    writers.wait();
+
+    auto duration = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    failed += reader.getErrors() + writers.getFailed();
+    cout << "Rendered " << rendered << " jobs in " << duration << " ms (" << rendered * 1000.0 / max(duration, 1e-3) << " jobs/s), "
+         << writers.getWritten() << " images written, " << failed << " failed\n";
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cpu/PacketKernels.h>
+#include <chess/ChessPosition.h>
+#include <scene/Model.h>
+#include <DynamicScene.h>
+#include <RayCamera.h>
+
+#include <glm/glm.hpp>
+
+#include <istream>
+#include <string>
+#include <vector>
+
+struct BatchOptions {
+    std::string jobs         = "-"; // job list file, - reads standard input
+    bool        cpu          = false;
+    uint32_t    threads      = 0;   // CPU render threads, 0 for one per hardware thread
+    uint32_t    writers      = 2;   // threads encoding and writing images
+    uint32_t    maxPending   = 8;   // rendered images waiting for a writer before rendering blocks
+    size_t      models       = 0;   // replicate models of json scenes to this count when set
+    uint32_t    bakeSdf      = 0;   // resolution of baked SDF volumes, 0 disables baking
+    bool        depthPrepass = false;
+    float       penumbra     = 0;
+    bool        genericSdf   = false;
+
+    PacketKernelType kernels = PacketKernelType::pkAuto;
+};
+
+// false on unknown or malformed argument
+bool parseBatchOptions(int argc, char* argv[], BatchOptions& options);
+
+struct BatchJob {
+    size_t      line   = 0;  // line of the job list, for error messages
+    std::string scene  = ""; // json or compiled scene
+    std::string output = "";
+
+    // board state, models of the scene are replaced by these when given
+    bool               replaceModels = false;
+    std::vector<Model> models        = {};
+
+    // board state given by FEN, pieces are placed on the board models of the scene by PieceLayout
+    bool          setPosition = false;
+    ChessPosition position    = ChessPosition();
+
+    glm::vec3  cameraPosition = glm::vec3(0, 10, -10); // default view of the application
+    glm::vec3  cameraTarget   = glm::vec3(0);
+    float      fov            = 60.0f;                 // vertical, degrees
+    glm::uvec2 resolution     = glm::uvec2(1280, 720);
+
+    RayCamera camera() const;
+};
+
+/**
+ * Reads one job per line so that a producer can stream jobs through a pipe while they are rendered:
+ *   { "output": "file.png", "scene": "scene.json", "resolution": [w, h],
+ *     "camera": { "position": [x, y, z], "target": [x, y, z], "fov": 60 }, "models": [ models as in scene json ], "fen": "..." }
+ * Only output is required, scene defaults to the scene of the previous job. Empty lines and lines starting by # are skipped.
+ */
+class BatchJobReader
+{
+    public:
+        BatchJobReader(std::istream& stream) : stream(stream) {}
+
+        // false at the end of the stream, malformed jobs are reported and skipped
+        bool next(BatchJob& job);
+
+        inline size_t getErrors() const { return errors; }
+
+    private:
+        std::istream& stream;
+        std::string   scene;
+        size_t        line   = 0;
+        size_t        errors = 0;
+};
+
+// models replacing the scene models for the board state of the job, board holds the scene models which are not pieces
+std::vector<Model> jobModels(const BatchJob& job, const std::vector<Model>& board);
+
+// renders jobs by CpuRenderer, scene stays loaded until a job names another one
+int runCpuBatch(const BatchOptions& options);
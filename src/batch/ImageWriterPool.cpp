@@ -0,0 +1,66 @@
+
+#include <batch/ImageWriterPool.h>
+
+#include <iostream>
+
+using namespace std;
+
+ImageWriterPool::ImageWriterPool(uint32_t threadCount, size_t maxPending) : maxPending(max(maxPending, size_t(1))) {
+    threadCount = max(threadCount, 1u);
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ImageWriterPool::work, this);
+    }
+}
+
+ImageWriterPool::~ImageWriterPool() {
+    {
+        lock_guard<std::mutex> lock(queueMutex);
+        stopped = true;
+    }
+    queueChanged.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ImageWriterPool::submit(Image image, string fileName) {
+    unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [&] { return queue.size() < maxPending; });
+    queue.emplace_back(move(image), move(fileName));
+    lock.unlock();
+    queueChanged.notify_all();
+}
+
+void ImageWriterPool::wait() {
+    unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [&] { return queue.empty() && active == 0; });
+}
+
+// one condition variable serves producers, workers and waiters, all of them recheck their predicate
+void ImageWriterPool::work() {
+    unique_lock<std::mutex> lock(queueMutex);
+    for (;;) {
+        queueChanged.wait(lock, [&] { return stopped || !queue.empty(); });
+        if (queue.empty()) {
+            return; // stopped and drained
+        }
+        auto job = move(queue.front());
+        queue.pop_front();
+        ++active;
+        lock.unlock();
+        queueChanged.notify_all();
+
+        bool success = job.first.write(job.second);
+        if (!success) {
+            cerr << "Error while writing image " << job.second << endl;
+        }
+
+        lock.lock();
+        --active;
+        ++(success ? written : failed);
+        lock.unlock();
+        queueChanged.notify_all();
+        lock.lock();
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cpu/Image.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Encodes and writes images on worker threads so that rendering of the next image overlaps with PNG encoding and disk I/O.
+ * At most maxPending images wait in the queue, submit blocks until a worker takes one so that memory stays bounded.
+ */
+class ImageWriterPool
+{
+    public:
+        ImageWriterPool(uint32_t threadCount = 2, size_t maxPending = 8);
+
+        // waits for all submitted images
+        ~ImageWriterPool();
+
+        ImageWriterPool(const ImageWriterPool&) = delete;
+        ImageWriterPool& operator=(const ImageWriterPool&) = delete;
+
+        // format is chosen by extension of fileName as by Image::write
+        void submit(Image image, std::string fileName);
+
+        // blocks until all submitted images are written
+        void wait();
+
+        inline size_t getWritten() const { std::lock_guard<std::mutex> lock(queueMutex); return written; }
+        inline size_t getFailed()  const { std::lock_guard<std::mutex> lock(queueMutex); return failed; }
+
+    private:
+        std::vector<std::thread>                  workers;
+        std::deque<std::pair<Image, std::string>> queue;
+        size_t                                    maxPending;
+        size_t                                    active  = 0; // images taken from the queue and not yet written
+        size_t                                    written = 0;
+        size_t                                    failed  = 0;
+        bool                                      stopped = false;
+
+        mutable std::mutex      queueMutex;
+        std::condition_variable queueChanged;
+
+        void work();
+};
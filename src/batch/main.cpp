@@ -0,0 +1,227 @@
+
+#include <fstream>
+#include <iostream>
+#include <chrono>
+
+#include <RenderBase/rb.h>
+
+#include <SceneRenderer.h>
+#include <batch/Batch.h>
+#include <batch/ImageWriterPool.h>
+#include <chess/ChessScene.h>
+
+using namespace std;
+using namespace rb;
+
+/**
+ * PRGChessBatch - renders a stream of jobs without starting the application for each image.
+ *
+ * Usage: PRGChessBatch [--jobs jobs.jsonl|-] [--cpu] [--threads N] [--simd auto|avx2|scalar|off] [--writers N] [--max-pending N]
+ *                      [--models N] [--bake-sdf RESOLUTION] [--depth-prepass] [--penumbra K] [--generic-sdf]
+ *
+ * Jobs are read from the file or standard input, see BatchJobReader for their format. Program, scene buffers and
+ * generated geometry SDF stay resident, a job naming another scene reloads it and a job with models updates only
+ * the changed models. GL frames are read back through a ring of pixel buffers so that the next job renders before
+ * the previous image is mapped, images are encoded and written by ImageWriterPool.
+ * With --cpu the CPU renderer is used and no window is created.
+ */
+
+static BatchOptions options;
+static int          exitCode = 0;
+
+class BatchApp : public Application
+{
+    using Application::Application;
+
+    static constexpr uint32_t READBACK_BUFFERS = 2;
+
+    // frame copied to a pixel buffer, it is mapped when the buffer is needed again or at the end
+    struct Readback {
+        GLuint     buffer = 0;
+        GLsync     fence  = nullptr;
+        glm::uvec2 size   = glm::uvec2(0);
+        string     output = "";
+    };
+
+    unique_ptr<SceneRenderer>   renderer;
+    unique_ptr<ImageWriterPool> writers;
+    ifstream                    jobFile;
+    unique_ptr<BatchJobReader>  reader;
+    string                      loadedScene;
+    vector<Model>               board; // scene models which are not pieces, FEN positions are placed on them
+    bool                        sceneLoaded = false;
+    size_t                      rendered    = 0;
+    size_t                      failed      = 0;
+    bool                        finished    = false;
+
+    chrono::steady_clock::time_point start;
+
+    GLuint     framebuffer     = 0;
+    GLuint     renderbuffer    = 0;
+    glm::uvec2 framebufferSize = glm::uvec2(0);
+    Readback   readbacks[READBACK_BUFFERS];
+    uint32_t   readbackIndex   = 0;
+
+    bool init() {
+        glClearColor(0, 0, 0, 1);
+        renderer = make_unique<SceneRenderer>();
+        renderer->setDepthPrepass(options.depthPrepass);
+        renderer->setPenumbraFactor(options.penumbra);
+        if (!renderer->loadProgram()) {
+            cerr << "Error while creating a program: \n" << renderer->getErrorMessage() << endl;
+            exitCode = 1;
+            return false;
+        }
+
+        if (options.jobs != "-") {
+            jobFile.open(options.jobs);
+            if (!jobFile.good()) {
+                cerr << "Cannot open job list " << options.jobs << endl;
+                exitCode = 1;
+                return false;
+            }
+        }
+        reader  = make_unique<BatchJobReader>(options.jobs == "-" ? cin : jobFile);
+        writers = make_unique<ImageWriterPool>(options.writers, options.maxPending);
+        for (auto& readback : readbacks) {
+            glCreateBuffers(1, &readback.buffer);
+        }
+        start = chrono::steady_clock::now();
+        return true;
+    }
+
+    bool update(const Event &event) {
+        return true;
+    }
+
+    // every application frame renders one job
+    void draw() {
+        if (finished) {
+            return;
+        }
+        auto job = BatchJob();
+        if (!reader->next(job)) {
+            finish();
+            return;
+        }
+        if (!prepareJob(job)) {
+            ++failed;
+            return;
+        }
+
+        if (job.resolution != framebufferSize) {
+            resizeFramebuffer(job.resolution);
+        }
+        renderer->setCamera(job.camera());
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, job.resolution.x, job.resolution.y);
+        renderer->draw();
+        startReadback(job);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ++rendered;
+    }
+
+    // scene stays loaded until a job names another one, board state is applied to its models
+    bool prepareJob(const BatchJob& job) {
+        if (job.scene != loadedScene || !sceneLoaded) {
+            auto loadOptions          = SceneLoadOptions();
+            loadOptions.modelCount    = options.models;
+            loadOptions.sdfResolution = options.bakeSdf;
+            loadOptions.specializeSdf = !options.genericSdf;
+            loadedScene = job.scene;
+            sceneLoaded = renderer->loadScene(job.scene, loadOptions);
+            if (!sceneLoaded) {
+                cerr << "Line " << job.line << ": error while loading a scene: " << renderer->getErrorMessage() << endl;
+                return false;
+            }
+            board = renderer->getScene() != nullptr ? boardModels(renderer->getScene()->getScene()) : vector<Model>();
+        }
+        if (job.replaceModels || job.setPosition) {
+            if (renderer->getScene() == nullptr) {
+                cerr << "Line " << job.line << ": models of compiled scene " << job.scene << " cannot be replaced" << endl;
+                return false;
+            }
+            renderer->getScene()->setModels(jobModels(job, board)); // uploaded by the next draw
+        }
+        return true;
+    }
+
+    // pixels are copied to a buffer without waiting, the oldest buffer is finished first when it is needed
+    void startReadback(const BatchJob& job) {
+        auto& readback = readbacks[readbackIndex];
+        finishReadback(readback);
+        readbackIndex = (readbackIndex + 1) % READBACK_BUFFERS;
+
+        size_t size = size_t(job.resolution.x) * job.resolution.y * 3;
+        glNamedBufferData(readback.buffer, size, nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, job.resolution.x, job.resolution.y, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.size   = job.resolution;
+        readback.output = job.output;
+    }
+
+    // GL rows go bottom-up, image rows top-down
+    void finishReadback(Readback& readback) {
+        if (readback.fence == nullptr) {
+            return;
+        }
+        glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        auto   image  = Image(readback.size.x, readback.size.y);
+        size_t row    = size_t(readback.size.x) * 3;
+        auto   pixels = static_cast<const uint8_t*>(glMapNamedBuffer(readback.buffer, GL_READ_ONLY));
+        for (uint32_t y = 0; y < readback.size.y; ++y) {
+            copy_n(pixels + (readback.size.y - 1 - y) * row, row, image.pixels.data() + y * row);
+        }
+        glUnmapNamedBuffer(readback.buffer);
+        writers->submit(move(image), readback.output);
+    }
+
+    void resizeFramebuffer(glm::uvec2 size) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &renderbuffer);
+        glCreateRenderbuffers(1, &renderbuffer);
+        glNamedRenderbufferStorage(renderbuffer, GL_RGBA8, size.x, size.y);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+        framebufferSize = size;
+    }
+
+    void finish() {
+        for (uint32_t i = 0; i < READBACK_BUFFERS; ++i) {
+            finishReadback(readbacks[(readbackIndex + i) % READBACK_BUFFERS]); // in order of the jobs
+        }
+        writers->wait();
+
+        auto duration = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        failed += reader->getErrors() + writers->getFailed();
+        cout << "Rendered " << rendered << " jobs in " << duration << " ms (" << rendered * 1000.0 / max(duration, 1e-3) << " jobs/s), "
+             << writers->getWritten() << " images written, " << failed << " failed\n";
+        exitCode = failed > 0 ? 1 : 0;
+
+        for (auto& readback : readbacks) {
+            glDeleteBuffers(1, &readback.buffer);
+        }
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &renderbuffer);
+        finished = true;
+        exit();
+    }
+};
+
+int main(int argc, char *argv[]) {
+    if (!parseBatchOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.cpu) {
+        return runCpuBatch(options);
+    }
+    auto app = BatchApp(Configuration(argc, argv));
+    app.run();
+    return exitCode;
+}
@@ -0,0 +1,347 @@
+
+#include <bench/Benchmark.h>
+#include <cpu/CpuRenderer.h>
+#include <sceneUtils.h>
+#include <CommandLine.h>
+#include <SdfVolume.h>
+#include <CompiledScene.h>
+
+#include <RenderBase/tools/camera.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+using json = nlohmann::json;
+
+///////////////////////////////////////////////////////////////////////////////
+// OPTIONS
+///////////////////////////////////////////////////////////////////////////////
+
+static bool parseResolution(const string& value, glm::uvec2& resolution) {
+    size_t separator = value.find('x');
+    if (separator == string::npos) {
+        return false;
+    }
+    resolution = glm::uvec2(toUnsigned(value.substr(0, separator)), toUnsigned(value.substr(separator + 1)));
+    return resolution.x > 0 && resolution.y > 0;
+}
+
+bool parseBenchmarkOptions(int argc, char* argv[], BenchmarkOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--cpu") {
+            options.cpu = true;
+            continue;
+        }
+        if (arg == "--reprojection") {
+            options.reprojection = true;
+            continue;
+        }
+        if (arg == "--depth-prepass") {
+            options.depthPrepass = true;
+            continue;
+        }
+        if (arg == "--traversal-stats") {
+            options.traversalStats = true;
+            continue;
+        }
+        if (arg == "--generic-sdf") {
+            options.genericSdf = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for argument " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        bool parsed = parseArgumentValue(arg, value, [&]() {
+            if      (arg == "--scene")    options.scenes.push_back(value);
+            else if (arg == "--path")     options.paths.push_back(value);
+            else if (arg == "--frames")   options.frames  = toUnsigned(value);
+            else if (arg == "--warmup")   options.warmup  = toUnsigned(value);
+            else if (arg == "--output")   options.output  = value;
+            else if (arg == "--threads")  options.threads = toUnsigned(value);
+            else if (arg == "--simd")     options.kernels = packetKernelTypeFromString(value);
+            else if (arg == "--models")   options.models  = toUnsigned(value);
+            else if (arg == "--bake-sdf") options.bakeSdf = toUnsigned(value);
+            else if (arg == "--penumbra") options.penumbra = stof(value);
+            else if (arg == "--pixel-counters") options.pixelCounters = value;
+            else if (arg == "--resolution") {
+                auto resolution = glm::uvec2();
+                if (!parseResolution(value, resolution)) {
+                    cerr << "Resolution has to be given as WIDTHxHEIGHT, got " << value << endl;
+                    return false;
+                }
+                options.resolutions.push_back(resolution);
+            } else {
+                cerr << "Unknown argument " << arg << endl;
+                return false;
+            }
+            return true;
+        });
+        if (!parsed) {
+            return false;
+        }
+    }
+
+    if (options.scenes.empty()) {
+        options.scenes.push_back(RESOURCE_SCENE_JSON);
+    }
+    if (options.resolutions.empty()) {
+        options.resolutions = { { 640, 360 }, { 1280, 720 } };
+    }
+    if (options.paths.empty()) {
+        for (const auto& path : defaultCameraPaths()) {
+            options.paths.push_back(path.name);
+        }
+    }
+    for (const auto& name : options.paths) {
+        auto& paths = defaultCameraPaths();
+        if (none_of(paths.begin(), paths.end(), [&](const auto& path) { return path.name == name; })) {
+            cerr << "Unknown camera path " << name << endl;
+            return false;
+        }
+    }
+    return options.frames > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CAMERA PATHS
+///////////////////////////////////////////////////////////////////////////////
+
+RayCamera CameraPath::at(float t, float aspectRatio) const {
+    float d  = glm::mix(distance.x, distance.y, t);
+    float az = glm::radians(glm::mix(azimuth.x, azimuth.y, t));
+    float el = glm::radians(glm::mix(elevation.x, elevation.y, t));
+
+    auto cam = make_shared<rb::Camera>(glm::vec3(0, 1, 0));
+    cam->setFov(glm::radians(60.0f));
+    cam->setAspectRatio(aspectRatio);
+    cam->setPosition(target + d * glm::vec3(glm::cos(el) * glm::sin(az), glm::sin(el), -glm::cos(el) * glm::cos(az)));
+    cam->setTargetPosition(target);
+    return RayCamera::fromCamera(cam);
+}
+
+const vector<CameraPath>& defaultCameraPaths() {
+    static const vector<CameraPath> paths = {
+        { "orbit",     glm::vec3(0), glm::vec2(glm::sqrt(200.0f)), glm::vec2(0, 360),  glm::vec2(45) },     // default view around the board
+        { "low-orbit", glm::vec3(0), glm::vec2(10),                glm::vec2(0, 360),  glm::vec2(12) },     // grazing rays passing many pieces
+        { "dolly",     glm::vec3(0), glm::vec2(20, 5),             glm::vec2(30, 60),  glm::vec2(70, 20) }, // from overview to close-up
+    };
+    return paths;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// REPORT
+///////////////////////////////////////////////////////////////////////////////
+
+TimingStats computeTimingStats(vector<double> samples) {
+    auto stats = TimingStats();
+    if (samples.empty()) {
+        return stats;
+    }
+    sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        size_t rank = size_t(ceil(p / 100.0 * samples.size()));
+        return samples[min(max(rank, size_t(1)), samples.size()) - 1];
+    };
+    for (double sample : samples) {
+        stats.mean += sample;
+    }
+    stats.mean /= samples.size();
+    stats.min   = samples.front();
+    stats.max   = samples.back();
+    stats.p50   = percentile(50);
+    stats.p90   = percentile(90);
+    stats.p95   = percentile(95);
+    stats.p99   = percentile(99);
+    return stats;
+}
+
+bool writeBenchmarkReport(const string& file, const string& renderer, const string& device,
+                          const BenchmarkOptions& options, const vector<BenchmarkRun>& runs) {
+    auto report = json {
+        { "renderer",       renderer },
+        { "device",         device },
+        { "frames",         options.frames },
+        { "warmup",         options.warmup },
+        { "reprojection",   options.reprojection },
+        { "depthPrepass",   options.depthPrepass },
+        { "penumbra",       options.penumbra },
+        { "traversalStats", options.traversalStats },
+        { "genericSdf",     options.genericSdf },
+        { "runs",           json::array() },
+    };
+    for (const auto& run : runs) {
+        auto stages = json::object();
+        for (const auto& [name, ms] : run.stages) {
+            stages[name] = ms;
+        }
+        auto frames = json::object();
+        for (const auto& [clock, samples] : run.frames) {
+            auto stats = computeTimingStats(samples);
+            frames[clock] = {
+                { "mean", stats.mean }, { "min", stats.min }, { "max", stats.max },
+                { "p50",  stats.p50 },  { "p90", stats.p90 }, { "p95", stats.p95 }, { "p99", stats.p99 },
+            };
+        }
+        auto entry = json {
+            { "scene",            run.scene },
+            { "path",             run.path },
+            { "resolution",       { run.resolution.x, run.resolution.y } },
+            { "stages",           stages },
+            { "frames",           frames },
+            { "nodeVisitsPerRay", run.nodeVisitsPerRay },
+        };
+        if (!run.pixelCounters.empty()) {
+            auto counters = json::object();
+            for (const auto& histogram : run.pixelCounters) {
+                counters[pixelCounterName(histogram.counter)] = {
+                    { "mean", histogram.mean }, { "p50", histogram.p50 }, { "p90", histogram.p90 }, { "p99", histogram.p99 }, { "max", histogram.max },
+                };
+            }
+            entry["pixelCounters"] = counters;
+            entry["counterFiles"]  = run.counterFiles;
+        }
+        report["runs"].push_back(entry);
+    }
+
+    ofstream stream(file, ios::trunc);
+    stream << setw(4) << report << "\n";
+    return stream.good();
+}
+
+bool recordPixelCounters(const BenchmarkOptions& options, size_t runIndex, const PixelCounters& counters, BenchmarkRun& run) {
+    run.counterFiles = options.pixelCounters + "_" + to_string(runIndex) + "_" + run.path + "_"
+                     + to_string(run.resolution.x) + "x" + to_string(run.resolution.y);
+    run.pixelCounters.clear();
+    for (uint32_t i = 0; i < PIXEL_COUNTER_COUNT; ++i) {
+        run.pixelCounters.push_back(computeHistogram(counters, PixelCounter(i)));
+    }
+    return writePixelCounters(counters, run.counterFiles);
+}
+
+void printBenchmarkSummary(const vector<BenchmarkRun>& runs) {
+    cout << "scene, path, resolution, clock, mean [ms], p50 [ms], p90 [ms], p99 [ms]\n";
+    for (const auto& run : runs) {
+        if (run.frames.empty()) {
+            continue;
+        }
+        const auto& [clock, samples] = *run.frames.begin();
+        auto stats = computeTimingStats(samples);
+        cout << run.scene << ", " << run.path << ", " << run.resolution.x << "x" << run.resolution.y << ", " << clock << ", "
+             << stats.mean << ", " << stats.p50 << ", " << stats.p90 << ", " << stats.p99 << "\n";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CPU BENCHMARK
+///////////////////////////////////////////////////////////////////////////////
+
+static double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// same stages as SceneRenderer reports for GL
+static bool loadBenchmarkScene(const BenchmarkOptions& options, const string& file, ShaderSceneData& data,
+                               vector<pair<string, double>>& stages) {
+    auto start = chrono::steady_clock::now();
+    if (isCompiledSceneFile(file)) {
+        auto compiled = CompiledScene(file);
+        if (!compiled.isValid()) {
+            cerr << compiled.getErrorMessage() << endl;
+            return false;
+        }
+        data = compiled.toShaderSceneData();
+        stages.push_back({ "parse", millisecondsSince(start) });
+        return true;
+    }
+
+    auto scene = unique_ptr<Scene>();
+    try {
+        scene = buildSceneFromJson(file);
+        if (options.models > 0) {
+            replicateModels(*scene, options.models);
+        }
+    } catch (const exception& e) {
+        cerr << "Error while loading a scene: " << e.what() << endl;
+        return false;
+    }
+    stages.push_back({ "parse", millisecondsSince(start) });
+
+    start = chrono::steady_clock::now();
+    data  = prepareShaderSceneData(*scene);
+    stages.push_back({ "prepare",  millisecondsSince(start) });
+    stages.push_back({ "bvhBuild", data.bvhReport.buildTime.count() / 1000.0 });
+
+    if (options.bakeSdf > 0) {
+        auto volumeOptions       = SdfVolumeOptions();
+        volumeOptions.resolution = options.bakeSdf;
+        volumeOptions.threads    = options.threads;
+        stages.push_back({ "bake", bakeSdfVolumes(data, volumeOptions).duration.count() / 1000.0 });
+    }
+    return true;
+}
+
+int runCpuBenchmark(const BenchmarkOptions& options) {
+    vector<BenchmarkRun> runs;
+    string device;
+    for (const auto& sceneFile : options.scenes) {
+        auto data   = ShaderSceneData();
+        auto stages = vector<pair<string, double>>();
+        if (!loadBenchmarkScene(options, sceneFile, data, stages)) {
+            return 1;
+        }
+        auto renderer = CpuRenderer(move(data), options.kernels);
+        renderer.depthPrepass   = options.depthPrepass;
+        renderer.penumbraFactor = options.penumbra;
+        renderer.specializedSdf = !options.genericSdf;
+
+        for (auto resolution : options.resolutions) {
+            auto image = Image(resolution.x, resolution.y);
+            for (const auto& path : defaultCameraPaths()) {
+                if (find(options.paths.begin(), options.paths.end(), path.name) == options.paths.end()) {
+                    continue;
+                }
+                float aspectRatio = float(resolution.x) / float(resolution.y);
+                for (uint32_t frame = 0; frame < options.warmup; ++frame) {
+                    renderer.render(path.at(0.0f, aspectRatio), image, options.threads);
+                }
+
+                auto run       = BenchmarkRun();
+                run.scene      = sceneFile;
+                run.path       = path.name;
+                run.resolution = resolution;
+                run.stages     = stages;
+                for (uint32_t frame = 0; frame < options.frames; ++frame) {
+                    auto report = renderer.render(path.at(float(frame) / options.frames, aspectRatio), image, options.threads);
+                    run.frames["wall"].push_back(report.duration.count() / 1000.0);
+                    run.nodeVisitsPerRay += report.nodeVisitsPerRay() / options.frames;
+                    device = string("cpu ") + renderer.getKernelName() + " kernels, " + to_string(report.threads) + " threads";
+                }
+                if (!options.pixelCounters.empty()) {
+                    auto counters = PixelCounters();
+                    renderer.render(path.at(0.0f, aspectRatio), image, options.threads, &counters);
+                    if (!recordPixelCounters(options, runs.size(), counters, run)) {
+                        cerr << "Error while writing pixel counters " << run.counterFiles << endl;
+                        return 1;
+                    }
+                }
+                runs.push_back(move(run));
+            }
+        }
+    }
+
+    printBenchmarkSummary(runs);
+    if (!writeBenchmarkReport(options.output, "cpu", device, options, runs)) {
+        cerr << "Error while writing benchmark report " << options.output << endl;
+        return 1;
+    }
+    return 0;
+}
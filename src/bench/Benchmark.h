@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cpu/PacketKernels.h>
+#include <RayCamera.h>
+#include <PixelCounters.h>
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchmarkOptions {
+    std::vector<std::string> scenes;      // RESOURCE_SCENE_JSON when none is given
+    std::vector<glm::uvec2>  resolutions; // 640x360 and 1280x720 when none is given
+    std::vector<std::string> paths;       // all default camera paths when none is given
+    uint32_t    frames         = 60; // measured frames per path
+    uint32_t    warmup         = 5;  // frames rendered before measurement
+    std::string output         = "bench.json";
+    bool        cpu            = false;
+    uint32_t    threads        = 0;
+    size_t      models         = 0;     // replicate models of json scenes to this count when set
+    uint32_t    bakeSdf        = 0;     // resolution of baked SDF volumes, 0 disables baking
+    bool        reprojection   = false; // GL primary rays seeded from the previous frame
+    bool        depthPrepass   = false; // primary rays seeded by cone marched prepass
+    float       penumbra       = 0;     // soft shadow factor, 0 for hard shadows
+    bool        traversalStats = false; // GL fragments count BVH node visits by atomics, CPU counts them always
+    bool        genericSdf     = false; // sdPrimitives interpreter instead of generated per geometry functions
+    std::string pixelCounters  = "";    // prefix of per pixel counters of one extra frame of every run, empty disables counting
+
+    PacketKernelType kernels = PacketKernelType::pkAuto;
+};
+
+// false on unknown or malformed argument, defaults are filled for empty lists
+bool parseBenchmarkOptions(int argc, char* argv[], BenchmarkOptions& options);
+
+/**
+ * Scripted orbit around target, azimuth, elevation and distance are interpolated linearly along the path.
+ * Azimuth 0 and elevation 45 degrees at distance of sqrt(200) is the default view of the application.
+ */
+struct CameraPath {
+    std::string name;
+    glm::vec3   target;
+    glm::vec2   distance;  // begin, end
+    glm::vec2   azimuth;   // degrees
+    glm::vec2   elevation; // degrees above the board
+
+    // t in <0, 1)
+    RayCamera at(float t, float aspectRatio) const;
+};
+
+const std::vector<CameraPath>& defaultCameraPaths();
+
+struct TimingStats {
+    double mean = 0;
+    double min  = 0;
+    double max  = 0;
+    double p50  = 0;
+    double p90  = 0;
+    double p95  = 0;
+    double p99  = 0;
+};
+
+// nearest rank percentiles of samples
+TimingStats computeTimingStats(std::vector<double> samples);
+
+struct BenchmarkRun {
+    std::string scene;
+    std::string path;
+    glm::uvec2  resolution;
+
+    std::vector<std::pair<std::string, double>>  stages; // one time stages such as scene load in ms
+    std::map<std::string, std::vector<double>>   frames; // per frame times in ms keyed by clock, e.g. gpu or wall
+    double nodeVisitsPerRay = 0; // mean over measured frames, 0 when not counted
+
+    std::vector<CounterHistogram> pixelCounters; // one instrumented frame at the start of the path, empty when not counted
+    std::string                   counterFiles;  // prefix of heatmaps and histograms written for the run
+};
+
+/**
+ * Writes runs as JSON:
+ *   { renderer, device, frames, warmup, runs: [{ scene, path, resolution: [w, h], stages: { name: ms }, frames: { clock: TimingStats }, nodeVisitsPerRay,
+ *                                              pixelCounters: { counter: { mean, p50, p90, p99, max } }, counterFiles }] }
+ * pixelCounters and counterFiles are present only when counted.
+ */
+bool writeBenchmarkReport(const std::string& file, const std::string& renderer, const std::string& device,
+                          const BenchmarkOptions& options, const std::vector<BenchmarkRun>& runs);
+
+// histograms are stored to the run and heatmaps written to <options.pixelCounters>_<runIndex>_<path>_<w>x<h>, false on write error
+bool recordPixelCounters(const BenchmarkOptions& options, size_t runIndex, const PixelCounters& counters, BenchmarkRun& run);
+
+// human readable table of mean and percentiles of the first clock of every run
+void printBenchmarkSummary(const std::vector<BenchmarkRun>& runs);
+
+// renders all scenes, resolutions and paths by CpuRenderer timing frames by wall clock
+int runCpuBenchmark(const BenchmarkOptions& options);
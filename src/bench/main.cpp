@@ -0,0 +1,225 @@
+
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+
+#include <RenderBase/rb.h>
+
+#include <SceneRenderer.h>
+#include <bench/Benchmark.h>
+
+using namespace std;
+using namespace rb;
+
+/**
+ * PRGChessBench - deterministic benchmark of the ray marcher.
+ *
+ * Usage: PRGChessBench [--cpu] [--scene file]... [--resolution WxH]... [--path orbit|low-orbit|dolly]...
+ *                      [--frames N] [--warmup N] [--output bench.json] [--models N] [--bake-sdf RESOLUTION]
+ *                      [--threads N] [--simd auto|avx2|scalar|off] [--reprojection] [--depth-prepass] [--penumbra K]
+ *                      [--traversal-stats] [--generic-sdf] [--pixel-counters PREFIX]
+ *
+ * Scenes are rendered along scripted camera paths to an offscreen framebuffer without FPS cap,
+ * GL frames are timed by GPU timer queries and by wall clock until the query result is available.
+ * With --cpu the CPU renderer is used and no window is created.
+ * With --pixel-counters one more frame at the start of every path is rendered with per pixel counters,
+ * their heatmaps and histograms are written to PREFIX_<run>_<path>_<w>x<h>_* and summarized in the report.
+ */
+
+static BenchmarkOptions options;
+static int              exitCode = 0;
+
+// one scene, resolution and path measured over consecutive frames
+struct BenchmarkTask {
+    size_t            scene;
+    glm::uvec2        resolution;
+    const CameraPath* path;
+};
+
+class BenchApp : public Application
+{
+    using Application::Application;
+
+    unique_ptr<SceneRenderer>    renderer;
+    vector<BenchmarkTask>        tasks;
+    vector<BenchmarkRun>         runs;
+    size_t                       taskIndex   = 0;
+    uint32_t                     frame       = 0;
+    bool                         finished    = false;
+    size_t                       loadedScene = SIZE_MAX;
+    double                       programTime = 0;
+    vector<pair<string, double>> sceneStages;
+
+    GLuint     framebuffer     = 0;
+    GLuint     renderbuffer    = 0;
+    glm::uvec2 framebufferSize = glm::uvec2(0);
+    GLuint     timerQuery      = 0;
+
+    bool init() {
+        // frames are not capped so that timings measure the renderer only
+        glClearColor(0, 0, 0, 1);
+        renderer = make_unique<SceneRenderer>();
+        renderer->setReprojection(options.reprojection);
+        renderer->setDepthPrepass(options.depthPrepass);
+        renderer->setPenumbraFactor(options.penumbra);
+        renderer->setTraversalStats(options.traversalStats);
+
+        auto start = chrono::steady_clock::now();
+        if (!renderer->loadProgram()) {
+            cerr << "Error while creating a program: \n" << renderer->getErrorMessage() << endl;
+            exitCode = 1;
+            return false;
+        }
+        programTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        for (size_t scene = 0; scene < options.scenes.size(); ++scene) {
+            for (auto resolution : options.resolutions) {
+                for (const auto& path : defaultCameraPaths()) {
+                    if (find(options.paths.begin(), options.paths.end(), path.name) != options.paths.end()) {
+                        tasks.push_back({ scene, resolution, &path });
+                    }
+                }
+            }
+        }
+        glCreateQueries(GL_TIME_ELAPSED, 1, &timerQuery);
+        return true;
+    }
+
+    bool update(const Event &event) {
+        return true;
+    }
+
+    // every application frame renders one benchmark frame, warm up frames are not measured
+    void draw() {
+        if (taskIndex >= tasks.size()) {
+            if (!finished) {
+                finish();
+            }
+            return;
+        }
+        const auto& task = tasks[taskIndex];
+        if (frame == 0 && !startTask(task)) {
+            exitCode = 1;
+            exit();
+            return;
+        }
+
+        bool  measured = frame >= options.warmup;
+        float t        = measured ? float(frame - options.warmup) / options.frames : 0.0f;
+        renderer->setCamera(task.path->at(t, float(task.resolution.x) / float(task.resolution.y)));
+
+        auto start = chrono::steady_clock::now();
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, task.resolution.x, task.resolution.y);
+        glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+        renderer->draw();
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 gpuTime = 0;
+        glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &gpuTime); // waits for the frame
+        double wallTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (measured) {
+            runs.back().frames["gpu"].push_back(gpuTime / 1e6);
+            runs.back().frames["wall"].push_back(wallTime);
+            runs.back().nodeVisitsPerRay += renderer->getTraversalStats().nodeVisitsPerRay() / options.frames;
+        }
+        if (++frame == options.warmup + options.frames) {
+            if (!options.pixelCounters.empty() && !drawPixelCounters(task)) {
+                exitCode = 1;
+                exit();
+                return;
+            }
+            frame = 0;
+            ++taskIndex;
+        }
+    }
+
+    // extra frame which is not timed, counters slow the fragments down by atomics
+    bool drawPixelCounters(const BenchmarkTask& task) {
+        renderer->setPixelCounters(true);
+        renderer->setCamera(task.path->at(0.0f, float(task.resolution.x) / float(task.resolution.y)));
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, task.resolution.x, task.resolution.y);
+        renderer->draw();
+        auto counters = renderer->getPixelCounters();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        renderer->setPixelCounters(false);
+
+        if (!recordPixelCounters(options, runs.size() - 1, counters, runs.back())) {
+            cerr << "Error while writing pixel counters " << runs.back().counterFiles << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool startTask(const BenchmarkTask& task) {
+        if (task.scene != loadedScene) {
+            auto loadOptions          = SceneLoadOptions();
+            loadOptions.modelCount    = options.models;
+            loadOptions.sdfResolution = options.bakeSdf;
+            loadOptions.specializeSdf = !options.genericSdf;
+            if (!renderer->loadScene(options.scenes[task.scene], loadOptions)) {
+                cerr << "Error while loading a scene: " << renderer->getErrorMessage() << endl;
+                return false;
+            }
+            const auto& report = renderer->getLoadReport();
+            sceneStages = {
+                { "program",  programTime }, // shared by all scenes
+                { "parse",    report.parse.count() / 1000.0 },
+                { "prepare",  report.prepare.count() / 1000.0 },
+                { "bvhBuild", report.bvh.buildTime.count() / 1000.0 },
+                { "bake",     report.bake.count() / 1000.0 },
+                { "upload",   report.upload.count() / 1000.0 },
+            };
+            loadedScene = task.scene;
+        }
+        if (task.resolution != framebufferSize) {
+            resizeFramebuffer(task.resolution);
+        }
+
+        auto run       = BenchmarkRun();
+        run.scene      = options.scenes[task.scene];
+        run.path       = task.path->name;
+        run.resolution = task.resolution;
+        run.stages     = sceneStages;
+        runs.push_back(move(run));
+        return true;
+    }
+
+    void resizeFramebuffer(glm::uvec2 size) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &renderbuffer);
+        glCreateRenderbuffers(1, &renderbuffer);
+        glNamedRenderbufferStorage(renderbuffer, GL_RGBA8, size.x, size.y);
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+        framebufferSize = size;
+    }
+
+    void finish() {
+        auto device = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        printBenchmarkSummary(runs);
+        if (!writeBenchmarkReport(options.output, "gl", device != nullptr ? device : "", options, runs)) {
+            cerr << "Error while writing benchmark report " << options.output << endl;
+            exitCode = 1;
+        }
+        glDeleteQueries(1, &timerQuery);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &renderbuffer);
+        finished = true;
+        exit();
+    }
+};
+
+int main(int argc, char *argv[]) {
+    if (!parseBenchmarkOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.cpu) {
+        return runCpuBenchmark(options);
+    }
+    auto app = BenchApp(Configuration(argc, argv));
+    app.run();
+    return exitCode;
+}
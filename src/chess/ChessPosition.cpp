@@ -0,0 +1,353 @@
+
+#include <chess/ChessPosition.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+static constexpr int KNIGHT_STEPS[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+static constexpr int KING_STEPS[8][2]   = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+
+static PieceType pieceTypeFromLetter(char letter) {
+    switch (toupper(letter)) {
+        case 'P': return PieceType::ptPawn;
+        case 'N': return PieceType::ptKnight;
+        case 'B': return PieceType::ptBishop;
+        case 'R': return PieceType::ptRook;
+        case 'Q': return PieceType::ptQueen;
+        case 'K': return PieceType::ptKing;
+        default:  return PieceType::ptNone;
+    }
+}
+
+static char pieceLetter(const Piece& piece) {
+    static constexpr const char* LETTERS = ".PNBRQK";
+    char letter = LETTERS[piece.type];
+    return piece.color == ChessColor::ccBlack ? char(tolower(letter)) : letter;
+}
+
+static int parseSquare(const string& text) {
+    if (text.size() != 2 || text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8') {
+        return -1;
+    }
+    return ChessPosition::square(text[0] - 'a', text[1] - '1');
+}
+
+static string squareName(int square) {
+    return { char('a' + square % 8), char('1' + square / 8) };
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FEN
+///////////////////////////////////////////////////////////////////////////////
+
+bool ChessPosition::setFen(const string& fen, string& error) {
+    auto stream = istringstream(fen);
+    string placement, side, castle = "-", passant = "-";
+    uint32_t halfmove = 0, fullmove = 1;
+    if (!(stream >> placement >> side)) {
+        error = "FEN needs piece placement and side to move";
+        return false;
+    }
+    stream >> castle >> passant >> halfmove >> fullmove; // optional, EPD style positions end after the side
+
+    auto result = ChessPosition();
+    int  file = 0, rank = 7;
+    for (char c : placement) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) {
+                error = "FEN rank " + to_string(rank + 1) + " does not have 8 squares";
+                return false;
+            }
+            file = 0;
+            --rank;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+        } else if (pieceTypeFromLetter(c) != PieceType::ptNone && file < 8) {
+            result.board[square(file, rank)] = { pieceTypeFromLetter(c), isupper(c) ? ChessColor::ccWhite : ChessColor::ccBlack };
+            ++file;
+        } else {
+            error = string("unexpected character ") + c + " in FEN piece placement";
+            return false;
+        }
+        if (file > 8) {
+            error = "FEN rank " + to_string(rank + 1) + " has more than 8 squares";
+            return false;
+        }
+    }
+    if (file != 8 || rank != 0) {
+        error = "FEN piece placement does not have 8 ranks";
+        return false;
+    }
+
+    if (side != "w" && side != "b") {
+        error = "FEN side to move must be w or b";
+        return false;
+    }
+    result.sideToMove = side == "w" ? ChessColor::ccWhite : ChessColor::ccBlack;
+    if (castle != "-") {
+        for (char c : castle) {
+            switch (c) {
+                case 'K': result.castling |= CASTLE_WHITE_KING;  break;
+                case 'Q': result.castling |= CASTLE_WHITE_QUEEN; break;
+                case 'k': result.castling |= CASTLE_BLACK_KING;  break;
+                case 'q': result.castling |= CASTLE_BLACK_QUEEN; break;
+                default:
+                    error = string("unexpected character ") + c + " in FEN castling rights";
+                    return false;
+            }
+        }
+    }
+    if (passant != "-" && (result.enPassant = parseSquare(passant)) < 0) {
+        error = "FEN en passant square " + passant + " is not a square";
+        return false;
+    }
+    result.halfmoveClock  = halfmove;
+    result.fullmoveNumber = fullmove;
+    *this = result;
+    return true;
+}
+
+string ChessPosition::getFen() const {
+    auto fen = ostringstream();
+    for (int rank = 7; rank >= 0; --rank) {
+        int empty = 0;
+        for (int file = 0; file < 8; ++file) {
+            const auto& piece = board[square(file, rank)];
+            if (piece.type == PieceType::ptNone) {
+                ++empty;
+                continue;
+            }
+            if (empty > 0) {
+                fen << empty;
+                empty = 0;
+            }
+            fen << pieceLetter(piece);
+        }
+        if (empty > 0) {
+            fen << empty;
+        }
+        if (rank > 0) {
+            fen << '/';
+        }
+    }
+
+    fen << (sideToMove == ChessColor::ccWhite ? " w " : " b ");
+    if (castling == 0) fen << '-';
+    if (castling & CASTLE_WHITE_KING)  fen << 'K';
+    if (castling & CASTLE_WHITE_QUEEN) fen << 'Q';
+    if (castling & CASTLE_BLACK_KING)  fen << 'k';
+    if (castling & CASTLE_BLACK_QUEEN) fen << 'q';
+    fen << ' ' << (enPassant < 0 ? "-" : squareName(enPassant)) << ' ' << halfmoveClock << ' ' << fullmoveNumber;
+    return fen.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MOVES
+///////////////////////////////////////////////////////////////////////////////
+
+// movement rules of the piece standing on from, capture selects the diagonal pawn move
+bool ChessPosition::canReach(int from, int to, bool capture) const {
+    const auto& piece = board[from];
+    int df = to % 8 - from % 8;
+    int dr = to / 8 - from / 8;
+
+    switch (piece.type) {
+        case PieceType::ptPawn: {
+            int forward = piece.color == ChessColor::ccWhite ? 1 : -1;
+            if (capture) {
+                return abs(df) == 1 && dr == forward;
+            }
+            if (df != 0 || board[to].type != PieceType::ptNone) {
+                return false;
+            }
+            int startRank = piece.color == ChessColor::ccWhite ? 1 : 6;
+            return dr == forward || (dr == 2 * forward && from / 8 == startRank && board[from + 8 * forward].type == PieceType::ptNone);
+        }
+        case PieceType::ptKnight:
+            return (abs(df) == 1 && abs(dr) == 2) || (abs(df) == 2 && abs(dr) == 1);
+        case PieceType::ptKing:
+            return max(abs(df), abs(dr)) == 1;
+        case PieceType::ptBishop:
+        case PieceType::ptRook:
+        case PieceType::ptQueen: {
+            bool straight = df == 0 || dr == 0;
+            bool diagonal = abs(df) == abs(dr);
+            if ((df == 0 && dr == 0) || (!straight && !diagonal)
+                || (piece.type == PieceType::ptBishop && !diagonal)
+                || (piece.type == PieceType::ptRook && !straight)) {
+                return false;
+            }
+            int step = (dr > 0 ? 8 : dr < 0 ? -8 : 0) + (df > 0 ? 1 : df < 0 ? -1 : 0);
+            for (int s = from + step; s != to; s += step) {
+                if (board[s].type != PieceType::ptNone) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool ChessPosition::isAttacked(int target, ChessColor byColor) const {
+    int tf = target % 8, tr = target / 8;
+    for (int from = 0; from < 64; ++from) {
+        const auto& piece = board[from];
+        if (piece.type == PieceType::ptNone || piece.color != byColor) {
+            continue;
+        }
+        if (piece.type == PieceType::ptPawn) {
+            int forward = byColor == ChessColor::ccWhite ? 1 : -1;
+            if (abs(tf - from % 8) == 1 && tr - from / 8 == forward) {
+                return true;
+            }
+        } else if (canReach(from, target, true)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// only needed when several pieces can reach the square, one of them is pinned
+bool ChessPosition::leavesKingInCheck(int from, int to) const {
+    auto after = *this;
+    after.makeMove(from, to, PieceType::ptQueen);
+    for (int s = 0; s < 64; ++s) {
+        if (after.board[s].type == PieceType::ptKing && after.board[s].color == sideToMove) {
+            return after.isAttacked(s, sideToMove == ChessColor::ccWhite ? ChessColor::ccBlack : ChessColor::ccWhite);
+        }
+    }
+    return false;
+}
+
+void ChessPosition::makeMove(int from, int to, PieceType promotion) {
+    auto piece   = board[from];
+    bool capture = board[to].type != PieceType::ptNone;
+    int  rank    = from / 8;
+
+    if (piece.type == PieceType::ptPawn && to == enPassant && !capture) {
+        board[square(to % 8, rank)] = Piece(); // captured pawn stands beside
+        capture = true;
+    }
+    if (piece.type == PieceType::ptKing && abs(to - from) == 2) {
+        bool kingSide = to > from;
+        int  rookFrom = square(kingSide ? 7 : 0, rank);
+        int  rookTo   = square(kingSide ? 5 : 3, rank);
+        board[rookTo]   = board[rookFrom];
+        board[rookFrom] = Piece();
+    }
+
+    board[to]   = piece;
+    board[from] = Piece();
+    if (piece.type == PieceType::ptPawn && (to / 8 == 0 || to / 8 == 7)) {
+        board[to].type = promotion;
+    }
+
+    // rights are lost by moving the king or a rook and by a rook being captured
+    for (int s : { from, to }) {
+        if (s == square(4, 0)) castling &= ~(CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN);
+        if (s == square(4, 7)) castling &= ~(CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN);
+        if (s == square(7, 0)) castling &= ~CASTLE_WHITE_KING;
+        if (s == square(0, 0)) castling &= ~CASTLE_WHITE_QUEEN;
+        if (s == square(7, 7)) castling &= ~CASTLE_BLACK_KING;
+        if (s == square(0, 7)) castling &= ~CASTLE_BLACK_QUEEN;
+    }
+
+    enPassant     = piece.type == PieceType::ptPawn && abs(to - from) == 16 ? (from + to) / 2 : -1;
+    halfmoveClock = piece.type == PieceType::ptPawn || capture ? 0 : halfmoveClock + 1;
+    if (sideToMove == ChessColor::ccBlack) {
+        ++fullmoveNumber;
+    }
+    sideToMove = sideToMove == ChessColor::ccWhite ? ChessColor::ccBlack : ChessColor::ccWhite;
+}
+
+bool ChessPosition::applySan(const string& san, string& error) {
+    auto move = san;
+    while (!move.empty() && (move.back() == '+' || move.back() == '#' || move.back() == '!' || move.back() == '?')) {
+        move.pop_back();
+    }
+
+    int homeRank = sideToMove == ChessColor::ccWhite ? 0 : 7;
+    if (move == "O-O" || move == "0-0" || move == "O-O-O" || move == "0-0-0") {
+        int from = square(4, homeRank);
+        if (board[from].type != PieceType::ptKing || board[from].color != sideToMove) {
+            error = "cannot castle " + san + ", the king has moved";
+            return false;
+        }
+        makeMove(from, square(move.size() == 3 ? 6 : 2, homeRank), PieceType::ptNone);
+        return true;
+    }
+
+    // [piece][from file][from rank][x]target[=promotion]
+    auto promotion = PieceType::ptNone;
+    auto equals    = move.find('=');
+    if (equals != string::npos && equals + 1 < move.size()) {
+        promotion = pieceTypeFromLetter(move[equals + 1]);
+        move      = move.substr(0, equals);
+    } else if (move.size() > 2 && pieceTypeFromLetter(move.back()) != PieceType::ptNone && isupper(move.back())) {
+        promotion = pieceTypeFromLetter(move.back()); // e8Q
+        move.pop_back();
+    }
+
+    auto type = PieceType::ptPawn;
+    if (!move.empty() && isupper(move[0])) {
+        type = pieceTypeFromLetter(move[0]);
+        move = move.substr(1);
+    }
+    int to = move.size() >= 2 ? parseSquare(move.substr(move.size() - 2)) : -1;
+    if (type == PieceType::ptNone || to < 0) {
+        error = "cannot read move " + san;
+        return false;
+    }
+    if (board[to].type != PieceType::ptNone && board[to].color == sideToMove) {
+        error = "move " + san + " lands on an own piece in " + getFen();
+        return false;
+    }
+    move.resize(move.size() - 2);
+
+    bool capture  = false;
+    int  fromFile = -1, fromRank = -1;
+    for (char c : move) {
+        if      (c == 'x' || c == ':')  capture  = true;
+        else if (c >= 'a' && c <= 'h')  fromFile = c - 'a';
+        else if (c >= '1' && c <= '8')  fromRank = c - '1';
+        else if (c != '-') {
+            error = "cannot read move " + san;
+            return false;
+        }
+    }
+    if (type == PieceType::ptPawn) {
+        capture = capture || fromFile >= 0; // "ed5" without x
+        if (promotion == PieceType::ptNone) promotion = PieceType::ptQueen;
+    }
+
+    auto candidates = vector<int>();
+    for (int from = 0; from < 64; ++from) {
+        const auto& piece = board[from];
+        if (piece.type == type && piece.color == sideToMove
+            && (fromFile < 0 || from % 8 == fromFile) && (fromRank < 0 || from / 8 == fromRank)
+            && canReach(from, to, type == PieceType::ptPawn && capture)) {
+            candidates.push_back(from);
+        }
+    }
+    if (candidates.size() > 1) {
+        auto legal = vector<int>();
+        for (int from : candidates) {
+            if (!leavesKingInCheck(from, to)) {
+                legal.push_back(from);
+            }
+        }
+        candidates = legal;
+    }
+    if (candidates.size() != 1) {
+        error = (candidates.empty() ? "no piece can play " : "ambiguous move ") + san + " in " + getFen();
+        return false;
+    }
+
+    makeMove(candidates[0], to, promotion);
+    return true;
+}
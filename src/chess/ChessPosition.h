@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum PieceType {
+    ptNone   = 0,
+    ptPawn   = 1,
+    ptKnight = 2,
+    ptBishop = 3,
+    ptRook   = 4,
+    ptQueen  = 5,
+    ptKing   = 6,
+};
+
+enum ChessColor {
+    ccWhite = 0,
+    ccBlack = 1,
+};
+
+struct Piece {
+    PieceType  type  = PieceType::ptNone;
+    ChessColor color = ChessColor::ccWhite;
+};
+
+/**
+ * Board state as given by FEN. Squares are indexed file + 8 * rank from a1 = 0 to h8 = 63.
+ * Moves are applied from standard algebraic notation, only as much legality is checked as needed to find the moving piece.
+ */
+class ChessPosition
+{
+    public:
+        static constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+        Piece      board[64]      = {};
+        ChessColor sideToMove     = ChessColor::ccWhite;
+        uint32_t   castling       = 0;  // CASTLE_* bits
+        int        enPassant      = -1; // square behind a pawn which has just moved two squares
+        uint32_t   halfmoveClock  = 0;
+        uint32_t   fullmoveNumber = 1;
+
+        static constexpr uint32_t CASTLE_WHITE_KING  = 1;
+        static constexpr uint32_t CASTLE_WHITE_QUEEN = 2;
+        static constexpr uint32_t CASTLE_BLACK_KING  = 4;
+        static constexpr uint32_t CASTLE_BLACK_QUEEN = 8;
+
+        // false with error message on malformed FEN, the position is then unchanged
+        bool setFen(const std::string& fen, std::string& error);
+        std::string getFen() const;
+
+        // move such as e4, Nbd7, exd6, O-O-O or e8=Q with optional check and annotation marks, false when no piece can make it
+        bool applySan(const std::string& san, std::string& error);
+
+        // true when any piece of the color attacks the square
+        bool isAttacked(int square, ChessColor byColor) const;
+
+        static inline int square(int file, int rank) { return file + rank * 8; }
+
+    private:
+        bool canReach(int from, int to, bool capture) const;
+        bool leavesKingInCheck(int from, int to) const;
+        void makeMove(int from, int to, PieceType promotion);
+};
@@ -0,0 +1,41 @@
+
+#include <chess/ChessScene.h>
+
+using namespace std;
+
+bool PieceLayout::isPiece(const Model& model) const {
+    bool pieceGeometry = false;
+    for (int type = PieceType::ptPawn; type <= PieceType::ptKing; ++type) {
+        pieceGeometry = pieceGeometry || model.geometryIdent == geometries[type];
+    }
+    return pieceGeometry && (model.materialIdent == materials[ChessColor::ccWhite] || model.materialIdent == materials[ChessColor::ccBlack]);
+}
+
+vector<Model> boardModels(const Scene& scene, const PieceLayout& layout) {
+    auto models = vector<Model>();
+    for (const auto& model : scene.models) {
+        if (!layout.isPiece(model)) {
+            models.push_back(model);
+        }
+    }
+    return models;
+}
+
+vector<Model> positionModels(const ChessPosition& position, const vector<Model>& board, const PieceLayout& layout) {
+    auto models = board;
+    for (int square = 0; square < 64; ++square) {
+        const auto& piece = position.board[square];
+        if (piece.type == PieceType::ptNone) {
+            continue;
+        }
+        auto model          = Model();
+        model.geometryIdent = layout.geometries[piece.type];
+        model.materialIdent = layout.materials[piece.color];
+        model.transform     = Transform(
+            layout.squareCenter(square),
+            piece.type == PieceType::ptPawn ? glm::vec3(0) : layout.rotations[piece.color]
+        );
+        models.push_back(model);
+    }
+    return models;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chess/ChessPosition.h>
+#include <scene/Scene.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+ * Placement of pieces on the board of the scene, defaults match resources/scene.json: ranks go along x from white
+ * at -x to black at +x, files along z. Pieces use geometries and materials of the scene, so a position only
+ * produces models and the scene keeps its primitives, materials and generated SDF.
+ */
+struct PieceLayout {
+    std::string geometries[7] = { "", "pawnGeometry", "knightGeometry", "bishopGeometry", "rookGeometry", "queenGeometry", "kingGeometry" }; // by PieceType
+    std::string materials[2]  = { "whitePiece", "blackPiece" };                     // by ChessColor
+    glm::vec3   rotations[2]  = { glm::vec3(0, -90, 0), glm::vec3(0, 90, 0) };      // by ChessColor, pawns are symmetric and stay unrotated
+
+    glm::vec3 a1       = glm::vec3(-3.5f, 0, -3.5f); // center of square a1
+    glm::vec3 fileStep = glm::vec3(0, 0, 1);         // from a square to the next file
+    glm::vec3 rankStep = glm::vec3(1, 0, 0);         // from a square to the next rank
+
+    inline glm::vec3 squareCenter(int square) const { return a1 + float(square % 8) * fileStep + float(square / 8) * rankStep; }
+
+    bool isPiece(const Model& model) const;
+};
+
+// models of the scene which are not pieces, such as the board itself
+std::vector<Model> boardModels(const Scene& scene, const PieceLayout& layout = PieceLayout());
+
+// board models followed by the pieces of the position, ready for DynamicScene::setModels
+std::vector<Model> positionModels(const ChessPosition& position, const std::vector<Model>& board, const PieceLayout& layout = PieceLayout());
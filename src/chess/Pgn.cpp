@@ -0,0 +1,111 @@
+
+#include <chess/Pgn.h>
+
+#include <fstream>
+
+using namespace std;
+
+static bool isResult(const string& token) {
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+// [Key "Value"] with \" and \\ escapes in the value
+static void readTag(istream& stream, PgnGame& game) {
+    string key, value;
+    char   c;
+    stream >> key;
+    while (stream.get(c) && c != '"' && c != ']') {}
+    if (c == '"') {
+        while (stream.get(c) && c != '"') {
+            if (c == '\\' && !stream.get(c)) break;
+            value += c;
+        }
+        while (stream.get(c) && c != ']') {}
+    }
+    game.tags[key] = value;
+}
+
+bool readPgn(istream& stream, PgnGame& game, string& error) {
+    game = PgnGame();
+    auto position = ChessPosition();
+    position.setFen(ChessPosition::START_FEN, error);
+
+    int  variationDepth = 0;
+    bool movesStarted   = false;
+    char c;
+    while (stream.get(c)) {
+        if (isspace(c)) {
+            continue;
+        }
+        if (c == '[' && variationDepth == 0) {
+            if (movesStarted) {
+                break; // tags of the next game
+            }
+            readTag(stream, game);
+            continue;
+        }
+        if (c == '{') {
+            while (stream.get(c) && c != '}') {}
+            continue;
+        }
+        if (c == ';') {
+            while (stream.get(c) && c != '\n') {}
+            continue;
+        }
+        if (c == '(' || c == ')') {
+            variationDepth += c == '(' ? 1 : -1;
+            continue;
+        }
+
+        string token(1, c);
+        while (stream.get(c) && !isspace(c) && c != '{' && c != '(' && c != ')' && c != ';') {
+            token += c;
+        }
+        if (stream) {
+            stream.unget();
+        }
+
+        if (!movesStarted) {
+            movesStarted = true;
+            if (game.tags.count("FEN") && !position.setFen(game.tags["FEN"], error)) {
+                return false;
+            }
+            game.positions.push_back(position);
+        }
+
+        // 12. and 12... are move numbers, 12.e4 carries the move
+        auto dot = token.find_last_of('.');
+        if (dot != string::npos && (isdigit(token[0]) || token[0] == '.')) {
+            token = token.substr(dot + 1);
+        }
+        if (token.empty() || token[0] == '$' || variationDepth > 0) {
+            continue;
+        }
+        if (isResult(token)) {
+            break;
+        }
+        if (!position.applySan(token, error)) {
+            error = "ply " + to_string(game.moves.size() + 1) + ": " + error;
+            return false;
+        }
+        game.moves.push_back(token);
+        game.positions.push_back(position);
+    }
+
+    if (game.positions.empty()) {
+        if (game.tags.count("FEN") && !position.setFen(game.tags["FEN"], error)) {
+            return false;
+        }
+        game.positions.push_back(position); // game without moves
+    }
+    return true;
+}
+
+bool loadPgn(const string& file, PgnGame& game, string& error) {
+    auto stream = ifstream(file);
+    if (!stream.good()) {
+        error = "cannot open " + file;
+        return false;
+    }
+    return readPgn(stream, game, error);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <chess/ChessPosition.h>
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+struct PgnGame {
+    std::map<std::string, std::string> tags;
+    std::vector<std::string>           moves;     // main line in SAN
+    std::vector<ChessPosition>         positions; // initial position and the position after each move
+};
+
+/**
+ * Reads the first game of a PGN. Tag pairs are kept, comments, variations, numeric annotations and move numbers are skipped.
+ * The game starts from the FEN tag when present. False with error message when a move cannot be played,
+ * the game then holds the moves up to it.
+ */
+bool readPgn(std::istream& stream, PgnGame& game, std::string& error);
+bool loadPgn(const std::string& file, PgnGame& game, std::string& error);
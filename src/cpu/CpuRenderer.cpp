@@ -0,0 +1,1032 @@
+
+#include <cpu/CpuRenderer.h>
+#include <cpu/Sdf.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+using namespace std;
+
+#define TEXTURE_CHESSBOARD 0
+#define INVALID_TEXTURE    100
+
+///////////////////////////////////////////////////////////////////////////////
+// TILE SCHEDULER
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Contiguous range of tiles owned by one worker packed as begin << 32 | end so that it is updated by a single CAS.
+ * The owner takes tiles from the front, thieves split off the back half, so neighbouring tiles mostly stay on one thread.
+ */
+struct alignas(64) TileQueue {
+    atomic<uint64_t> range = 0;
+
+    static uint64_t pack(uint32_t begin, uint32_t end) { return uint64_t(begin) << 32 | end; }
+    static uint32_t begin(uint64_t range)              { return uint32_t(range >> 32); }
+    static uint32_t end(uint64_t range)                { return uint32_t(range); }
+
+    bool pop(uint32_t& tile) {
+        uint64_t current = range.load(memory_order_relaxed);
+        while (begin(current) < end(current)) {
+            if (range.compare_exchange_weak(current, pack(begin(current) + 1, end(current)), memory_order_acquire, memory_order_relaxed)) {
+                tile = begin(current);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // takes back half of the range, at least one tile
+    bool steal(uint32_t& stolenBegin, uint32_t& stolenEnd) {
+        uint64_t current = range.load(memory_order_relaxed);
+        while (begin(current) < end(current)) {
+            uint32_t split = end(current) - (end(current) - begin(current) + 1) / 2;
+            if (range.compare_exchange_weak(current, pack(begin(current), split), memory_order_acquire, memory_order_relaxed)) {
+                stolenBegin = split;
+                stolenEnd   = end(current);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+CpuRenderReport CpuRenderer::render(const RayCamera& camera, Image& target, uint32_t threadCount, PixelCounters* counters) const {
+    auto start = chrono::steady_clock::now();
+    if (counters != nullptr) {
+        *counters = PixelCounters(target.width, target.height);
+    }
+
+    if (threadCount == 0) {
+        threadCount = glm::max(thread::hardware_concurrency(), 1u);
+    }
+
+    uint32_t tilesX = (target.width  + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tilesY = (target.height + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tiles  = tilesX * tilesY;
+
+    // every worker starts with an equal contiguous part of the tiles in scanline order
+    auto queues = make_unique<TileQueue[]>(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        queues[i].range = TileQueue::pack(uint64_t(tiles) * i / threadCount, uint64_t(tiles) * (i + 1) / threadCount);
+    }
+    auto threadReports = vector<CpuThreadReport>(threadCount);
+
+    // pixel center in normalized device coordinates, image rows go top-down
+    auto toFragCoord = [&](uint32_t x, uint32_t y) {
+        return glm::vec2(
+            (float(x) + 0.5f) / float(target.width)  * 2.0f - 1.0f,
+            1.0f - (float(y) + 0.5f) / float(target.height) * 2.0f
+        );
+    };
+
+    // work of the state since the snapshot is added to the pixel, pixels of a tile are counted only by its worker
+    auto countPixel = [&](const RayState& state, const RayState::Counts& since, uint32_t x, uint32_t y, uint64_t primaryRays) {
+        auto     now   = state.counts();
+        uint64_t steps = (now.steps - since.steps) + (now.prepassSteps - since.prepassSteps);
+        counters->at(x, y, PixelCounter::pcSteps)         += uint32_t(steps);
+        counters->at(x, y, PixelCounter::pcSdfCalls)      += uint32_t(steps + now.normalSamples - since.normalSamples);
+        counters->at(x, y, PixelCounter::pcNodeVisits)    += uint32_t(now.nodeVisits - since.nodeVisits);
+        counters->at(x, y, PixelCounter::pcSecondaryRays) += uint32_t(now.rays - since.rays - primaryRays);
+    };
+
+    // state lives on the stack of the worker and is reused by all its rays, nothing is allocated per ray
+    auto renderTile = [&](PacketState& state, uint32_t tile) {
+        uint32_t x0 = (tile % tilesX) * TILE_SIZE;
+        uint32_t y0 = (tile / tilesX) * TILE_SIZE;
+        uint32_t x1 = glm::min(x0 + TILE_SIZE, target.width);
+        uint32_t y1 = glm::min(y0 + TILE_SIZE, target.height);
+
+        // depth prepass of the cells covering the tile
+        constexpr uint32_t TILE_CELLS = TILE_SIZE / PREPASS_CELL_SIZE;
+        float startDistances[TILE_CELLS][TILE_CELLS] = {};
+        if (depthPrepass) {
+            for (uint32_t y = y0; y < y1; y += PREPASS_CELL_SIZE) {
+                for (uint32_t x = x0; x < x1; x += PREPASS_CELL_SIZE) {
+                    glm::vec2 cornerMax = toFragCoord(glm::min(x + PREPASS_CELL_SIZE, x1) - 1, glm::min(y + PREPASS_CELL_SIZE, y1) - 1);
+                    auto      since     = state.counts();
+                    startDistances[(y - y0) / PREPASS_CELL_SIZE][(x - x0) / PREPASS_CELL_SIZE] = coneMarchCell(state, toFragCoord(x, y), cornerMax);
+                    if (counters != nullptr) {
+                        countPixel(state, since, x, y, 0); // cell is accounted to its top-left pixel
+                    }
+                }
+            }
+        }
+        auto startDistance = [&](uint32_t x, uint32_t y) { return startDistances[(y - y0) / PREPASS_CELL_SIZE][(x - x0) / PREPASS_CELL_SIZE]; };
+
+        for (uint32_t y = y0; y < y1; ++y) {
+            if (kernels == nullptr) {
+                for (uint32_t x = x0; x < x1; ++x) {
+                    auto since = state.counts();
+                    target.setPixel(x, y, shadePixel(state, toFragCoord(x, y), startDistance(x, y)));
+                    if (counters != nullptr) {
+                        countPixel(state, since, x, y, 1);
+                    }
+                }
+                continue;
+            }
+
+            // packets of horizontally neighbouring pixels
+            for (uint32_t x = x0; x < x1; x += PACKET_SIZE) {
+                glm::vec2 fragCoords[PACKET_SIZE];
+                glm::vec3 colors[PACKET_SIZE];
+                uint32_t  mask = 0;
+                for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+                    state.laneCounters[lane] = nullptr;
+                    if (x + lane < x1) {
+                        fragCoords[lane] = toFragCoord(x + lane, y);
+                        mask |= 1u << lane;
+                        if (counters != nullptr) {
+                            state.laneCounters[lane] = &counters->at(x + lane, y, PixelCounter::pcSteps);
+                        }
+                    }
+                }
+                shadePacket(state, fragCoords, startDistance(x, y), mask, colors);
+                for (uint32_t lane = 0; lane < PACKET_SIZE && x + lane < x1; ++lane) {
+                    target.setPixel(x + lane, y, colors[lane]);
+                }
+            }
+        }
+    };
+
+    auto worker = [&](uint32_t index) {
+        auto  state  = PacketState(camera);
+        auto  busy   = chrono::steady_clock::duration::zero();
+        auto& queue  = queues[index];
+        auto& report = threadReports[index];
+
+        for (;;) {
+            uint32_t tile = 0;
+            while (queue.pop(tile)) {
+                auto tileStart = chrono::steady_clock::now();
+                renderTile(state, tile);
+                busy += chrono::steady_clock::now() - tileStart;
+                ++report.tiles;
+            }
+
+            // victims are visited starting by the neighbour so that thieves spread over the queues
+            bool stolen = false;
+            for (uint32_t i = 1; i < threadCount && !stolen; ++i) {
+                uint32_t begin = 0;
+                uint32_t end   = 0;
+                if (queues[(index + i) % threadCount].steal(begin, end)) {
+                    queue.range   = TileQueue::pack(begin, end);
+                    report.stolen += end - begin;
+                    stolen         = true;
+                }
+            }
+            if (!stolen) {
+                break;
+            }
+        }
+        report.rays         = state.rays;
+        report.primarySteps = state.primarySteps;
+        report.prepassSteps = state.prepassSteps;
+        report.nodeVisits   = state.nodeVisits;
+        report.busy         = chrono::duration_cast<chrono::microseconds>(busy);
+    };
+
+    vector<thread> workers;
+    workers.reserve(threadCount - 1);
+    for (uint32_t i = 1; i < threadCount; ++i) {
+        workers.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    auto report     = CpuRenderReport();
+    report.duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    report.threads  = threadCount;
+    report.tiles    = tiles;
+    report.pixels   = uint64_t(target.width) * target.height;
+    for (const auto& threadReport : threadReports) {
+        report.rays         += threadReport.rays;
+        report.primarySteps += threadReport.primarySteps;
+        report.prepassSteps += threadReport.prepassSteps;
+        report.nodeVisits   += threadReport.nodeVisits;
+    }
+    report.threadReports = move(threadReports);
+    return report;
+}
+
+double CpuRenderReport::averageUtilization() const {
+    double sum = 0;
+    for (uint32_t i = 0; i < threadReports.size(); ++i) {
+        sum += utilization(i);
+    }
+    return threadReports.empty() ? 0.0 : sum / threadReports.size();
+}
+
+ostream& operator<<(ostream& stream, const CpuRenderReport& report) {
+    double pixels = double(glm::max(report.pixels, uint64_t(1)));
+    stream << "Steps per pixel " << report.stepsPerPixel() << " (" << report.prepassSteps / pixels << " in depth prepass)\n";
+    stream << "BVH node visits per ray " << report.nodeVisitsPerRay() << "\n";
+    stream << "Thread utilization " << report.averageUtilization() * 100.0 << " % on average";
+    for (uint32_t i = 0; i < report.threadReports.size(); ++i) {
+        const auto& thread = report.threadReports[i];
+        stream << "\n  thread " << i << ": " << report.utilization(i) * 100.0 << " %, "
+               << thread.tiles << " tiles (" << thread.stolen << " stolen), " << thread.rays << " rays";
+    }
+    return stream;
+}
+
+glm::vec3 CpuRenderer::renderPixel(const RayCamera& camera, glm::vec2 fragCoord) const {
+    auto state = RayState(camera);
+    return shadePixel(state, fragCoord);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ENTRY POINT - main() of fragment.fs
+///////////////////////////////////////////////////////////////////////////////
+
+glm::vec3 CpuRenderer::shadePixel(RayState& state, glm::vec2 fragCoord, float startDistance) const {
+    glm::vec3 rayDirection = state.camera.rayDirection(fragCoord);
+    glm::vec3 color        = backgroundColor;
+    int       modelId      = -1;
+    uint64_t  steps        = state.steps;
+    float     dist         = rayMarch(state, state.camera.position, rayDirection, modelId, startDistance);
+    state.primarySteps    += state.steps - steps;
+
+    // if hit then shade the point
+    if (dist < MAX_DISTANCE) {
+        glm::vec3 position = state.camera.position + rayDirection * dist;
+        color = getColor(state, position, modelId, true);
+    }
+
+    return color;
+}
+
+// same computation as shadePixel, but with rays of all pipeline stages marched in packets
+void CpuRenderer::shadePacket(PacketState& state, const glm::vec2* fragCoords, float startDistance, uint32_t mask, glm::vec3* colors) const {
+    const auto& camera = state.camera;
+
+    glm::vec3 rayDirections[PACKET_SIZE];
+    glm::vec3 rayOrigins[PACKET_SIZE];
+    float     distances[PACKET_SIZE];
+    int       modelIds[PACKET_SIZE];
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        rayDirections[lane] = camera.rayDirection(fragCoords[lane]);
+        rayOrigins[lane]    = camera.position;
+        modelIds[lane]      = -1;
+        colors[lane]        = backgroundColor;
+    }
+    uint64_t steps = state.steps;
+    rayMarchPacket(state, rayOrigins, rayDirections, mask, distances, modelIds, startDistance);
+    state.primarySteps += state.steps - steps;
+
+    uint32_t hitMask = 0;
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if ((mask >> lane & 1) && distances[lane] < MAX_DISTANCE) {
+            hitMask |= 1u << lane;
+        }
+    }
+    if (hitMask == 0) {
+        return;
+    }
+
+    // surface properties of hit points - getColor
+    glm::vec3 points[PACKET_SIZE];
+    glm::vec3 toLightVectors[PACKET_SIZE];
+    glm::vec3 viewVectors[PACKET_SIZE];
+    glm::vec3 normalVectors[PACKET_SIZE];
+    glm::vec3 lightReflectedVectors[PACKET_SIZE];
+    glm::vec3 viewReflectedVectors[PACKET_SIZE];
+    glm::vec3 secondaryOrigins[PACKET_SIZE]; // shadow and reflection rays start at the same point
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (hitMask >> lane & 1) {
+            points[lane]                = camera.position + rayDirections[lane] * distances[lane];
+            toLightVectors[lane]        = glm::normalize(lightPosition - points[lane]);
+            viewVectors[lane]           = glm::normalize(camera.position - points[lane]);
+        }
+    }
+    getNormalsPacket(state, points, modelIds, hitMask, normalVectors);
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (hitMask >> lane & 1) {
+            lightReflectedVectors[lane] = glm::normalize(glm::reflect(-toLightVectors[lane], normalVectors[lane]));
+            viewReflectedVectors[lane]  = glm::normalize(glm::reflect(-viewVectors[lane], normalVectors[lane]));
+            secondaryOrigins[lane]      = getShadowRayOrigin(state, points[lane], normalVectors[lane]);
+        }
+    }
+
+    // shadow rays - getLight
+    float lightDistances[PACKET_SIZE];
+    float visibilities[PACKET_SIZE];
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (hitMask >> lane & 1) {
+            lightDistances[lane] = glm::length(lightPosition - points[lane]);
+        }
+    }
+    traceShadowPacket(state, secondaryOrigins, toLightVectors, lightDistances, modelIds, hitMask, visibilities);
+
+    uint32_t reflectionMask = 0;
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (hitMask >> lane & 1) {
+            colors[lane] = shadeLight(points[lane], toLightVectors[lane], viewVectors[lane], normalVectors[lane], lightReflectedVectors[lane], modelIds[lane], visibilities[lane]);
+            if (getMaterial(points[lane], modelIds[lane]).shininess > 100) {
+                reflectionMask |= 1u << lane;
+            }
+        }
+    }
+    if (reflectionMask == 0) {
+        return;
+    }
+
+    // reflection rays
+    float reflectionDistances[PACKET_SIZE];
+    int   reflectionModels[PACKET_SIZE];
+    std::copy_n(modelIds, PACKET_SIZE, reflectionModels);
+    rayMarchPacket(state, secondaryOrigins, viewReflectedVectors, reflectionMask, reflectionDistances, reflectionModels);
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (reflectionMask >> lane & 1) {
+            state.countLane(lane, PixelCounter::pcSecondaryRays, 1);
+        }
+    }
+
+    // light of reflected models needs another shadow ray
+    uint32_t reflectedHitMask = 0;
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if ((reflectionMask >> lane & 1) && reflectionModels[lane] != modelIds[lane]) {
+            reflectedHitMask |= 1u << lane;
+        }
+    }
+    getNormalsPacket(state, secondaryOrigins, reflectionModels, reflectedHitMask, normalVectors);
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (reflectedHitMask >> lane & 1) {
+            glm::vec3 origin            = secondaryOrigins[lane];
+            toLightVectors[lane]        = glm::normalize(lightPosition - origin);
+            viewVectors[lane]           = glm::normalize(camera.position - origin);
+            lightReflectedVectors[lane] = glm::normalize(glm::reflect(-toLightVectors[lane], normalVectors[lane]));
+            secondaryOrigins[lane]      = getShadowRayOrigin(state, points[lane], normalVectors[lane]);
+        }
+    }
+    if (reflectedHitMask != 0) {
+        traceShadowPacket(state, secondaryOrigins, toLightVectors, lightDistances, reflectionModels, reflectedHitMask, visibilities);
+    }
+
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (reflectionMask >> lane & 1) {
+            glm::vec3 reflectedColor = backgroundColor;
+            if (reflectedHitMask >> lane & 1) {
+                reflectedColor = shadeLight(points[lane], toLightVectors[lane], viewVectors[lane], normalVectors[lane], lightReflectedVectors[lane], reflectionModels[lane], visibilities[lane]);
+            }
+            colors[lane] = glm::mix(colors[lane], reflectedColor, getMaterial(points[lane], modelIds[lane]).shininess / 3000.0f);
+        }
+    }
+}
+
+// models are dispatched to their geometry once so that marching does not look it up
+void CpuRenderer::prepareGeometrySdfs() {
+    for (const auto& geometry : foldGeometries(scene)) {
+        geometrySdfIndices[geometry.firstPrimitive] = int32_t(geometrySdfs.size());
+        geometrySdfs.emplace_back(geometry);
+    }
+    assignGeometrySdfs();
+}
+
+void CpuRenderer::assignGeometrySdfs() {
+    modelGeometrySdfs.clear();
+    for (const auto& model : scene.models) {
+        auto index = geometrySdfIndices.find(model.geometryId);
+        modelGeometrySdfs.push_back(index != geometrySdfIndices.end() ? index->second : -1);
+    }
+}
+
+void CpuRenderer::updateModels(const ShaderSceneData& sceneData) {
+    scene.models    = sceneData.models;
+    scene.bvh       = sceneData.bvh;
+    scene.bvhReport = sceneData.bvhReport;
+    assignGeometrySdfs();
+}
+
+float CpuRenderer::sdModel(glm::vec3 position, int modelId) const {
+    int32_t geometry = modelGeometrySdfs[modelId];
+    if (specializedSdf && geometry >= 0) {
+        return ::sdModel(position, scene.models[modelId], geometrySdfs[geometry], volumes);
+    }
+    return ::sdModel(position, scene.models[modelId], scene.primitives.data(), volumes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BVH TRAVERSAL
+///////////////////////////////////////////////////////////////////////////////
+
+// box is enlarged by boxMargin on each side
+bool CpuRenderer::intersectBB(RayState& state, int nodeIndex, glm::vec3 rayOrigin, glm::vec3 direction, float boxMargin, float& rayBegin, float& rayEnd) const {
+    ++state.nodeVisits;
+    const auto& node          = scene.bvh[nodeIndex];
+    if (glm::any(glm::greaterThan(node.bbMin, node.bbMax))) {
+        return false; // inverted box of a removed model, see fragment.fs
+    }
+    glm::vec3   inverseRayDir = 1.0f / direction;
+
+    glm::vec3 tminv0 = (node.bbMin - boxMargin - rayOrigin) * inverseRayDir;
+    glm::vec3 tmaxv0 = (node.bbMax + boxMargin - rayOrigin) * inverseRayDir;
+
+    glm::vec3 tminv = glm::min(tminv0, tmaxv0);
+    glm::vec3 tmaxv = glm::max(tminv0, tmaxv0);
+
+    float tmin = glm::max(tminv.x, glm::max(tminv.y, tminv.z));
+    float tmax = glm::min(tmaxv.x, glm::min(tmaxv.y, tmaxv.z));
+
+    if (tmin < tmax && tmax > 0) {
+        rayEnd   = tmax;
+        rayBegin = tmin;
+        return true;
+    }
+    return false;
+}
+
+bool CpuRenderer::insideBB(int nodeIndex, glm::vec3 point) const {
+    const auto& node = scene.bvh[nodeIndex];
+    return glm::all(glm::greaterThanEqual(point, node.bbMin)) && glm::all(glm::lessThanEqual(point, node.bbMax));
+}
+
+void CpuRenderer::beginTraversal(RayState& state, TraversalStack& stack, glm::vec3 rayOrigin, glm::vec3 rayDirection, float boxMargin) const {
+    stack.size      = 0;
+    stack.scan      = 0;
+    stack.scanEnd   = 0;
+    stack.node      = -1;
+    stack.boxMargin = boxMargin;
+    if (intersectBB(state, 0, rayOrigin, rayDirection, boxMargin, stack.range.x, stack.range.y)) {
+        stack.node = 0;
+    }
+}
+
+/**
+ * Next leaf hit by the ray in order of rayBegin with rayBegin in (minRayBegin, maxDistance), see fragment.fs.
+ * The nearer child is visited first and the farther one is pushed, nodes entered at or beyond maxDistance are dropped.
+ * A subtree deeper than the stack is scanned out of order as in fragment.fs.
+ */
+bool CpuRenderer::nextLeaf(RayState& state, TraversalStack& stack, glm::vec3 rayOrigin, glm::vec3 rayDirection, float minRayBegin, float maxDistance,
+                           ModelIntersection& leaf) const {
+    maxDistance = glm::min(maxDistance, MAX_DISTANCE);
+    for (;;) {
+        if (stack.scan < stack.scanEnd) {
+            int       node  = stack.scan;
+            glm::vec2 range = glm::vec2(0);
+            if (!intersectBB(state, node, rayOrigin, rayDirection, stack.boxMargin, range.x, range.y) || range.x >= maxDistance) {
+                stack.scan = scene.bvh[node].escape; // whole subtree is missed
+                continue;
+            }
+            stack.scan = node + 1; // children follow their parent
+            if (scene.bvh[node].isLeaf() && range.x > minRayBegin) {
+                leaf = { scene.bvh[node].model, range.x, range.y };
+                return true;
+            }
+            continue;
+        }
+        if (stack.node < 0) {
+            if (stack.size == 0) {
+                return false;
+            }
+            --stack.size;
+            stack.node  = stack.nodes[stack.size];
+            stack.range = stack.ranges[stack.size];
+        }
+        int node = stack.node;
+        stack.node = -1;
+        if (stack.range.x >= maxDistance) {
+            continue;
+        }
+
+        if (scene.bvh[node].isLeaf()) {
+            if (stack.range.x > minRayBegin) {
+                leaf = { scene.bvh[node].model, stack.range.x, stack.range.y };
+                return true;
+            }
+            continue;
+        }
+        if (scene.bvh[node].escape == node + 1) { // leaf of removed model
+            continue;
+        }
+
+        int       left       = node + 1;
+        int       right      = scene.bvh[left].escape;
+        glm::vec2 leftRange  = glm::vec2(0);
+        glm::vec2 rightRange = glm::vec2(0);
+        bool      leftHit    = intersectBB(state, left,  rayOrigin, rayDirection, stack.boxMargin, leftRange.x,  leftRange.y);
+        bool      rightHit   = intersectBB(state, right, rayOrigin, rayDirection, stack.boxMargin, rightRange.x, rightRange.y);
+        if (leftHit && rightHit && stack.size == TraversalStack::SIZE) { // deeper than the build allows, same in fragment.fs
+            stack.scan    = left;
+            stack.scanEnd = scene.bvh[node].escape;
+        } else if (leftHit && rightHit) {
+            bool leftFirst = leftRange.x <= rightRange.x;
+            stack.nodes[stack.size]  = leftFirst ? right : left;
+            stack.ranges[stack.size] = leftFirst ? rightRange : leftRange;
+            ++stack.size;
+            stack.node  = leftFirst ? left : right;
+            stack.range = leftFirst ? leftRange : rightRange;
+        } else if (leftHit || rightHit) {
+            stack.node  = leftHit ? left : right;
+            stack.range = leftHit ? leftRange : rightRange;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RAY MARCHING
+///////////////////////////////////////////////////////////////////////////////
+
+float CpuRenderer::getHitDistance(const RayState& state, glm::vec3 point) const {
+    float d = glm::length(point - state.camera.position);
+    return glm::clamp(d * d * HIT_DISTANCE_FACTOR, HIT_DISTANCE_MIN, HIT_DISTANCE_MAX);
+}
+
+float CpuRenderer::rayMarchModel(RayState& state, glm::vec3 originPoint, glm::vec3 direction, int modelId, float maxDistance) const {
+    float distanceMarched = 0;
+    for (int step = 0; step < MAX_STEPS; ++step) {
+        ++state.steps;
+        glm::vec3 position = originPoint + distanceMarched * direction;
+        float dist = sdModel(position, modelId);
+        distanceMarched += dist;
+        if (dist <= getHitDistance(state, position) || distanceMarched >= maxDistance) {
+            break;
+        }
+    }
+    return glm::min(distanceMarched, maxDistance);
+}
+
+// marching of each model starts at startDistance at the earliest
+float CpuRenderer::rayMarch(RayState& state, glm::vec3 originPoint, glm::vec3 direction, int& modelId, float startDistance) const {
+    ++state.rays;
+    if (startDistance >= MAX_DISTANCE) { // cone of the prepass missed everything
+        return MAX_DISTANCE;
+    }
+
+    // models are marched front to back only up to the closest hit, boxes entered behind it are not visited
+    float closestHit   = MAX_DISTANCE;
+    auto  intersection = ModelIntersection();
+    beginTraversal(state, state.stack, originPoint, direction);
+    while (nextLeaf(state, state.stack, originPoint, direction, 0, closestHit, intersection)) {
+        float rayBegin = glm::max(intersection.rayBegin, startDistance);
+        float rayEnd   = glm::min(intersection.rayEnd, closestHit);
+        if (rayBegin >= rayEnd) {
+            continue;
+        }
+        glm::vec3 actPosition          = originPoint + direction * rayBegin;
+        float     intersectionDistance = rayEnd - rayBegin;
+        float     dist                 = rayMarchModel(state, actPosition, direction, intersection.model, intersectionDistance);
+
+        if (dist < intersectionDistance) { // hit
+            modelId    = intersection.model;
+            closestHit = dist + rayBegin;
+        }
+    }
+    return closestHit;
+}
+
+/**
+ * Each lane traverses the BVH on its own in the same order as rayMarch does, up to its own closest hit.
+ * In every round lanes waiting for the same model are grouped and marched by one kernel call.
+ */
+void CpuRenderer::rayMarchPacket(PacketState& state, const glm::vec3* origins, const glm::vec3* directions, uint32_t mask, float* distances, int* modelIds,
+                                 float startDistance) const {
+    ModelIntersection next[PACKET_SIZE];
+    float             rayBegins[PACKET_SIZE];
+    float             rayEnds[PACKET_SIZE];
+
+    uint32_t pending = 0;
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        distances[lane] = MAX_DISTANCE;
+        if (mask >> lane & 1) {
+            ++state.rays;
+            pending |= 1u << lane;
+        }
+    }
+    if (startDistance >= MAX_DISTANCE) { // cone of the prepass missed everything
+        return;
+    }
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (pending >> lane & 1) {
+            uint64_t nodeVisits = state.nodeVisits;
+            beginTraversal(state, state.laneStacks[lane], origins[lane], directions[lane]);
+            state.countLane(lane, PixelCounter::pcNodeVisits, uint32_t(state.nodeVisits - nodeVisits));
+        }
+    }
+
+    uint32_t needsNext = pending;
+    while (pending != 0) {
+        for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+            if (needsNext >> lane & 1) {
+                // models ending before startDistance are skipped
+                uint64_t nodeVisits = state.nodeVisits;
+                bool     found      = false;
+                do {
+                    found = nextLeaf(state, state.laneStacks[lane], origins[lane], directions[lane], 0, distances[lane], next[lane]);
+                } while (found && glm::max(next[lane].rayBegin, startDistance) >= glm::min(next[lane].rayEnd, distances[lane]));
+                state.countLane(lane, PixelCounter::pcNodeVisits, uint32_t(state.nodeVisits - nodeVisits));
+
+                if (!found) {
+                    pending &= ~(1u << lane);
+                } else {
+                    rayBegins[lane] = glm::max(next[lane].rayBegin, startDistance);
+                    rayEnds[lane]   = glm::min(next[lane].rayEnd, distances[lane]);
+                }
+            }
+        }
+        needsNext = 0;
+        if (pending == 0) {
+            break;
+        }
+
+        // group lanes waiting for the same model as the first pending lane
+        uint32_t firstLane = 0;
+        while ((pending >> firstLane & 1) == 0) {
+            ++firstLane;
+        }
+        int  model  = next[firstLane].model;
+        auto packet = RayPacket();
+        packet.cameraX = state.camera.position.x;
+        packet.cameraY = state.camera.position.y;
+        packet.cameraZ = state.camera.position.z;
+        for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+            if ((pending >> lane & 1) && next[lane].model == model) {
+                glm::vec3 origin          = origins[lane] + directions[lane] * rayBegins[lane];
+                packet.originX[lane]      = origin.x;
+                packet.originY[lane]      = origin.y;
+                packet.originZ[lane]      = origin.z;
+                packet.directionX[lane]   = directions[lane].x;
+                packet.directionY[lane]   = directions[lane].y;
+                packet.directionZ[lane]   = directions[lane].z;
+                packet.maxDistance[lane]  = rayEnds[lane] - rayBegins[lane];
+                packet.mask              |= 1u << lane;
+            }
+        }
+
+        alignas(32) float marched[PACKET_SIZE];
+        alignas(32) float steps[PACKET_SIZE];
+        kernels->rayMarchModel(packet, scene.models[model], scene.primitives.data(), volumes != nullptr ? &packetVolumes : nullptr, marched, steps);
+
+        for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+            if (packet.mask >> lane & 1) {
+                state.steps += uint64_t(steps[lane]);
+                state.countLane(lane, PixelCounter::pcSteps,    uint32_t(steps[lane]));
+                state.countLane(lane, PixelCounter::pcSdfCalls, uint32_t(steps[lane]));
+                if (marched[lane] < packet.maxDistance[lane]) { // hit
+                    distances[lane] = marched[lane] + rayBegins[lane];
+                    modelIds[lane]  = model;
+                }
+                needsNext |= 1u << lane;
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SHADOW RAYS
+///////////////////////////////////////////////////////////////////////////////
+
+// light visibility along the model segment, 0 on hit, penumbra of the closest approach when penumbraFactor > 0
+float CpuRenderer::shadowMarchModel(RayState& state, glm::vec3 originPoint, glm::vec3 direction, int modelId, float rayBegin, float maxDistance) const {
+    float visibility      = 1;
+    float distanceMarched = 0;
+    for (int step = 0; step < MAX_STEPS; ++step) {
+        ++state.steps;
+        glm::vec3 position = originPoint + distanceMarched * direction;
+        float     dist     = sdModel(position, modelId);
+        if (penumbraFactor > 0) {
+            visibility = glm::min(visibility, penumbraFactor * dist / (rayBegin + distanceMarched));
+        }
+        distanceMarched += dist;
+        if (distanceMarched >= maxDistance) {
+            return glm::clamp(visibility, 0.0f, 1.0f);
+        }
+        if (dist <= getHitDistance(state, position)) {
+            return 0;
+        }
+    }
+    return 0; // out of steps counts as a hit as in rayMarchModel
+}
+
+// penumbra darkens rays passing a model closer than t / penumbraFactor, boxes are grown by the largest such distance
+float CpuRenderer::penumbraMargin(float maxDistance) const {
+    return penumbraFactor > 0 ? maxDistance / penumbraFactor : 0.0f;
+}
+
+/**
+ * Any-hit counterpart of rayMarch, see fragment.fs.
+ * Models are marched in BVH order without collecting and sorting intersections, the first hit ends the traversal.
+ * Models whose box holds the ray origin are skipped, with penumbra their grown boxes are marched from the origin.
+ */
+float CpuRenderer::traceShadow(RayState& state, glm::vec3 originPoint, glm::vec3 direction, float maxDistance, int ignoredModel) const {
+    ++state.rays;
+    maxDistance = glm::min(maxDistance, MAX_DISTANCE);
+
+    float visibility = 1;
+    float boxMargin  = penumbraMargin(maxDistance);
+    float rBegin     = 0;
+    float rEnd       = 0;
+    int   nodeCount  = scene.bvh.size();
+    int   nodeIndex  = 0;
+    while (nodeIndex < nodeCount) {
+        const auto& node = scene.bvh[nodeIndex];
+        if (!intersectBB(state, nodeIndex, originPoint, direction, boxMargin, rBegin, rEnd) || rBegin >= maxDistance) {
+            nodeIndex = node.escape;
+            continue;
+        }
+        if (!node.isLeaf()) {
+            ++nodeIndex;
+            continue;
+        }
+        if (node.model != ignoredModel && !insideBB(nodeIndex, originPoint)) {
+            rBegin        = glm::max(rBegin, HIT_DISTANCE_MIN); // penumbra divides by the distance from the origin
+            float segment = glm::min(rEnd, maxDistance) - rBegin;
+            visibility = glm::min(visibility, shadowMarchModel(state, originPoint + direction * rBegin, direction, node.model, rBegin, segment));
+            if (visibility <= 0) {
+                return 0;
+            }
+        }
+        nodeIndex = node.escape;
+    }
+    return visibility;
+}
+
+/**
+ * Shadow rays of the packet traverse the BVH together, a node is entered when any lit lane intersects it.
+ * Lanes entering the same leaf are marched by one kernel call, lanes which hit something leave the traversal.
+ */
+void CpuRenderer::traceShadowPacket(PacketState& state, const glm::vec3* origins, const glm::vec3* directions, const float* maxDistances,
+                                    const int* ignoredModels, uint32_t mask, float* visibilities) const {
+    float maxDistance[PACKET_SIZE];
+    float boxMargins[PACKET_SIZE];
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        visibilities[lane] = 1;
+        if (mask >> lane & 1) {
+            ++state.rays;
+            state.countLane(lane, PixelCounter::pcSecondaryRays, 1);
+            maxDistance[lane] = glm::min(maxDistances[lane], MAX_DISTANCE);
+            boxMargins[lane]  = penumbraMargin(maxDistance[lane]);
+        }
+    }
+
+    uint32_t lit       = mask;
+    int      nodeCount = scene.bvh.size();
+    int      nodeIndex = 0;
+    while (nodeIndex < nodeCount && lit != 0) {
+        const auto& node = scene.bvh[nodeIndex];
+        float    rBegins[PACKET_SIZE];
+        float    rEnds[PACKET_SIZE];
+        uint32_t entered = 0;
+        for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+            if ((lit >> lane & 1) == 0) {
+                continue;
+            }
+            state.countLane(lane, PixelCounter::pcNodeVisits, 1);
+            if (intersectBB(state, nodeIndex, origins[lane], directions[lane], boxMargins[lane], rBegins[lane], rEnds[lane]) && rBegins[lane] < maxDistance[lane]) {
+                entered |= 1u << lane;
+            }
+        }
+        if (entered == 0) {
+            nodeIndex = node.escape;
+            continue;
+        }
+        if (!node.isLeaf()) {
+            ++nodeIndex;
+            continue;
+        }
+
+        auto packet = RayPacket();
+        packet.cameraX = state.camera.position.x;
+        packet.cameraY = state.camera.position.y;
+        packet.cameraZ = state.camera.position.z;
+        for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+            if ((entered >> lane & 1) && node.model != ignoredModels[lane] && !insideBB(nodeIndex, origins[lane])) {
+                rBegins[lane]             = glm::max(rBegins[lane], HIT_DISTANCE_MIN);
+                glm::vec3 origin          = origins[lane] + directions[lane] * rBegins[lane];
+                packet.originX[lane]      = origin.x;
+                packet.originY[lane]      = origin.y;
+                packet.originZ[lane]      = origin.z;
+                packet.directionX[lane]   = directions[lane].x;
+                packet.directionY[lane]   = directions[lane].y;
+                packet.directionZ[lane]   = directions[lane].z;
+                packet.maxDistance[lane]  = glm::min(rEnds[lane], maxDistance[lane]) - rBegins[lane];
+                packet.rayBegin[lane]     = rBegins[lane];
+                packet.mask              |= 1u << lane;
+            }
+        }
+        if (packet.mask != 0) {
+            alignas(32) float modelVisibilities[PACKET_SIZE];
+            alignas(32) float steps[PACKET_SIZE];
+            kernels->shadowMarchModel(packet, scene.models[node.model], scene.primitives.data(), volumes != nullptr ? &packetVolumes : nullptr,
+                                      penumbraFactor, modelVisibilities, steps);
+            for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+                if (packet.mask >> lane & 1) {
+                    state.steps        += uint64_t(steps[lane]);
+                    visibilities[lane]  = glm::min(visibilities[lane], modelVisibilities[lane]);
+                    state.countLane(lane, PixelCounter::pcSteps,    uint32_t(steps[lane]));
+                    state.countLane(lane, PixelCounter::pcSdfCalls, uint32_t(steps[lane]));
+                    if (visibilities[lane] <= 0) {
+                        lit &= ~(1u << lane);
+                    }
+                }
+            }
+        }
+        nodeIndex = node.escape;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DEPTH PREPASS
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Distance along the cone axis up to which no ray of the cone gets closer to the model than its hit distance.
+ * Ray of the cone at distance t is at most t * spread from the axis, so a step keeps the cone inside the empty sphere.
+ */
+float CpuRenderer::coneMarchModel(RayState& state, glm::vec3 direction, float spread, const ModelIntersection& intersection) const {
+    float t = glm::max(intersection.rayBegin, 0.0f);
+    for (int step = 0; step < MAX_STEPS; ++step) {
+        ++state.prepassSteps;
+        float dist        = sdModel(state.camera.position + direction * t, intersection.model);
+        float reach       = t + glm::max(dist, 0.0f);
+        float hitDistance = glm::clamp(reach * reach * HIT_DISTANCE_FACTOR, HIT_DISTANCE_MIN, HIT_DISTANCE_MAX);
+        float advance     = (dist - hitDistance - t * spread) / (1 + spread);
+        if (advance <= t * spread) { // cone touches the surface within pixel footprint
+            return t + glm::max(advance, 0.0f);
+        }
+        t += advance;
+        if (t >= intersection.rayEnd) {
+            return MAX_DISTANCE;
+        }
+    }
+    return t;
+}
+
+// safe start distance of all primary rays of the cell, models are cone marched front to back until the nearest stop
+float CpuRenderer::coneMarchCell(RayState& state, glm::vec2 cornerMin, glm::vec2 cornerMax) const {
+    glm::vec3 direction = state.camera.rayDirection((cornerMin + cornerMax) * 0.5f);
+    float     spread    = glm::max(
+        glm::max(glm::length(state.camera.rayDirection(cornerMin) - direction), glm::length(state.camera.rayDirection(cornerMax) - direction)),
+        glm::max(glm::length(state.camera.rayDirection(glm::vec2(cornerMin.x, cornerMax.y)) - direction),
+                 glm::length(state.camera.rayDirection(glm::vec2(cornerMax.x, cornerMin.y)) - direction))
+    );
+
+    // boxes are enlarged by the widest cone radius so that models touched only by the cone are not missed
+    float safeDistance = MAX_DISTANCE;
+    auto  intersection = ModelIntersection();
+    beginTraversal(state, state.stack, state.camera.position, direction, spread * MAX_DISTANCE);
+    while (nextLeaf(state, state.stack, state.camera.position, direction, -MAX_DISTANCE, safeDistance, intersection)) {
+        safeDistance = glm::min(safeDistance, coneMarchModel(state, direction, spread, intersection));
+    }
+    return safeDistance;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MATERIALS AND LIGTHING
+///////////////////////////////////////////////////////////////////////////////
+
+glm::vec3 CpuRenderer::getNormal(RayState& state, glm::vec3 point, int modelId) const {
+    state.normalSamples += 4;
+    float d = sdModel(point, modelId);
+    float e = getHitDistance(state, point);
+    glm::vec3 n = d - glm::vec3(
+        sdModel(point - glm::vec3(e, 0, 0), modelId),
+        sdModel(point - glm::vec3(0, e, 0), modelId),
+        sdModel(point - glm::vec3(0, 0, e), modelId)
+    );
+    return glm::normalize(n);
+}
+
+// four samples of getNormal per lane, two lanes hitting the same model share one kernel call
+void CpuRenderer::getNormalsPacket(PacketState& state, const glm::vec3* points, const int* modelIds, uint32_t mask, glm::vec3* normals) const {
+    constexpr uint32_t SAMPLES = 4;
+
+    for (uint32_t lane = 0; lane < PACKET_SIZE; ++lane) {
+        if (mask >> lane & 1) {
+            state.normalSamples += SAMPLES;
+            state.countLane(lane, PixelCounter::pcSdfCalls, SAMPLES);
+        }
+    }
+
+    uint32_t remaining = mask;
+    while (remaining != 0) {
+        uint32_t lanes[PACKET_SIZE / SAMPLES];
+        uint32_t laneCount = 0;
+        int      model     = -1;
+        for (uint32_t lane = 0; lane < PACKET_SIZE && laneCount < PACKET_SIZE / SAMPLES; ++lane) {
+            if ((remaining >> lane & 1) && (model < 0 || modelIds[lane] == model)) {
+                model = modelIds[lane];
+                lanes[laneCount++] = lane;
+                remaining &= ~(1u << lane);
+            }
+        }
+
+        alignas(32) float x[PACKET_SIZE] = {};
+        alignas(32) float y[PACKET_SIZE] = {};
+        alignas(32) float z[PACKET_SIZE] = {};
+        alignas(32) float d[PACKET_SIZE];
+        for (uint32_t i = 0; i < laneCount; ++i) {
+            glm::vec3 point = points[lanes[i]];
+            float     e     = getHitDistance(state, point);
+            glm::vec3 samples[SAMPLES] = { point, point - glm::vec3(e, 0, 0), point - glm::vec3(0, e, 0), point - glm::vec3(0, 0, e) };
+            for (uint32_t sample = 0; sample < SAMPLES; ++sample) {
+                x[i * SAMPLES + sample] = samples[sample].x;
+                y[i * SAMPLES + sample] = samples[sample].y;
+                z[i * SAMPLES + sample] = samples[sample].z;
+            }
+        }
+        kernels->sdModel(x, y, z, scene.models[model], scene.primitives.data(), volumes != nullptr ? &packetVolumes : nullptr, d);
+
+        for (uint32_t i = 0; i < laneCount; ++i) {
+            const float* ds = d + i * SAMPLES;
+            normals[lanes[i]] = glm::normalize(ds[0] - glm::vec3(ds[1], ds[2], ds[3]));
+        }
+    }
+}
+
+static ShaderMaterial sampleProcTexture(uint32_t textureId, glm::vec3 point) {
+    auto mat = ShaderMaterial();
+    if (textureId == TEXTURE_CHESSBOARD) {
+        glm::vec2 dim = glm::mod(glm::floor(glm::vec2(point.x, point.z)), 2.0f);
+        if (dim.x == dim.y && glm::abs(point.x) <= 4.0f && glm::abs(point.z) <= 4.0f) {
+            mat.color         = glm::vec4(0.1, 0.1, 0.1, 1);
+            mat.specularColor = glm::vec4(1.1, 1.0, 0.99, 1);
+            mat.shininess     = 300;
+        } else {
+            mat.color         = glm::vec4(1.0, 0.95, 0.85, 1);
+            mat.specularColor = glm::vec4(1.1, 1.0, 0.99, 1);
+            mat.shininess     = 700;
+        }
+    }
+    return mat;
+}
+
+ShaderMaterial CpuRenderer::getMaterial(glm::vec3 position, int modelId) const {
+    const auto& material = scene.materials[scene.models[modelId].materialId];
+    if (material.textureId != INVALID_TEXTURE) {
+        return sampleProcTexture(material.textureId, position);
+    }
+    return material;
+}
+
+glm::vec3 CpuRenderer::getShadowRayOrigin(const RayState& state, glm::vec3 point, glm::vec3 normalVector) const {
+    return point + normalVector * getHitDistance(state, point) * 1.1f;
+}
+
+glm::vec3 CpuRenderer::getLight(RayState& state, glm::vec3 point, glm::vec3 toLightVector, glm::vec3 viewVector, glm::vec3 normalVector, glm::vec3 lightReflectedVector, int modelId) const {
+    float visibility = traceShadow(state, getShadowRayOrigin(state, point, normalVector), toLightVector, glm::length(lightPosition - point), modelId);
+    return shadeLight(point, toLightVector, viewVector, normalVector, lightReflectedVector, modelId, visibility);
+}
+
+glm::vec3 CpuRenderer::shadeLight(glm::vec3 point, glm::vec3 toLightVector, glm::vec3 viewVector, glm::vec3 normalVector, glm::vec3 lightReflectedVector, int modelId, float visibility) const {
+
+    float dotNL = glm::max(glm::dot(normalVector, toLightVector), 0.0f);
+    float dotRV = glm::max(glm::dot(lightReflectedVector, viewVector), 0.0f);
+
+    // shadowed light is dimmed to 10 %, penumbra blends in between
+    float lightFactor = glm::mix(0.1f, 1.0f, visibility);
+    dotNL *= lightFactor;
+    dotRV *= lightFactor;
+
+    // get material propertios
+    auto material = getMaterial(point, modelId);
+
+    // compute light properties
+    glm::vec3 lightIntensity = glm::vec3(0.65, 0.65, 0.65);
+    glm::vec3 ambientLight   = glm::vec3(material.color) * glm::vec3(0.6, 0.6, 0.6);
+    glm::vec3 diffuseLight   = glm::vec3(material.color) * dotNL;
+    glm::vec3 specularLight  = glm::vec3(material.specularColor) * glm::pow(dotRV, material.shininess);
+
+    // combine light preperties
+    return lightIntensity * (ambientLight + diffuseLight + specularLight);
+}
+
+glm::vec3 CpuRenderer::getColor(RayState& state, glm::vec3 point, int modelId, bool reflection) const {
+    glm::vec3 toLightVector        = glm::normalize(lightPosition - point);
+    glm::vec3 viewVector           = glm::normalize(state.camera.position - point);
+    glm::vec3 normalVector         = getNormal(state, point, modelId);
+    glm::vec3 lightReflectedVector = glm::normalize(glm::reflect(-toLightVector, normalVector));
+    glm::vec3 viewReflectedVector  = glm::normalize(glm::reflect(-viewVector, normalVector));
+
+    glm::vec3 color = getLight(state, point, toLightVector, viewVector, normalVector, lightReflectedVector, modelId);
+
+    if (reflection) {
+        auto material = getMaterial(point, modelId);
+
+        if (material.shininess > 100) {
+            int       model  = modelId; // uninitialized in the shader, a miss should fall back to background
+            glm::vec3 origin = getShadowRayOrigin(state, point, normalVector);
+            float     dist   = rayMarch(state, origin, viewReflectedVector, model);
+            glm::vec3 reflectedColor;
+            if (model != modelId) {
+                toLightVector        = glm::normalize(lightPosition - origin);
+                viewVector           = glm::normalize(state.camera.position - origin);
+                normalVector         = getNormal(state, origin, model);
+                lightReflectedVector = glm::normalize(glm::reflect(-toLightVector, normalVector));
+                origin               = origin + viewReflectedVector * dist;
+                reflectedColor       = getLight(state, point, toLightVector, viewVector, normalVector, lightReflectedVector, model);
+            } else {
+                reflectedColor = backgroundColor;
+            }
+            color = glm::mix(color, reflectedColor, material.shininess / 3000.0f);
+        }
+    }
+
+    return color;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <sceneUtils.h>
+#include <RayCamera.h>
+#include <cpu/Image.h>
+#include <cpu/PacketKernels.h>
+#include <cpu/GeometrySdf.h>
+#include <PixelCounters.h>
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+struct CpuThreadReport {
+    std::chrono::microseconds busy = {}; // time spent rendering tiles
+    uint32_t tiles  = 0;
+    uint32_t stolen = 0; // tiles taken from queues of other threads
+    uint64_t rays   = 0;
+
+    uint64_t primarySteps = 0;
+    uint64_t prepassSteps = 0;
+    uint64_t nodeVisits   = 0;
+};
+
+struct CpuRenderReport {
+    std::chrono::microseconds duration = {};
+    uint32_t threads = 0;
+    uint32_t tiles   = 0;
+    uint64_t rays    = 0; // primary, shadow and reflection rays
+    uint64_t pixels  = 0;
+
+    uint64_t primarySteps = 0; // SDF evaluations of primary rays
+    uint64_t prepassSteps = 0; // SDF evaluations of cone marching in the depth prepass
+    uint64_t nodeVisits   = 0; // BVH node boxes tested by all rays and cones
+
+    std::vector<CpuThreadReport> threadReports;
+
+    inline double raysPerSecond() const { return duration.count() > 0 ? double(rays) * 1e6 / double(duration.count()) : 0.0; }
+
+    // primary ray and prepass steps on average per pixel
+    inline double stepsPerPixel() const { return pixels > 0 ? double(primarySteps + prepassSteps) / double(pixels) : 0.0; }
+
+    inline double nodeVisitsPerRay() const { return rays > 0 ? double(nodeVisits) / double(rays) : 0.0; }
+
+    // busy time of the thread relative to the whole render in <0, 1>
+    inline double utilization(uint32_t thread) const {
+        return duration.count() > 0 ? double(threadReports[thread].busy.count()) / double(duration.count()) : 0.0;
+    }
+    double averageUtilization() const;
+};
+
+// steps per pixel, node visits per ray, per-thread tiles, stolen tiles and utilization
+std::ostream& operator<<(std::ostream& stream, const CpuRenderReport& report);
+
+/**
+ * C++ reference implementation of resources/shaders/fragment.fs.
+ * Renders ShaderSceneData on CPU in tiles spread over worker threads by a work-stealing scheduler.
+ * When packet kernels are available, rays are marched in packets of PACKET_SIZE neighbouring pixels.
+ * With depthPrepass each tile first cone marches cells of PREPASS_CELL_SIZE^2 pixels to find where their primary rays start.
+ */
+class CpuRenderer
+{
+    public:
+        // constants of fragment.fs
+        static constexpr int      MAX_STEPS           = PACKET_MAX_STEPS;
+        static constexpr float    MAX_DISTANCE        = 60.0f;
+        static constexpr float    HIT_DISTANCE_MAX    = PACKET_HIT_DISTANCE_MAX;
+        static constexpr float    HIT_DISTANCE_MIN    = PACKET_HIT_DISTANCE_MIN;
+        static constexpr float    HIT_DISTANCE_FACTOR = PACKET_HIT_DISTANCE_FACTOR;
+        static constexpr uint32_t TILE_SIZE           = 32;
+        static constexpr uint32_t PREPASS_CELL_SIZE   = 8; // same as SceneRenderer::PREPASS_CELL_SIZE
+
+        static_assert(TILE_SIZE % PREPASS_CELL_SIZE == 0 && PREPASS_CELL_SIZE % PACKET_SIZE == 0, "packets must not cross prepass cells");
+
+        glm::vec3 lightPosition   = glm::vec3(10, 10, 0);
+        glm::vec3 backgroundColor = glm::vec3(0.22, 0.23, 0.35);
+        bool      depthPrepass    = false;
+        float     penumbraFactor  = 0;    // see SceneRenderer::setPenumbraFactor
+        bool      specializedSdf  = true; // per ray path evaluates models by GeometrySdf instead of the sdPrimitives interpreter
+
+        CpuRenderer(ShaderSceneData sceneData, PacketKernelType kernelType = PacketKernelType::pkAuto) :
+            scene(std::move(sceneData)),
+            kernels(getPacketKernels(kernelType)),
+            volumes(scene.volumes.count > 0 ? &scene.volumes : nullptr),
+            packetVolumes({ scene.volumes.distances.data(), scene.volumes.resolution })
+        {
+            prepareGeometrySdfs();
+        }
+
+        CpuRenderer(const CpuRenderer&) = delete;
+        CpuRenderer& operator=(const CpuRenderer&) = delete;
+
+        // name of used packet kernels or "none" for the per ray path
+        inline const char* getKernelName() const { return kernels != nullptr ? kernels->name : "none"; }
+
+        // threadCount 0 means one thread per hardware thread, counters are filled with work done for every pixel when given
+        CpuRenderReport render(const RayCamera& camera, Image& target, uint32_t threadCount = 0, PixelCounters* counters = nullptr) const;
+
+        // models and BVH of the same scene after changes, e.g. data of DynamicScene after update, geometries have to stay the same
+        void updateModels(const ShaderSceneData& sceneData);
+
+        // color of single pixel, fragCoord is in <-1, 1> range with y pointing up
+        glm::vec3 renderPixel(const RayCamera& camera, glm::vec2 fragCoord) const;
+
+    private:
+        struct ModelIntersection {
+            int   model;
+            float rayBegin;
+            float rayEnd;
+        };
+
+        // front-to-back traversal of one ray, nodes waiting for a visit are kept with their ray range
+        struct TraversalStack {
+            static constexpr int SIZE = AABBHierarchy::MAX_DEPTH;
+
+            int       node      = -1; // node visited next, -1 pops the stack
+            glm::vec2 range     = glm::vec2(0);
+            float     boxMargin = 0;  // bounding boxes are enlarged to catch cones of the depth prepass
+            int       size      = 0;
+            int       nodes[SIZE];
+            glm::vec2 ranges[SIZE];
+            int       scan      = 0;  // nodes [scan, scanEnd) of a subtree deeper than the stack are scanned by escape links
+            int       scanEnd   = 0;
+        };
+
+        // per-ray state which is global in fragment.fs, also the scratch memory of a worker reused by all its rays
+        struct RayState {
+            const RayCamera& camera;
+            uint64_t         rays         = 0;
+            uint64_t         steps        = 0; // SDF evaluations of all marched rays
+            uint64_t         primarySteps = 0;
+            uint64_t         prepassSteps  = 0;
+            uint64_t         normalSamples = 0; // SDF evaluations of normals
+            uint64_t         nodeVisits    = 0;
+            TraversalStack   stack;
+
+            RayState(const RayCamera& camera) : camera(camera) {}
+
+            // snapshot of counters, work of a pixel is the difference of snapshots taken around it
+            struct Counts {
+                uint64_t rays, steps, prepassSteps, normalSamples, nodeVisits;
+            };
+            inline Counts counts() const { return { rays, steps, prepassSteps, normalSamples, nodeVisits }; }
+        };
+
+        // state of a packet where each lane traverses the BVH on its own
+        struct PacketState : RayState {
+            TraversalStack laneStacks[PACKET_SIZE];
+            uint32_t*      laneCounters[PACKET_SIZE] = {}; // PixelCounters of pixels of the lanes, nullptr when not collected
+
+            PacketState(const RayCamera& camera) : RayState(camera) {}
+
+            inline void countLane(uint32_t lane, PixelCounter counter, uint32_t value) {
+                if (laneCounters[lane] != nullptr) {
+                    laneCounters[lane][counter] += value;
+                }
+            }
+        };
+
+        ShaderSceneData       scene;
+        const PacketKernels*  kernels;
+        const SdfVolumeAtlas* volumes; // points to scene.volumes, nullptr when no volumes are baked
+        PacketVolumes         packetVolumes;
+
+        std::vector<GeometrySdf>              geometrySdfs;
+        std::unordered_map<uint32_t, int32_t> geometrySdfIndices; // index to geometrySdfs by first primitive of the geometry
+        std::vector<int32_t>                  modelGeometrySdfs;  // index to geometrySdfs for every model, -1 for the interpreter
+
+        void prepareGeometrySdfs();
+        void assignGeometrySdfs();
+
+        // primary rays start at startDistance found by the depth prepass
+        glm::vec3 shadePixel(RayState& state, glm::vec2 fragCoord, float startDistance = 0) const;
+        void      shadePacket(PacketState& state, const glm::vec2* fragCoords, float startDistance, uint32_t mask, glm::vec3* colors) const;
+
+        float sdModel(glm::vec3 position, int modelId) const;
+
+        bool  intersectBB(RayState& state, int nodeIndex, glm::vec3 rayOrigin, glm::vec3 direction, float boxMargin, float& rayBegin, float& rayEnd) const;
+        bool  insideBB(int nodeIndex, glm::vec3 point) const;
+        void  beginTraversal(RayState& state, TraversalStack& stack, glm::vec3 rayOrigin, glm::vec3 rayDirection, float boxMargin = 0) const;
+        bool  nextLeaf(RayState& state, TraversalStack& stack, glm::vec3 rayOrigin, glm::vec3 rayDirection, float minRayBegin, float maxDistance,
+                       ModelIntersection& leaf) const;
+        float getHitDistance(const RayState& state, glm::vec3 point) const;
+        float rayMarchModel(RayState& state, glm::vec3 originPoint, glm::vec3 direction, int modelId, float maxDistance) const;
+        float rayMarch(RayState& state, glm::vec3 originPoint, glm::vec3 direction, int& modelId, float startDistance = 0) const;
+
+        // marches masked lanes, distances and modelIds are written as by rayMarch for each lane
+        void rayMarchPacket(PacketState& state, const glm::vec3* origins, const glm::vec3* directions, uint32_t mask, float* distances, int* modelIds,
+                            float startDistance = 0) const;
+
+        // depth prepass, corners are fragCoords of the corner pixel centers of the cell
+        float coneMarchModel(RayState& state, glm::vec3 direction, float spread, const ModelIntersection& intersection) const;
+        float coneMarchCell(RayState& state, glm::vec2 cornerMin, glm::vec2 cornerMax) const;
+
+        // shadow rays, light visibility in <0, 1> of a ray toward the light ignoring the shaded model
+        float shadowMarchModel(RayState& state, glm::vec3 originPoint, glm::vec3 direction, int modelId, float rayBegin, float maxDistance) const;
+        float penumbraMargin(float maxDistance) const;
+        float traceShadow(RayState& state, glm::vec3 originPoint, glm::vec3 direction, float maxDistance, int ignoredModel) const;
+        void  traceShadowPacket(PacketState& state, const glm::vec3* origins, const glm::vec3* directions, const float* maxDistances,
+                                const int* ignoredModels, uint32_t mask, float* visibilities) const;
+
+        glm::vec3      getNormal(RayState& state, glm::vec3 point, int modelId) const;
+        void           getNormalsPacket(PacketState& state, const glm::vec3* points, const int* modelIds, uint32_t mask, glm::vec3* normals) const;
+        ShaderMaterial getMaterial(glm::vec3 position, int modelId) const;
+        glm::vec3      getShadowRayOrigin(const RayState& state, glm::vec3 point, glm::vec3 normalVector) const;
+        glm::vec3      getLight(RayState& state, glm::vec3 point, glm::vec3 toLightVector, glm::vec3 viewVector, glm::vec3 normalVector, glm::vec3 lightReflectedVector, int modelId) const;
+        glm::vec3      shadeLight(glm::vec3 point, glm::vec3 toLightVector, glm::vec3 viewVector, glm::vec3 normalVector, glm::vec3 lightReflectedVector, int modelId, float visibility) const;
+        glm::vec3      getColor(RayState& state, glm::vec3 point, int modelId, bool reflection) const;
+};
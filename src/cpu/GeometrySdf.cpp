@@ -0,0 +1,92 @@
+#include <cpu/GeometrySdf.h>
+
+using namespace std;
+
+template<TransformKind Kind>
+static inline glm::vec3 toPrimitiveSpace(const FoldedPrimitive& primitive, glm::vec3 p) {
+    if constexpr (Kind == TransformKind::tkIdentity) {
+        return p;
+    } else if constexpr (Kind == TransformKind::tkTranslation) {
+        return p + primitive.translation;
+    } else {
+        return primitive.rotation * p + primitive.translation;
+    }
+}
+
+template<PrimitiveType Type>
+static inline float sdFolded(glm::vec3 p, glm::vec4 data) {
+    if constexpr (Type == PrimitiveType::ptSphere)    return sdSphere(p, data);
+    if constexpr (Type == PrimitiveType::ptCapsule)   return sdCapsule(p, data);
+    if constexpr (Type == PrimitiveType::ptTorus)     return sdTorus(p, data);
+    if constexpr (Type == PrimitiveType::ptBox)       return sdBox(p, data);
+    if constexpr (Type == PrimitiveType::ptCilinder)  return sdCilinder(p, data);
+    if constexpr (Type == PrimitiveType::ptCone)      return sdCone(p, data);
+    if constexpr (Type == PrimitiveType::ptRoundCone) return roundCone(p, data);
+    return SDF_MAX_DISTANCE;
+}
+
+// one iteration of the loop in sdPrimitives
+template<PrimitiveType Type, PrimitiveOperation Operation, TransformKind Kind>
+static float applyPrimitive(const FoldedPrimitive& primitive, glm::vec3 p, float d, float scale) {
+    float blending = primitive.blending * scale;
+
+    // primitive distance is at least distance to its bounding sphere, skipped when blending would keep d as it is
+    if constexpr (Operation != PrimitiveOperation::Intersect) {
+        float lowerBound = (glm::length(p - glm::vec3(primitive.bound)) - primitive.bound.w) * scale;
+        if (Operation == PrimitiveOperation::Add && lowerBound >= d + blending) {
+            return d;
+        }
+        if (Operation == PrimitiveOperation::Substract && lowerBound >= blending - d) {
+            return d;
+        }
+    }
+
+    float distToPrimitive = sdFolded<Type>(toPrimitiveSpace<Kind>(primitive, p), primitive.data) * scale;
+    if constexpr (Operation == PrimitiveOperation::Add)       return smoothMin(distToPrimitive, d, blending);
+    if constexpr (Operation == PrimitiveOperation::Substract) return smoothMax(-distToPrimitive, d, blending);
+    return smoothMax(distToPrimitive, d, blending);
+}
+
+// unknown operations keep the distance as in sdPrimitives
+static float skipPrimitive(const FoldedPrimitive&, glm::vec3, float d, float) {
+    return d;
+}
+
+template<PrimitiveType Type, PrimitiveOperation Operation>
+static GeometrySdf::PrimitiveFunction selectTransform(TransformKind kind) {
+    switch (kind) {
+        case TransformKind::tkIdentity:    return &applyPrimitive<Type, Operation, TransformKind::tkIdentity>;
+        case TransformKind::tkTranslation: return &applyPrimitive<Type, Operation, TransformKind::tkTranslation>;
+        case TransformKind::tkGeneral:     return &applyPrimitive<Type, Operation, TransformKind::tkGeneral>;
+    }
+    return &applyPrimitive<Type, Operation, TransformKind::tkGeneral>;
+}
+
+template<PrimitiveType Type>
+static GeometrySdf::PrimitiveFunction selectOperation(PrimitiveOperation operation, TransformKind kind) {
+    switch (operation) {
+        case PrimitiveOperation::Add:       return selectTransform<Type, PrimitiveOperation::Add>(kind);
+        case PrimitiveOperation::Substract: return selectTransform<Type, PrimitiveOperation::Substract>(kind);
+        case PrimitiveOperation::Intersect: return selectTransform<Type, PrimitiveOperation::Intersect>(kind);
+        default:                            return &skipPrimitive;
+    }
+}
+
+static GeometrySdf::PrimitiveFunction selectFunction(const FoldedPrimitive& primitive) {
+    switch (primitive.type) {
+        case PrimitiveType::ptSphere:    return selectOperation<PrimitiveType::ptSphere>(primitive.operation, primitive.transformKind);
+        case PrimitiveType::ptCapsule:   return selectOperation<PrimitiveType::ptCapsule>(primitive.operation, primitive.transformKind);
+        case PrimitiveType::ptTorus:     return selectOperation<PrimitiveType::ptTorus>(primitive.operation, primitive.transformKind);
+        case PrimitiveType::ptBox:       return selectOperation<PrimitiveType::ptBox>(primitive.operation, primitive.transformKind);
+        case PrimitiveType::ptCilinder:  return selectOperation<PrimitiveType::ptCilinder>(primitive.operation, primitive.transformKind);
+        case PrimitiveType::ptCone:      return selectOperation<PrimitiveType::ptCone>(primitive.operation, primitive.transformKind);
+        case PrimitiveType::ptRoundCone: return selectOperation<PrimitiveType::ptRoundCone>(primitive.operation, primitive.transformKind);
+        default:                         return selectOperation<PrimitiveType::ptInvalid>(primitive.operation, TransformKind::tkIdentity);
+    }
+}
+
+GeometrySdf::GeometrySdf(const FoldedGeometry& geometry) : primitives(geometry.primitives) {
+    for (const auto& primitive : primitives) {
+        functions.push_back(selectFunction(primitive));
+    }
+}
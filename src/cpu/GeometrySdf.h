@@ -0,0 +1,44 @@
+#pragma once
+
+#include <SdfCodegen.h>
+#include <cpu/Sdf.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/**
+ * CPU counterpart of the functions emitted by generateGeometrySdfGlsl.
+ * Each primitive of a folded geometry is evaluated by a function template instantiated for its type, operation
+ * and transform kind, so the evaluation has no switches and no matrix product for primitives without rotation.
+ */
+class GeometrySdf
+{
+    public:
+        // applies the primitive to distance d of the preceding primitives as one iteration of sdPrimitives
+        using PrimitiveFunction = float (*)(const FoldedPrimitive& primitive, glm::vec3 p, float d, float scale);
+
+        GeometrySdf(const FoldedGeometry& geometry);
+
+        // same as sdPrimitives for the geometry, p is in geometry space
+        inline float evaluate(glm::vec3 p, float scale) const {
+            float d = SDF_MAX_DISTANCE;
+            for (size_t i = 0; i < primitives.size(); ++i) {
+                d = functions[i](primitives[i], p, d, scale);
+            }
+            return d;
+        }
+
+    private:
+        std::vector<FoldedPrimitive>   primitives;
+        std::vector<PrimitiveFunction> functions;
+};
+
+inline float sdModel(glm::vec3 position, const ShaderModel& model, const GeometrySdf& geometry, const SdfVolumeAtlas* volumes = nullptr) {
+    glm::vec3 p;
+    float     distance;
+    if (sdModelBound(position, model, volumes, p, distance)) {
+        return distance;
+    }
+    return geometry.evaluate(p, model.scale);
+}
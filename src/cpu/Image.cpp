@@ -0,0 +1,131 @@
+
+#include <cpu/Image.h>
+
+#include <fstream>
+#include <array>
+
+using namespace std;
+
+void Image::setPixel(uint32_t x, uint32_t y, glm::vec3 color) {
+    auto clamped = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    auto offset  = (size_t(y) * width + x) * 3;
+    pixels[offset + 0] = uint8_t(clamped.x);
+    pixels[offset + 1] = uint8_t(clamped.y);
+    pixels[offset + 2] = uint8_t(clamped.z);
+}
+
+bool Image::writePPM(const string& fileName) const {
+    ofstream stream(fileName, ios::binary);
+    if (!stream.good()) {
+        return false;
+    }
+    stream << "P6\n" << width << " " << height << "\n255\n";
+    stream.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+    return stream.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PNG
+//
+// Minimal dependency free encoder - zlib stream is made of uncompressed (stored) deflate blocks.
+// See https://www.w3.org/TR/png/ and https://www.rfc-editor.org/rfc/rfc1950
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+    const array<uint32_t, 256> crcTable = [] {
+        array<uint32_t, 256> table = {};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return table;
+    }();
+
+    uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    void pushU32(vector<uint8_t>& target, uint32_t value) {
+        target.push_back(uint8_t(value >> 24));
+        target.push_back(uint8_t(value >> 16));
+        target.push_back(uint8_t(value >> 8));
+        target.push_back(uint8_t(value));
+    }
+
+    void writeChunk(ofstream& stream, const char type[4], const vector<uint8_t>& data) {
+        vector<uint8_t> chunk;
+        chunk.reserve(data.size() + 12);
+        pushU32(chunk, uint32_t(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        pushU32(chunk, updateCrc(0xFFFFFFFFu, chunk.data() + 4, chunk.size() - 4) ^ 0xFFFFFFFFu);
+        stream.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+}
+
+bool Image::writePNG(const string& fileName) const {
+    ofstream stream(fileName, ios::binary);
+    if (!stream.good()) {
+        return false;
+    }
+
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    stream.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    vector<uint8_t> header;
+    pushU32(header, width);
+    pushU32(header, height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit depth, RGB, deflate, no filter, no interlace
+    writeChunk(stream, "IHDR", header);
+
+    // raw scanlines each prefixed with filter type 0
+    size_t rowSize = size_t(width) * 3;
+    vector<uint8_t> raw;
+    raw.reserve((rowSize + 1) * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels.begin() + y * rowSize, pixels.begin() + (y + 1) * rowSize);
+    }
+
+    // zlib stream with stored blocks of at most 65535 bytes
+    vector<uint8_t> zlib = { 0x78, 0x01 };
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    size_t offset = 0;
+    do {
+        size_t blockSize = glm::min(raw.size() - offset, size_t(65535));
+        bool   final     = offset + blockSize == raw.size();
+        zlib.push_back(final ? 1 : 0);
+        zlib.push_back(uint8_t(blockSize));
+        zlib.push_back(uint8_t(blockSize >> 8));
+        zlib.push_back(uint8_t(~blockSize));
+        zlib.push_back(uint8_t(~blockSize >> 8));
+        for (size_t i = offset; i < offset + blockSize; ++i) {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < raw.size());
+    pushU32(zlib, (adlerB << 16) | adlerA);
+    writeChunk(stream, "IDAT", zlib);
+
+    writeChunk(stream, "IEND", {});
+    return stream.good();
+}
+
+bool Image::write(const string& fileName) const {
+    auto dot = fileName.find_last_of('.');
+    if (dot != string::npos && fileName.substr(dot) == ".ppm") {
+        return writePPM(fileName);
+    }
+    return writePNG(fileName);
+}
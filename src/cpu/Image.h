@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/**
+ * 8-bit RGB image with top-down row order.
+ */
+class Image
+{
+    public:
+        uint32_t width  = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> pixels = {};
+
+        Image(uint32_t width, uint32_t height) : width(width), height(height), pixels(width * height * 3, 0) {}
+
+        void setPixel(uint32_t x, uint32_t y, glm::vec3 color);
+
+        bool writePPM(const std::string& fileName) const;
+        bool writePNG(const std::string& fileName) const;
+
+        // chooses format by file extension, PNG is default
+        bool write(const std::string& fileName) const;
+};
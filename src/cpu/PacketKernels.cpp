@@ -0,0 +1,41 @@
+
+#include <cpu/PacketKernels.h>
+
+#include <RenderBase/tools/utils.h>
+
+#include <unordered_map>
+
+using namespace std;
+
+// defined in instruction set specific translation units
+const PacketKernels* getAvx2PacketKernels();
+const PacketKernels* getScalarPacketKernels();
+
+static const unordered_map<string, PacketKernelType> packetKernelTypeDict = {
+    {"auto",   PacketKernelType::pkAuto},
+    {"avx2",   PacketKernelType::pkAvx2},
+    {"scalar", PacketKernelType::pkScalar},
+    {"none",   PacketKernelType::pkNone},
+    {"off",    PacketKernelType::pkNone},
+};
+
+static bool cpuSupportsAvx2() {
+    #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    #else
+    return false;
+    #endif
+}
+
+const PacketKernels* getPacketKernels(PacketKernelType type) {
+    switch (type) {
+        case PacketKernelType::pkAuto:   return cpuSupportsAvx2() && getAvx2PacketKernels() ? getAvx2PacketKernels() : getScalarPacketKernels();
+        case PacketKernelType::pkAvx2:   return cpuSupportsAvx2() ? getAvx2PacketKernels() : nullptr;
+        case PacketKernelType::pkScalar: return getScalarPacketKernels();
+        default: return nullptr;
+    }
+}
+
+PacketKernelType packetKernelTypeFromString(const string& name) {
+    return rb::utils::getOr(packetKernelTypeDict, rb::utils::toLower(name), PacketKernelType::pkAuto);
+}
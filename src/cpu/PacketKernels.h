@@ -0,0 +1,72 @@
+#pragma once
+
+#include <sceneUtils.h>
+
+#include <cstdint>
+#include <string>
+
+#define PACKET_SIZE 8
+
+// constants of fragment.fs used by kernels, CpuRenderer takes them from here
+// so kernel translation units do not include the renderer header (see PacketKernelsAvx2.cpp)
+constexpr int   PACKET_MAX_STEPS           = 50;
+constexpr float PACKET_HIT_DISTANCE_MAX    = 0.5f;
+constexpr float PACKET_HIT_DISTANCE_MIN    = 0.003f;
+constexpr float PACKET_HIT_DISTANCE_FACTOR = 0.0001f;
+
+/**
+ * SoA packet of rays marched against a single model. Only lanes set in mask are active.
+ */
+struct RayPacket {
+    alignas(32) float originX[PACKET_SIZE]     = {};
+    alignas(32) float originY[PACKET_SIZE]     = {};
+    alignas(32) float originZ[PACKET_SIZE]     = {};
+    alignas(32) float directionX[PACKET_SIZE]  = {};
+    alignas(32) float directionY[PACKET_SIZE]  = {};
+    alignas(32) float directionZ[PACKET_SIZE]  = {};
+    alignas(32) float maxDistance[PACKET_SIZE] = {};
+    alignas(32) float rayBegin[PACKET_SIZE]    = {}; // distance of origin from the start of the ray, used by penumbra
+    float    cameraX = 0; // hit distance depends on distance from camera
+    float    cameraY = 0;
+    float    cameraZ = 0;
+    uint32_t mask    = 0;
+};
+
+// raw view of SdfVolumeAtlas, kernels cannot call std::vector code (see PacketKernelsAvx2.cpp)
+struct PacketVolumes {
+    const float* distances  = nullptr;
+    uint32_t     resolution = 0;
+};
+
+/**
+ * Vectorized counterparts of sdModel, rayMarchModel and shadowMarchModel evaluating PACKET_SIZE positions per call.
+ */
+struct PacketKernels {
+    const char* name;
+
+    // distances of PACKET_SIZE positions to a model, volumes may be nullptr when none are baked
+    void (*sdModel)(const float* x, const float* y, const float* z, const ShaderModel& model, const ShaderPrimitive* primitives,
+                    const PacketVolumes* volumes, float* distances);
+
+    // marches active lanes of the packet against the model, distances are clamped to lane maxDistance,
+    // steps receive the count of SDF evaluations of each lane
+    void (*rayMarchModel)(const RayPacket& packet, const ShaderModel& model, const ShaderPrimitive* primitives,
+                          const PacketVolumes* volumes, float* distances, float* steps);
+
+    // shadow variant of rayMarchModel, visibilities are 0 for lanes hitting the model, otherwise 1
+    // or the penumbra min(penumbraFactor * distance / t) when penumbraFactor > 0
+    void (*shadowMarchModel)(const RayPacket& packet, const ShaderModel& model, const ShaderPrimitive* primitives,
+                             const PacketVolumes* volumes, float penumbraFactor, float* visibilities, float* steps);
+};
+
+enum PacketKernelType {
+    pkAuto   = 0, // best one supported by CPU
+    pkAvx2   = 1,
+    pkScalar = 2, // portable code relying on compiler auto-vectorization
+    pkNone   = 3, // no packets - per ray reference path
+};
+
+// returns nullptr when requested kernels are not supported by CPU or by build
+const PacketKernels* getPacketKernels(PacketKernelType type);
+
+PacketKernelType packetKernelTypeFromString(const std::string& name);
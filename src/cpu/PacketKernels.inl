@@ -0,0 +1,322 @@
+/**
+ * Packet port of sdModel and rayMarchModel from primitive_sdf.fs and fragment.fs.
+ *
+ * This file is compiled once per instruction set. The including file provides 8-wide float type F8, lane mask M8
+ * and the free functions load, store, min, max, abs, sqrt, select, any and maskFromBits working on them.
+ * Operation of a primitive is uniform across the packet, so switches here do not diverge.
+ */
+
+struct V3 {
+    F8 x, y, z;
+};
+
+// rows of the packed transform are stored continuously, reading it as a raw array avoids calling glm inline code here,
+// the kind is uniform across the packet so the branches do not diverge
+template<typename Object>
+static inline V3 transformPos(const Object& object, const V3& p) {
+    const float* m = reinterpret_cast<const float*>(&object.transform);
+    switch (object.transformKind) {
+        case TransformKind::tkIdentity:    return p;
+        case TransformKind::tkTranslation: return { p.x + m[3], p.y + m[7], p.z + m[11] };
+    }
+    return {
+        F8(m[0]) * p.x + F8(m[1]) * p.y + F8(m[2])  * p.z + F8(m[3]),
+        F8(m[4]) * p.x + F8(m[5]) * p.y + F8(m[6])  * p.z + F8(m[7]),
+        F8(m[8]) * p.x + F8(m[9]) * p.y + F8(m[10]) * p.z + F8(m[11]),
+    };
+}
+
+static inline F8 length2(F8 x, F8 y)       { return sqrt(x * x + y * y); }
+static inline F8 length3(F8 x, F8 y, F8 z) { return sqrt(x * x + y * y + z * z); }
+static inline F8 clamp(F8 x, F8 lo, F8 hi) { return min(max(x, lo), hi); }
+static inline F8 mix(F8 a, F8 b, F8 h)     { return a + (b - a) * h; }
+
+static inline F8 smoothMin(F8 dist1, F8 dist2, float koeficient) {
+    if (koeficient <= 0.0f) {
+        return min(dist1, dist2);
+    }
+    F8 h = clamp(0.5f + 0.5f * (dist1 - dist2) / F8(koeficient), 0.0f, 1.0f);
+    return mix(dist1, dist2, h) - koeficient * h * (1.0f - h);
+}
+
+static inline F8 smoothMax(F8 dist1, F8 dist2, float koeficient) {
+    if (koeficient <= 0.0f) {
+        return max(dist1, dist2);
+    }
+    F8 h = clamp(0.5f - 0.5f * (dist1 - dist2) / F8(koeficient), 0.0f, 1.0f);
+    return mix(dist1, dist2, h) + koeficient * h * (1.0f - h);
+}
+
+// primitive SD functions
+
+static inline F8 sdSphere(const V3& position, const ShaderPrimitive& sphere) {
+    V3 p = transformPos(sphere, position);
+    return length3(p.x, p.y, p.z) - sphere.data.x;
+}
+
+static inline F8 sdCapsule(const V3& position, const ShaderPrimitive& capsule) {
+    V3    p   = transformPos(capsule, position);
+    float ay  = 0.5f * capsule.data.y;
+    float aby = -capsule.data.y;     // ab = b - a = (0, -h, 0)
+    F8    apy = p.y - ay;
+    F8    t   = clamp((aby * apy) / (aby * aby), 0.0f, 1.0f);
+    return length3(p.x, apy - aby * t, p.z) - capsule.data.x;
+}
+
+static inline F8 sdTorus(const V3& position, const ShaderPrimitive& torus) {
+    V3 p = transformPos(torus, position);
+    F8 x = length2(p.x, p.z) - torus.data.x;
+    return length2(x, p.y) - torus.data.y;
+}
+
+static inline F8 sdBox(const V3& position, const ShaderPrimitive& box) {
+    V3 p  = transformPos(box, position);
+    F8 dx = abs(p.x) - box.data.x + box.data.w;
+    F8 dy = abs(p.y) - box.data.y + box.data.w;
+    F8 dz = abs(p.z) - box.data.z + box.data.w;
+    F8 e  = length3(max(dx, 0.0f), max(dy, 0.0f), max(dz, 0.0f)); // exterior distance
+    F8 i  = min(max(dx, max(dy, dz)), 0.0f);                       // interior distance
+    return e + i - box.data.w;
+}
+
+static inline F8 sdCilinder(const V3& position, const ShaderPrimitive& cilinder) {
+    V3    p  = transformPos(cilinder, position);
+    float w  = cilinder.data.x - cilinder.data.z;
+    float h  = cilinder.data.y - cilinder.data.z;
+    F8    dx = length2(p.x, p.z) - w;
+    F8    dy = abs(p.y) - h;
+    return min(max(dx, dy), 0.0f) + length2(max(dx, 0.0f), max(dy, 0.0f)) - cilinder.data.z;
+}
+
+static inline F8 sdCone(const V3& position, const ShaderPrimitive& cone) {
+    float r1 = cone.data.x - cone.data.w;
+    float r2 = cone.data.y - cone.data.w;
+    float h  = cone.data.z - cone.data.w;
+    V3    p  = transformPos(cone, position);
+
+    F8    qx   = length2(p.x, p.z);
+    F8    qy   = p.y;
+    float k2x  = r2 - r1;
+    float k2y  = 2.0f * h;
+    F8    cax  = qx - min(qx, select(qy < 0.0f, F8(r1), F8(r2)));
+    F8    cay  = abs(qy) - h;
+    F8    t    = clamp(((r2 - qx) * k2x + (h - qy) * k2y) / (k2x * k2x + k2y * k2y), 0.0f, 1.0f);
+    F8    cbx  = qx - r2 + k2x * t;
+    F8    cby  = qy - h  + k2y * t;
+    F8    s    = select((cbx < 0.0f) & (cay < 0.0f), F8(-1.0f), F8(1.0f));
+    return s * sqrt(min(cax * cax + cay * cay, cbx * cbx + cby * cby)) - cone.data.w;
+}
+
+static inline F8 roundCone(const V3& position, const ShaderPrimitive& roundCone) {
+    float r1 = roundCone.data.x;
+    float r2 = roundCone.data.y;
+    float h  = roundCone.data.z;
+    V3    p  = transformPos(roundCone, position);
+
+    F8 qx = length2(p.x, p.z);
+    F8 qy = p.y + h * 0.5f;
+
+    float b = (r1 - r2) / h;
+    F8    a = sqrt(F8(1.0f - b * b)); // packet sqrt, the scalar one is inline code shared with other translation units
+    F8    k = qx * -b + qy * a;
+
+    // branches of the shader evaluated for all lanes, the first branch has the highest priority
+    F8 dist = qx * a + qy * b - r1;
+    dist = select(k > a * h, length2(qx, qy - h) - r2, dist);
+    dist = select(k < 0.0f, length2(qx, qy) - r1, dist);
+    return dist;
+}
+
+static inline F8 sdPrimitive(const V3& position, const ShaderPrimitive& primitive) {
+    switch (primitive.type) {
+        case PrimitiveType::ptSphere:    return sdSphere(position, primitive);
+        case PrimitiveType::ptCapsule:   return sdCapsule(position, primitive);
+        case PrimitiveType::ptTorus:     return sdTorus(position, primitive);
+        case PrimitiveType::ptBox:       return sdBox(position, primitive);
+        case PrimitiveType::ptCilinder:  return sdCilinder(position, primitive);
+        case PrimitiveType::ptCone:      return sdCone(position, primitive);
+        case PrimitiveType::ptRoundCone: return roundCone(position, primitive);
+    }
+    return F8(SDF_MAX_DISTANCE);
+}
+
+static inline F8 sdBound(const V3& p, const float* boundMin, const float* boundMax) {
+    F8 dx = max(boundMin[0] - p.x, p.x - boundMax[0]);
+    F8 dy = max(boundMin[1] - p.y, p.y - boundMax[1]);
+    F8 dz = max(boundMin[2] - p.z, p.z - boundMax[2]);
+    return length3(max(dx, 0.0f), max(dy, 0.0f), max(dz, 0.0f)) + min(max(dx, max(dy, dz)), 0.0f);
+}
+
+// texel coordinates are vectorized, samples are gathered per lane, see sdVolume in Sdf.h
+static inline F8 sdVolume(const V3& p, const ShaderModel& model, const PacketVolumes& volumes) {
+    const float* boundMin   = reinterpret_cast<const float*>(&model.boundMin);
+    const float* boundMax   = reinterpret_cast<const float*>(&model.boundMax);
+    uint32_t     resolution = volumes.resolution;
+    float        last       = float(resolution - 1);
+    float        sizeX      = boundMax[0] - boundMin[0] + 2.0f * SDF_VOLUME_MARGIN;
+    float        sizeY      = boundMax[1] - boundMin[1] + 2.0f * SDF_VOLUME_MARGIN;
+    float        sizeZ      = boundMax[2] - boundMin[2] + 2.0f * SDF_VOLUME_MARGIN;
+
+    alignas(32) float texelX[PACKET_SIZE];
+    alignas(32) float texelY[PACKET_SIZE];
+    alignas(32) float texelZ[PACKET_SIZE];
+    alignas(32) float values[PACKET_SIZE];
+    store(texelX, (p.x - (boundMin[0] - SDF_VOLUME_MARGIN)) / F8(sizeX) * last);
+    store(texelY, (p.y - (boundMin[1] - SDF_VOLUME_MARGIN)) / F8(sizeY) * last);
+    store(texelZ, (p.z - (boundMin[2] - SDF_VOLUME_MARGIN)) / F8(sizeZ) * last);
+
+    size_t dy = resolution;
+    size_t dz = size_t(resolution) * resolution;
+    for (int lane = 0; lane < PACKET_SIZE; ++lane) {
+        float tx = texelX[lane], ty = texelY[lane], tz = texelZ[lane];
+        if (tx < 0.0f || ty < 0.0f || tz < 0.0f || tx > last || ty > last || tz > last) {
+            values[lane] = -1.0e30f; // stays negative after the error is subtracted
+            continue;
+        }
+        uint32_t cx = uint32_t(tx) < resolution - 2 ? uint32_t(tx) : resolution - 2;
+        uint32_t cy = uint32_t(ty) < resolution - 2 ? uint32_t(ty) : resolution - 2;
+        uint32_t cz = uint32_t(tz) < resolution - 2 ? uint32_t(tz) : resolution - 2;
+        float    fx = tx - float(cx), fy = ty - float(cy), fz = tz - float(cz);
+
+        const float* s = volumes.distances + (size_t(model.volumeId) * resolution + cz) * dz + cy * dy + cx;
+        float d00 = s[0]       * (1.0f - fx) + s[1]           * fx;
+        float d10 = s[dy]      * (1.0f - fx) + s[dy + 1]      * fx;
+        float d01 = s[dz]      * (1.0f - fx) + s[dz + 1]      * fx;
+        float d11 = s[dz + dy] * (1.0f - fx) + s[dz + dy + 1] * fx;
+        float d0  = d00 * (1.0f - fy) + d10 * fy;
+        float d1  = d01 * (1.0f - fy) + d11 * fy;
+        values[lane] = d0 * (1.0f - fz) + d1 * fz;
+    }
+    return load(values) - 0.5f * sqrt(F8(sizeX * sizeX + sizeY * sizeY + sizeZ * sizeZ)) / last;
+}
+
+static inline F8 sdModel(const V3& position, const ShaderModel& model, const ShaderPrimitive* primitives, const PacketVolumes* volumes) {
+    F8 finalDist = F8(SDF_MAX_DISTANCE);
+    V3 p         = transformPos(model, position);
+    p = { p.x / model.scale, p.y / model.scale, p.z / model.scale };
+
+    // lanes far from the model take distance of its bound, lanes far from the surface of baked volume take the baked distance,
+    // primitives are evaluated only when some lane is near
+    F8 boundDist = sdBound(p, reinterpret_cast<const float*>(&model.boundMin), reinterpret_cast<const float*>(&model.boundMax)) * model.scale;
+    M8 done      = boundDist > SDF_MODEL_BOUND_DISTANCE;
+    F8 doneDist  = boundDist;
+    if (volumes != nullptr && model.volumeId >= 0 && any(!done)) {
+        F8 bakedDist = sdVolume(p, model, *volumes) * model.scale;
+        M8 baked     = !done & (bakedDist > SDF_VOLUME_ANALYTIC);
+        doneDist     = select(baked, bakedDist, doneDist);
+        done         = done | baked;
+    }
+    if (!any(!done)) {
+        return doneDist;
+    }
+
+    for (uint32_t i = 0; i < model.primitiveCount; ++i) {
+        const auto& primitive = primitives[i + model.geometryId];
+        float blending        = primitive.blending * model.scale;
+
+        // skipped only when no lane could be changed by blending the primitive, see sdModel in Sdf.h
+        const float* bound = reinterpret_cast<const float*>(&primitive.bound);
+        F8 lowerBound = (length3(p.x - bound[0], p.y - bound[1], p.z - bound[2]) - bound[3]) * model.scale;
+        if (primitive.operation == PrimitiveOperation::Add && !any(lowerBound < finalDist + blending)) {
+            continue;
+        }
+        if (primitive.operation == PrimitiveOperation::Substract && !any(lowerBound < blending - finalDist)) {
+            continue;
+        }
+
+        F8 distToPrimitive = sdPrimitive(p, primitive) * model.scale;
+
+        switch (primitive.operation) {
+            case PrimitiveOperation::Add:       finalDist = smoothMin(distToPrimitive, finalDist, blending); break;
+            case PrimitiveOperation::Substract: finalDist = smoothMax(-distToPrimitive, finalDist, blending); break;
+            case PrimitiveOperation::Intersect: finalDist = smoothMax(distToPrimitive, finalDist, blending); break;
+        }
+    }
+
+    return select(done, doneDist, finalDist);
+}
+
+// kernel entry points
+
+static void sdModelPacket(const float* x, const float* y, const float* z, const ShaderModel& model, const ShaderPrimitive* primitives,
+                          const PacketVolumes* volumes, float* distances) {
+    store(distances, sdModel({ load(x), load(y), load(z) }, model, primitives, volumes));
+}
+
+static void rayMarchModelPacket(const RayPacket& packet, const ShaderModel& model, const ShaderPrimitive* primitives,
+                                const PacketVolumes* volumes, float* distances, float* steps) {
+    V3 origin      = { load(packet.originX), load(packet.originY), load(packet.originZ) };
+    V3 direction   = { load(packet.directionX), load(packet.directionY), load(packet.directionZ) };
+    F8 maxDistance = load(packet.maxDistance);
+
+    F8 distanceMarched = 0.0f;
+    F8 stepCount       = 0.0f;
+    M8 active          = maskFromBits(packet.mask);
+    for (int step = 0; step < PACKET_MAX_STEPS && any(active); ++step) {
+        V3 position = {
+            origin.x + distanceMarched * direction.x,
+            origin.y + distanceMarched * direction.y,
+            origin.z + distanceMarched * direction.z,
+        };
+        F8 dist = sdModel(position, model, primitives, volumes);
+        distanceMarched = select(active, distanceMarched + dist, distanceMarched);
+        stepCount       = select(active, stepCount + 1.0f, stepCount);
+
+        // getHitDistance
+        F8 cameraDistance = length3(position.x - packet.cameraX, position.y - packet.cameraY, position.z - packet.cameraZ);
+        F8 hitDistance    = clamp(
+            cameraDistance * cameraDistance * PACKET_HIT_DISTANCE_FACTOR,
+            PACKET_HIT_DISTANCE_MIN,
+            PACKET_HIT_DISTANCE_MAX
+        );
+
+        active = active & !((dist <= hitDistance) | (distanceMarched >= maxDistance));
+    }
+
+    store(distances, min(distanceMarched, maxDistance));
+    store(steps, stepCount);
+}
+
+static void shadowMarchModelPacket(const RayPacket& packet, const ShaderModel& model, const ShaderPrimitive* primitives,
+                                   const PacketVolumes* volumes, float penumbraFactor, float* visibilities, float* steps) {
+    V3 origin      = { load(packet.originX), load(packet.originY), load(packet.originZ) };
+    V3 direction   = { load(packet.directionX), load(packet.directionY), load(packet.directionZ) };
+    F8 maxDistance = load(packet.maxDistance);
+    F8 rayBegin    = load(packet.rayBegin);
+
+    F8 distanceMarched = 0.0f;
+    F8 stepCount       = 0.0f;
+    F8 visibility      = 1.0f;
+    M8 active          = maskFromBits(packet.mask);
+    M8 hit             = maskFromBits(0);
+    for (int step = 0; step < PACKET_MAX_STEPS && any(active); ++step) {
+        V3 position = {
+            origin.x + distanceMarched * direction.x,
+            origin.y + distanceMarched * direction.y,
+            origin.z + distanceMarched * direction.z,
+        };
+        F8 dist = sdModel(position, model, primitives, volumes);
+        if (penumbraFactor > 0.0f) {
+            visibility = select(active, min(visibility, penumbraFactor * dist / (rayBegin + distanceMarched)), visibility);
+        }
+        distanceMarched = select(active, distanceMarched + dist, distanceMarched);
+        stepCount       = select(active, stepCount + 1.0f, stepCount);
+
+        // getHitDistance
+        F8 cameraDistance = length3(position.x - packet.cameraX, position.y - packet.cameraY, position.z - packet.cameraZ);
+        F8 hitDistance    = clamp(
+            cameraDistance * cameraDistance * PACKET_HIT_DISTANCE_FACTOR,
+            PACKET_HIT_DISTANCE_MIN,
+            PACKET_HIT_DISTANCE_MAX
+        );
+
+        M8 inside = distanceMarched < maxDistance;
+        hit       = hit | (active & inside & (dist <= hitDistance));
+        active    = active & inside & !(dist <= hitDistance);
+    }
+
+    // lanes still active ran out of steps which counts as a hit as in rayMarchModel
+    hit = hit | active;
+    store(visibilities, select(hit, F8(0.0f), clamp(visibility, 0.0f, 1.0f)));
+    store(steps, stepCount);
+}
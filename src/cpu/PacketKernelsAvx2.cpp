@@ -0,0 +1,73 @@
+
+#include <cpu/PacketKernels.h>
+#include <cpu/SdfConstants.h>
+
+/**
+ * AVX2 + FMA variant, this file alone is compiled with these instruction sets enabled (see CMakeLists.txt).
+ * Code below must not call any inline function shared with other translation units (e.g. from glm),
+ * linker could otherwise pick its AVX2 instance for the whole program.
+ */
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <immintrin.h>
+
+namespace packet_avx2 {
+
+    struct F8 {
+        __m256 v;
+        F8() = default;
+        F8(__m256 v) : v(v) {}
+        F8(float s) : v(_mm256_set1_ps(s)) {}
+    };
+
+    struct M8 {
+        __m256 v;
+    };
+
+    static inline F8 operator+(F8 a, F8 b) { return _mm256_add_ps(a.v, b.v); }
+    static inline F8 operator-(F8 a, F8 b) { return _mm256_sub_ps(a.v, b.v); }
+    static inline F8 operator*(F8 a, F8 b) { return _mm256_mul_ps(a.v, b.v); }
+    static inline F8 operator/(F8 a, F8 b) { return _mm256_div_ps(a.v, b.v); }
+    static inline F8 operator-(F8 a)       { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+
+    static inline F8 min(F8 a, F8 b)          { return _mm256_min_ps(a.v, b.v); }
+    static inline F8 max(F8 a, F8 b)          { return _mm256_max_ps(a.v, b.v); }
+    static inline F8 abs(F8 a)                { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    static inline F8 sqrt(F8 a)               { return _mm256_sqrt_ps(a.v); }
+    static inline F8 select(M8 m, F8 a, F8 b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+    static inline F8 load(const float* data)  { return _mm256_loadu_ps(data); }
+
+    static inline M8 operator<(F8 a, F8 b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+    static inline M8 operator>(F8 a, F8 b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+    static inline M8 operator<=(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    static inline M8 operator>=(F8 a, F8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+    static inline M8 operator&(M8 a, M8 b)  { return { _mm256_and_ps(a.v, b.v) }; }
+    static inline M8 operator|(M8 a, M8 b)  { return { _mm256_or_ps(a.v, b.v) }; }
+    static inline M8 operator!(M8 a)        { return { _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) }; }
+
+    static inline M8 maskFromBits(uint32_t bits) {
+        __m256i lanes = _mm256_and_si256(_mm256_set1_epi32(int(bits)), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128));
+        return { _mm256_castsi256_ps(_mm256_cmpgt_epi32(lanes, _mm256_setzero_si256())) };
+    }
+
+    static inline void store(float* data, F8 a) { _mm256_storeu_ps(data, a.v); }
+    static inline bool any(M8 m)                { return _mm256_movemask_ps(m.v) != 0; }
+
+    #include <cpu/PacketKernels.inl>
+}
+
+const PacketKernels* getAvx2PacketKernels() {
+    static const PacketKernels kernels = {
+        "avx2", &packet_avx2::sdModelPacket, &packet_avx2::rayMarchModelPacket, &packet_avx2::shadowMarchModelPacket
+    };
+    return &kernels;
+}
+
+#else
+
+const PacketKernels* getAvx2PacketKernels() {
+    return nullptr;
+}
+
+#endif
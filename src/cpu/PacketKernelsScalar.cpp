@@ -0,0 +1,66 @@
+
+#include <cpu/PacketKernels.h>
+#include <cpu/SdfConstants.h>
+
+#include <cmath>
+
+/**
+ * Portable variant written as plain per-lane loops which compilers vectorize for the baseline instruction set (e.g. SSE2 on x86-64).
+ */
+namespace packet_scalar {
+
+    struct F8 {
+        float v[PACKET_SIZE];
+        F8() = default;
+        F8(float s) { for (int i = 0; i < PACKET_SIZE; ++i) v[i] = s; }
+    };
+
+    struct M8 {
+        bool v[PACKET_SIZE];
+    };
+
+    #define LANE_WISE(init) { F8 r; for (int i = 0; i < PACKET_SIZE; ++i) r.v[i] = (init); return r; }
+    #define LANE_WISE_MASK(init) { M8 r; for (int i = 0; i < PACKET_SIZE; ++i) r.v[i] = (init); return r; }
+
+    static inline F8 operator+(F8 a, F8 b) LANE_WISE(a.v[i] + b.v[i])
+    static inline F8 operator-(F8 a, F8 b) LANE_WISE(a.v[i] - b.v[i])
+    static inline F8 operator*(F8 a, F8 b) LANE_WISE(a.v[i] * b.v[i])
+    static inline F8 operator/(F8 a, F8 b) LANE_WISE(a.v[i] / b.v[i])
+    static inline F8 operator-(F8 a)       LANE_WISE(-a.v[i])
+
+    static inline F8 min(F8 a, F8 b)              LANE_WISE(b.v[i] < a.v[i] ? b.v[i] : a.v[i])
+    static inline F8 max(F8 a, F8 b)              LANE_WISE(a.v[i] < b.v[i] ? b.v[i] : a.v[i])
+    static inline F8 abs(F8 a)                    LANE_WISE(std::fabs(a.v[i]))
+    static inline F8 sqrt(F8 a)                   LANE_WISE(std::sqrt(a.v[i]))
+    static inline F8 select(M8 m, F8 a, F8 b)     LANE_WISE(m.v[i] ? a.v[i] : b.v[i])
+    static inline F8 load(const float* data)      LANE_WISE(data[i])
+
+    static inline M8 operator<(F8 a, F8 b)        LANE_WISE_MASK(a.v[i] <  b.v[i])
+    static inline M8 operator>(F8 a, F8 b)        LANE_WISE_MASK(a.v[i] >  b.v[i])
+    static inline M8 operator<=(F8 a, F8 b)       LANE_WISE_MASK(a.v[i] <= b.v[i])
+    static inline M8 operator>=(F8 a, F8 b)       LANE_WISE_MASK(a.v[i] >= b.v[i])
+    static inline M8 operator&(M8 a, M8 b)        LANE_WISE_MASK(a.v[i] && b.v[i])
+    static inline M8 operator|(M8 a, M8 b)        LANE_WISE_MASK(a.v[i] || b.v[i])
+    static inline M8 operator!(M8 a)              LANE_WISE_MASK(!a.v[i])
+    static inline M8 maskFromBits(uint32_t bits)  LANE_WISE_MASK(((bits >> i) & 1) != 0)
+
+    static inline void store(float* data, F8 a) { for (int i = 0; i < PACKET_SIZE; ++i) data[i] = a.v[i]; }
+
+    static inline bool any(M8 m) {
+        bool result = false;
+        for (int i = 0; i < PACKET_SIZE; ++i) result |= m.v[i];
+        return result;
+    }
+
+    #undef LANE_WISE
+    #undef LANE_WISE_MASK
+
+    #include <cpu/PacketKernels.inl>
+}
+
+const PacketKernels* getScalarPacketKernels() {
+    static const PacketKernels kernels = {
+        "scalar", &packet_scalar::sdModelPacket, &packet_scalar::rayMarchModelPacket, &packet_scalar::shadowMarchModelPacket
+    };
+    return &kernels;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+/**
+ * Scalar C++ port of resources/shaders/primitive_sdf.fs.
+ * Functions are kept 1:1 with their GLSL counterparts so that the CPU renderer can serve as a reference.
+ */
+
+#include <cpu/SdfConstants.h>
+#include <sceneUtils.h>
+
+#include <glm/glm.hpp>
+
+#define SDF_TRANSFORM_POS(pos, obj) transformPosition((obj).transform, TransformKind((obj).transformKind), (pos))
+
+// see https://iquilezles.org/www/articles/distfunctions/distfunctions.htm
+
+inline float smoothMin(float dist1, float dist2, float koeficient) {
+    if (koeficient <= 0.0f) { // GLSL version evaluates to hard min through division by zero
+        return glm::min(dist1, dist2);
+    }
+    float h = glm::clamp(0.5f + 0.5f * (dist1 - dist2) / koeficient, 0.0f, 1.0f);
+    return glm::mix(dist1, dist2, h) - koeficient * h * (1.0f - h);
+}
+
+inline float smoothMax(float dist1, float dist2, float koeficient) {
+    if (koeficient <= 0.0f) {
+        return glm::max(dist1, dist2);
+    }
+    float h = glm::clamp(0.5f - 0.5f * (dist1 - dist2) / koeficient, 0.0f, 1.0f);
+    return glm::mix(dist1, dist2, h) + koeficient * h * (1.0f - h);
+}
+
+// primitive SD functions, position is in space of the primitive for overloads taking only its data
+
+inline float sdSphere(glm::vec3 p, glm::vec4 data) {
+    return glm::length(p) - data.x;
+}
+
+inline float sdCapsule(glm::vec3 p, glm::vec4 data) {
+    glm::vec3 a  = glm::vec3(0.0f,  0.5f, 0.0f) * data.y;
+    glm::vec3 b  = glm::vec3(0.0f, -0.5f, 0.0f) * data.y;
+    glm::vec3 ab = b - a;
+    glm::vec3 ap = p - a;
+    float t = glm::clamp(glm::dot(ab, ap) / glm::dot(ab, ab), 0.0f, 1.0f);
+    return glm::length(ap - ab * t) - data.x;
+}
+
+inline float sdTorus(glm::vec3 p, glm::vec4 data) {
+    float x = glm::length(glm::vec2(p.x, p.z)) - data.x;
+    return glm::length(glm::vec2(x, p.y)) - data.y;
+}
+
+inline float sdBox(glm::vec3 p, glm::vec4 data) {
+    glm::vec3 d = glm::abs(p) - glm::vec3(data) + glm::vec3(data.w);
+    float     e = glm::length(glm::max(d, 0.0f));                  // exterior distance
+    float     i = glm::min(glm::max(d.x, glm::max(d.y, d.z)), 0.0f); // interior distance
+    return e + i - data.w;
+}
+
+inline float sdCilinder(glm::vec3 p, glm::vec4 data) {
+    float     w = data.x - data.z;
+    float     h = data.y - data.z;
+    glm::vec2 d = glm::abs(glm::vec2(glm::length(glm::vec2(p.x, p.z)), p.y)) - glm::vec2(w, h);
+    return glm::min(glm::max(d.x, d.y), 0.0f) + glm::length(glm::max(d, 0.0f)) - data.z;
+}
+
+inline float sdCone(glm::vec3 p, glm::vec4 data) {
+    float r1 = data.x - data.w;
+    float r2 = data.y - data.w;
+    float h  = data.z - data.w;
+
+    glm::vec2 q  = glm::vec2(glm::length(glm::vec2(p.x, p.z)), p.y);
+    glm::vec2 k1 = glm::vec2(r2, h);
+    glm::vec2 k2 = glm::vec2(r2 - r1, 2.0f * h);
+    glm::vec2 ca = glm::vec2(q.x - glm::min(q.x, (q.y < 0.0f) ? r1 : r2), glm::abs(q.y) - h);
+    glm::vec2 cb = q - k1 + k2 * glm::clamp(glm::dot(k1 - q, k2) / glm::dot(k2, k2), 0.0f, 1.0f);
+    float     s  = (cb.x < 0.0f && ca.y < 0.0f) ? -1.0f : 1.0f;
+    return s * glm::sqrt(glm::min(glm::dot(ca, ca), glm::dot(cb, cb))) - data.w;
+}
+
+inline float roundCone(glm::vec3 p, glm::vec4 data) {
+    float r1 = data.x;
+    float r2 = data.y;
+    float h  = data.z;
+    p.y += h * 0.5f;
+
+    glm::vec2 q = glm::vec2(glm::length(glm::vec2(p.x, p.z)), p.y);
+
+    float b = (r1 - r2) / h;
+    float a = glm::sqrt(1.0f - b * b);
+    float k = glm::dot(q, glm::vec2(-b, a));
+
+    if (k < 0.0f)  return glm::length(q) - r1;
+    if (k > a * h) return glm::length(q - glm::vec2(0.0f, h)) - r2;
+
+    return glm::dot(q, glm::vec2(a, b)) - r1;
+}
+
+inline float sdSphere(glm::vec3 position, const ShaderPrimitive& sphere)     { return sdSphere(SDF_TRANSFORM_POS(position, sphere), sphere.data); }
+inline float sdCapsule(glm::vec3 position, const ShaderPrimitive& capsule)   { return sdCapsule(SDF_TRANSFORM_POS(position, capsule), capsule.data); }
+inline float sdTorus(glm::vec3 position, const ShaderPrimitive& torus)       { return sdTorus(SDF_TRANSFORM_POS(position, torus), torus.data); }
+inline float sdBox(glm::vec3 position, const ShaderPrimitive& box)           { return sdBox(SDF_TRANSFORM_POS(position, box), box.data); }
+inline float sdCilinder(glm::vec3 position, const ShaderPrimitive& cilinder) { return sdCilinder(SDF_TRANSFORM_POS(position, cilinder), cilinder.data); }
+inline float sdCone(glm::vec3 position, const ShaderPrimitive& cone)         { return sdCone(SDF_TRANSFORM_POS(position, cone), cone.data); }
+inline float roundCone(glm::vec3 position, const ShaderPrimitive& cone)      { return roundCone(SDF_TRANSFORM_POS(position, cone), cone.data); }
+
+inline float sdPrimitive(glm::vec3 position, const ShaderPrimitive& primitive) {
+    switch (primitive.type) {
+        case PrimitiveType::ptSphere:    return sdSphere(position, primitive);
+        case PrimitiveType::ptCapsule:   return sdCapsule(position, primitive);
+        case PrimitiveType::ptTorus:     return sdTorus(position, primitive);
+        case PrimitiveType::ptBox:       return sdBox(position, primitive);
+        case PrimitiveType::ptCilinder:  return sdCilinder(position, primitive);
+        case PrimitiveType::ptCone:      return sdCone(position, primitive);
+        case PrimitiveType::ptRoundCone: return roundCone(position, primitive);
+    }
+    return SDF_MAX_DISTANCE;
+}
+
+// distance to box, exact outside of it
+inline float sdBound(glm::vec3 position, glm::vec3 boundMin, glm::vec3 boundMax) {
+    glm::vec3 d = glm::max(boundMin - position, position - boundMax);
+    return glm::length(glm::max(d, 0.0f)) + glm::min(glm::max(d.x, glm::max(d.y, d.z)), 0.0f);
+}
+
+// trilinear interpolation of baked samples lowered by the interpolation error, negative outside of the volume
+inline float sdVolume(glm::vec3 position, const ShaderModel& model, const SdfVolumeAtlas& volumes) {
+    uint32_t  resolution = volumes.resolution;
+    float     last       = float(resolution - 1);
+    glm::vec3 volumeMin  = model.boundMin - SDF_VOLUME_MARGIN;
+    glm::vec3 volumeSize = model.boundMax - model.boundMin + 2.0f * SDF_VOLUME_MARGIN;
+    glm::vec3 texel      = (position - volumeMin) / volumeSize * last;
+    if (glm::any(glm::lessThan(texel, glm::vec3(0.0f))) || glm::any(glm::greaterThan(texel, glm::vec3(last)))) {
+        return -1.0f;
+    }
+
+    auto   cell  = glm::min(glm::uvec3(texel), glm::uvec3(resolution - 2));
+    auto   f     = texel - glm::vec3(cell);
+    size_t dy    = resolution;
+    size_t dz    = size_t(resolution) * resolution;
+    auto   s     = volumes.distances.data() + (size_t(model.volumeId) * resolution + cell.z) * dz + cell.y * dy + cell.x;
+    float  d00   = glm::mix(s[0],       s[1],           f.x);
+    float  d10   = glm::mix(s[dy],      s[dy + 1],      f.x);
+    float  d01   = glm::mix(s[dz],      s[dz + 1],      f.x);
+    float  d11   = glm::mix(s[dz + dy], s[dz + dy + 1], f.x);
+    float  value = glm::mix(glm::mix(d00, d10, f.y), glm::mix(d01, d11, f.y), f.z);
+
+    // for 1-Lipschitz SDF the interpolation error is at most half of the cell diagonal
+    return value - 0.5f * glm::length(volumeSize) / last;
+}
+
+/**
+ * First part of sdModel, true when the distance is given by the bound or the baked volume of the model.
+ * Otherwise p is the position in geometry space where primitives of the model have to be evaluated.
+ */
+inline bool sdModelBound(glm::vec3 position, const ShaderModel& model, const SdfVolumeAtlas* volumes, glm::vec3& p, float& distance) {
+    p = SDF_TRANSFORM_POS(position, model) / model.scale;
+
+    // far from the model its bound is a conservative distance
+    float boundDist = sdBound(p, model.boundMin, model.boundMax) * model.scale;
+    if (boundDist > SDF_MODEL_BOUND_DISTANCE) {
+        distance = boundDist;
+        return true;
+    }
+
+    // baked volume replaces the primitives except near the surface where exact hits are needed
+    if (volumes != nullptr && model.volumeId >= 0) {
+        float bakedDist = sdVolume(p, model, *volumes) * model.scale;
+        if (bakedDist > SDF_VOLUME_ANALYTIC) {
+            distance = bakedDist;
+            return true;
+        }
+    }
+    return false;
+}
+
+// interpreter of primitives of the model geometry, p is in geometry space
+inline float sdPrimitives(glm::vec3 p, const ShaderModel& model, const ShaderPrimitive* primitives) {
+    float finalDist = SDF_MAX_DISTANCE;
+    for (uint32_t i = 0; i < model.primitiveCount; ++i) {
+        const auto& primitive = primitives[i + model.geometryId];
+        float blending        = primitive.blending * model.scale;
+
+        // primitive distance is at least distance to its bounding sphere, skipped when blending would keep finalDist as it is
+        float lowerBound = (glm::length(p - glm::vec3(primitive.bound)) - primitive.bound.w) * model.scale;
+        if (primitive.operation == PrimitiveOperation::Add && lowerBound >= finalDist + blending) {
+            continue;
+        }
+        if (primitive.operation == PrimitiveOperation::Substract && lowerBound >= blending - finalDist) {
+            continue;
+        }
+
+        float distToPrimitive = sdPrimitive(p, primitive) * model.scale;
+
+        switch (primitive.operation) {
+            case PrimitiveOperation::Add:       finalDist = smoothMin(distToPrimitive, finalDist, blending); break;
+            case PrimitiveOperation::Substract: finalDist = smoothMax(-distToPrimitive, finalDist, blending); break;
+            case PrimitiveOperation::Intersect: finalDist = smoothMax(distToPrimitive, finalDist, blending); break;
+        }
+    }
+
+    return finalDist;
+}
+
+inline float sdModel(glm::vec3 position, const ShaderModel& model, const ShaderPrimitive* primitives, const SdfVolumeAtlas* volumes = nullptr) {
+    glm::vec3 p;
+    float     distance;
+    if (sdModelBound(position, model, volumes, p, distance)) {
+        return distance;
+    }
+    return sdPrimitives(p, model, primitives);
+}
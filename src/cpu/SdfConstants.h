@@ -0,0 +1,11 @@
+#pragma once
+
+/**
+ * Constants of resources/shaders/primitive_sdf.fs. Kept apart from Sdf.h, packet kernels need them
+ * but must not include inline SDF code shared with other translation units (see PacketKernelsAvx2.cpp).
+ */
+
+#define SDF_MAX_DISTANCE         100.0f // MAX_DISTANCE of primitive_sdf.fs
+#define SDF_MODEL_BOUND_DISTANCE 1.0f   // MODEL_BOUND_DISTANCE of primitive_sdf.fs
+#define SDF_VOLUME_MARGIN        0.25f  // VOLUME_MARGIN of primitive_sdf.fs
+#define SDF_VOLUME_ANALYTIC      0.1f   // VOLUME_ANALYTIC_DISTANCE of primitive_sdf.fs
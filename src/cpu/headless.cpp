@@ -0,0 +1,492 @@
+
+#include <cpu/headless.h>
+#include <cpu/CpuRenderer.h>
+#include <sceneUtils.h>
+#include <CommandLine.h>
+#include <DynamicScene.h>
+#include <CompiledScene.h>
+#include <SdfVolume.h>
+#include <RayCamera.h>
+#include <chess/Pgn.h>
+#include <chess/ChessScene.h>
+
+#include <RenderBase/tools/camera.h>
+
+#include <iostream>
+#include <string>
+#include <cstring>
+
+using namespace std;
+
+struct HeadlessOptions {
+    string   output  = "render.png";
+    string   scene   = RESOURCE_SCENE_JSON;
+    uint32_t width   = 1280;
+    uint32_t height  = 720;
+    uint32_t threads = 0;
+    size_t   models  = 0; // replicate scene models to this count when set
+    uint32_t bakeSdf = 0; // resolution of baked SDF volumes, 0 disables baking
+    bool     depthPrepass = false;
+    float    penumbra     = 0;     // hard shadows by default
+    bool     genericSdf   = false; // sdPrimitives interpreter instead of GeometrySdf on the per ray path
+
+    string compileScene  = ""; // output file of scene compilation
+    string pixelCounters = ""; // prefix of heatmaps and histograms of per pixel work, empty disables counting
+
+    string fen = "";  // position placed on the board instead of the scene pieces
+    string pgn = "";  // game whose positions are rendered one after another
+    int    ply = -1;  // only this position of the game when set, 0 is the initial one
+
+    PacketKernelType kernels = PacketKernelType::pkAuto;
+
+    bool   scalingBenchmark = false;
+    size_t updateBenchmark  = 0; // number of model moves
+    bool   sdfBenchmark     = false;
+    bool   prepassBenchmark = false;
+};
+
+// false on unknown argument or malformed value
+static bool parseOptions(int argc, char* argv[], HeadlessOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--headless") {
+            continue;
+        }
+        if (arg == "--scaling-benchmark") {
+            options.scalingBenchmark = true;
+            continue;
+        }
+        if (arg == "--sdf-benchmark") {
+            options.sdfBenchmark = true;
+            continue;
+        }
+        if (arg == "--depth-prepass") {
+            options.depthPrepass = true;
+            continue;
+        }
+        if (arg == "--generic-sdf") {
+            options.genericSdf = true;
+            continue;
+        }
+        if (arg == "--prepass-benchmark") {
+            options.prepassBenchmark = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for argument " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        bool parsed = parseArgumentValue(arg, value, [&]() {
+            if      (arg == "--output")  options.output  = value;
+            else if (arg == "--scene")   options.scene   = value;
+            else if (arg == "--width")   options.width   = toUnsigned(value);
+            else if (arg == "--height")  options.height  = toUnsigned(value);
+            else if (arg == "--threads") options.threads = toUnsigned(value);
+            else if (arg == "--simd")    options.kernels = packetKernelTypeFromString(value);
+            else if (arg == "--models")  options.models  = toUnsigned(value);
+            else if (arg == "--bake-sdf") options.bakeSdf = toUnsigned(value);
+            else if (arg == "--penumbra") options.penumbra = stof(value);
+            else if (arg == "--update-benchmark") options.updateBenchmark = toUnsigned(value);
+            else if (arg == "--compile-scene")    options.compileScene    = value;
+            else if (arg == "--pixel-counters")   options.pixelCounters   = value;
+            else if (arg == "--fen")     options.fen     = value;
+            else if (arg == "--pgn")     options.pgn     = value;
+            else if (arg == "--ply")     options.ply     = stoi(value);
+            else {
+                cerr << "Unknown argument " << arg << endl;
+                return false;
+            }
+            return true;
+        });
+        if (!parsed) {
+            return false;
+        }
+    }
+    return options.width > 0 && options.height > 0;
+}
+
+bool isHeadlessRun(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// same default camera as the windowed application
+static RayCamera defaultCamera(const HeadlessOptions& options) {
+    auto cam = make_shared<rb::Camera>(glm::vec3(0, 1, 0));
+    cam->setFov(glm::radians(60.0f));
+    cam->setAspectRatio(float(options.width) / float(options.height));
+    cam->setPosition(glm::vec3(0, 10, -10));
+    cam->setTargetPosition(glm::vec3(0, 0, 0));
+    return RayCamera::fromCamera(cam);
+}
+
+template<typename T>
+static size_t byteSize(const vector<T>& data) {
+    return data.size() * sizeof(T);
+}
+
+/**
+ * Renders scene replicated to 50, 500 and 5000 models, camera stays on the first board so that
+ * the growth of the cost comes from BVH traversal and rays passing over distant boards.
+ */
+static int runScalingBenchmark(const HeadlessOptions& options) {
+    cout << "models, primitives, bvh nodes, buffers [B], prepare [ms], bvh build [ms], SAH cost, render [ms], Mrays/s\n";
+    for (size_t models : { 50, 500, 5000 }) {
+        auto scene = buildSceneFromJson(options.scene);
+        replicateModels(*scene, models);
+
+        auto start     = chrono::steady_clock::now();
+        auto sceneData = prepareShaderSceneData(*scene);
+        auto prepare   = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+
+        auto bvhReport = sceneData.bvhReport;
+        auto buffers   = byteSize(sceneData.primitives) + byteSize(sceneData.materials) + byteSize(sceneData.models) + byteSize(sceneData.bvh);
+        auto primitives = sceneData.primitives.size();
+        auto nodes      = sceneData.bvh.size();
+
+        auto renderer = CpuRenderer(move(sceneData), options.kernels);
+        auto image    = Image(options.width, options.height);
+        auto report   = renderer.render(defaultCamera(options), image, options.threads);
+
+        cout << models << ", " << primitives << ", " << nodes << ", " << buffers << ", "
+             << prepare.count() / 1000.0 << ", " << bvhReport.buildTime.count() / 1000.0 << ", " << bvhReport.sahCost << ", "
+             << report.duration.count() / 1000.0 << ", " << report.raysPerSecond() / 1e6 << "\n";
+    }
+    return 0;
+}
+
+/**
+ * Moves models one by one as in a live game and compares cost of incremental update with full scene preparation,
+ * in the end the render of incrementally updated data is compared to the render of freshly prepared data.
+ */
+static int runUpdateBenchmark(const HeadlessOptions& options) {
+    auto jsonScene = buildSceneFromJson(options.scene);
+    if (options.models > 0) {
+        replicateModels(*jsonScene, options.models);
+    }
+    auto scene = DynamicScene(move(jsonScene));
+    if (scene.getScene().models.empty()) {
+        cerr << "Scene has no models" << endl;
+        return 1;
+    }
+
+    size_t modelCount   = scene.getScene().models.size();
+    size_t changedNodes = 0;
+    size_t uploadBytes  = 0;
+    auto   updateTime   = chrono::nanoseconds(0);
+    for (size_t step = 0; step < options.updateBenchmark; ++step) {
+        uint32_t modelId   = uint32_t(step * 7919 % modelCount);
+        auto     transform = scene.getScene().models[modelId].transform;
+        transform.translate(glm::vec3(step % 2 == 0 ? 0.5f : -0.25f, 0.0f, 0.25f));
+
+        auto start  = chrono::steady_clock::now();
+        scene.moveModel(modelId, transform);
+        auto update = scene.update();
+        updateTime += chrono::steady_clock::now() - start;
+
+        for (const auto& range : update.models) {
+            uploadBytes += range.count * sizeof(ShaderModel);
+        }
+        for (const auto& range : update.bvh) {
+            uploadBytes  += range.count * sizeof(BVHNode);
+            changedNodes += range.count;
+        }
+    }
+
+    auto start    = chrono::steady_clock::now();
+    auto fullData = prepareShaderSceneData(scene.getScene());
+    auto fullTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    size_t fullBytes = fullData.models.size() * sizeof(ShaderModel) + fullData.bvh.size() * sizeof(BVHNode);
+
+    double moves = double(glm::max(options.updateBenchmark, size_t(1)));
+    cout << modelCount << " models, " << options.updateBenchmark << " moves\n";
+    cout << "Incremental update: " << chrono::duration<double, micro>(updateTime).count() / moves << " us per move, "
+         << changedNodes / moves << " BVH nodes and " << uploadBytes / moves << " bytes uploaded per move\n";
+    cout << "Full preparation:   " << fullTime.count() << " us, " << fullBytes << " bytes of models and BVH\n";
+
+    auto camera      = defaultCamera(options);
+    auto incremental = Image(options.width, options.height);
+    auto full        = Image(options.width, options.height);
+    CpuRenderer(scene.getData(), options.kernels).render(camera, incremental, options.threads);
+    CpuRenderer(move(fullData), options.kernels).render(camera, full, options.threads);
+
+    bool same = incremental.pixels == full.pixels;
+    cout << "Render of updated scene " << (same ? "matches" : "DIFFERS FROM") << " render of prepared scene\n";
+    return same ? 0 : 1;
+}
+
+/**
+ * Compares marching of analytic SDF with baked volumes, bake is timed without cache, with cold cache and with warm cache.
+ * Baked distances are lowered by interpolation error so rays need more steps in some places, pixels which differ are counted.
+ */
+static int runSdfBenchmark(const HeadlessOptions& options) {
+    auto scene = buildSceneFromJson(options.scene);
+    if (options.models > 0) {
+        replicateModels(*scene, options.models);
+    }
+    auto analytic = prepareShaderSceneData(*scene);
+    auto baked    = analytic;
+
+    auto volumeOptions       = SdfVolumeOptions();
+    volumeOptions.resolution = options.bakeSdf > 0 ? options.bakeSdf : volumeOptions.resolution;
+    volumeOptions.threads    = options.threads;
+    auto cacheDirectory      = volumeOptions.cacheDirectory;
+
+    volumeOptions.cacheDirectory = "";
+    cout << "Without cache: " << bakeSdfVolumes(baked, volumeOptions) << "\n";
+    volumeOptions.cacheDirectory = cacheDirectory;
+    cout << "Cold cache:    " << bakeSdfVolumes(baked, volumeOptions) << "\n";
+    cout << "Warm cache:    " << bakeSdfVolumes(baked, volumeOptions) << "\n";
+
+    auto camera         = defaultCamera(options);
+    auto analyticImage  = Image(options.width, options.height);
+    auto bakedImage     = Image(options.width, options.height);
+    auto analyticReport = CpuRenderer(move(analytic), options.kernels).render(camera, analyticImage, options.threads);
+    auto bakedReport    = CpuRenderer(move(baked), options.kernels).render(camera, bakedImage, options.threads);
+
+    size_t differentPixels = 0;
+    for (size_t i = 0; i < analyticImage.pixels.size(); i += 3) {
+        for (size_t c = i; c < i + 3; ++c) {
+            if (abs(int(analyticImage.pixels[c]) - int(bakedImage.pixels[c])) > 2) {
+                ++differentPixels;
+                break;
+            }
+        }
+    }
+
+    cout << "Analytic render: " << analyticReport.duration.count() / 1000.0 << " ms\n";
+    cout << "Baked render:    " << bakedReport.duration.count() / 1000.0 << " ms, "
+         << differentPixels << " of " << options.width * options.height << " pixels differ\n";
+    return 0;
+}
+
+/**
+ * Renders the scene with and without the depth prepass and compares average steps per pixel of primary rays and cone marching.
+ * Rays seeded by the prepass march from a different start, so pixels at silhouettes may differ slightly.
+ */
+static int runPrepassBenchmark(const HeadlessOptions& options, ShaderSceneData sceneData) {
+    auto renderer = CpuRenderer(move(sceneData), options.kernels);
+    auto camera   = defaultCamera(options);
+
+    auto baseImage  = Image(options.width, options.height);
+    auto baseReport = renderer.render(camera, baseImage, options.threads);
+
+    renderer.depthPrepass = true;
+    auto prepassImage  = Image(options.width, options.height);
+    auto prepassReport = renderer.render(camera, prepassImage, options.threads);
+
+    size_t differentPixels = 0;
+    for (size_t i = 0; i < baseImage.pixels.size(); i += 3) {
+        for (size_t c = i; c < i + 3; ++c) {
+            if (abs(int(baseImage.pixels[c]) - int(prepassImage.pixels[c])) > 2) {
+                ++differentPixels;
+                break;
+            }
+        }
+    }
+
+    double pixels = double(options.width) * options.height;
+    cout << "Without prepass: " << baseReport.duration.count() / 1000.0 << " ms, "
+         << baseReport.stepsPerPixel() << " steps per pixel\n";
+    cout << "With prepass:    " << prepassReport.duration.count() / 1000.0 << " ms, "
+         << prepassReport.stepsPerPixel() << " steps per pixel (" << prepassReport.primarySteps / pixels << " primary, "
+         << prepassReport.prepassSteps / pixels << " prepass), "
+         << differentPixels << " of " << options.width * options.height << " pixels differ\n";
+    cout << "Steps per pixel reduced by " << (1.0 - prepassReport.stepsPerPixel() / glm::max(baseReport.stepsPerPixel(), 1e-9)) * 100.0 << " %\n";
+    return 0;
+}
+
+// json scene is parsed and prepared, compiled scene is only mapped and copied
+static bool loadSceneData(const HeadlessOptions& options, ShaderSceneData& sceneData) {
+    if (isCompiledSceneFile(options.scene)) {
+        auto compiled = CompiledScene(options.scene);
+        if (!compiled.isValid()) {
+            cerr << compiled.getErrorMessage() << endl;
+            return false;
+        }
+        sceneData = compiled.toShaderSceneData();
+        return true;
+    }
+
+    auto scene = buildSceneFromJson(options.scene);
+    if (options.models > 0) {
+        replicateModels(*scene, options.models);
+    }
+    sceneData = prepareShaderSceneData(*scene);
+    if (options.bakeSdf > 0) {
+        auto volumeOptions       = SdfVolumeOptions();
+        volumeOptions.resolution = options.bakeSdf;
+        volumeOptions.threads    = options.threads;
+        cout << bakeSdfVolumes(sceneData, volumeOptions) << "\n";
+    }
+    return true;
+}
+
+// render.png becomes render_012.png for position 12
+static string numberedOutput(const string& output, size_t index) {
+    auto dot    = output.find_last_of('.');
+    auto number = to_string(index);
+    number      = string(number.size() < 3 ? 3 - number.size() : 0, '0') + number;
+    return dot == string::npos ? output + "_" + number : output.substr(0, dot) + "_" + number + output.substr(dot);
+}
+
+/**
+ * Renders a FEN position or positions of a PGN game. The scene is loaded once, every position only replaces piece
+ * models and refits the BVH, primitives, materials and geometry SDF stay as they are.
+ */
+static int renderChessPositions(const HeadlessOptions& options) {
+    if (isCompiledSceneFile(options.scene)) {
+        cerr << "Chess positions need a json scene, models of a compiled scene cannot be replaced" << endl;
+        return 1;
+    }
+
+    auto positions = vector<ChessPosition>(1);
+    auto error     = string();
+    if (!options.pgn.empty()) {
+        auto game = PgnGame();
+        if (!loadPgn(options.pgn, game, error)) {
+            cerr << "Error while reading game " << options.pgn << ": " << error << endl;
+            return 1;
+        }
+        positions = game.positions;
+    } else if (!positions[0].setFen(options.fen, error)) {
+        cerr << "Error while reading FEN: " << error << endl;
+        return 1;
+    }
+    if (options.ply >= 0) {
+        if (size_t(options.ply) >= positions.size()) {
+            cerr << "Game has only " << positions.size() << " positions" << endl;
+            return 1;
+        }
+        positions = { positions[options.ply] };
+    }
+
+    auto scene = DynamicScene(buildSceneFromJson(options.scene));
+    if (options.bakeSdf > 0) {
+        auto volumeOptions       = SdfVolumeOptions();
+        volumeOptions.resolution = options.bakeSdf;
+        volumeOptions.threads    = options.threads;
+        cout << scene.bakeVolumes(volumeOptions) << "\n";
+    }
+    auto board    = boardModels(scene.getScene());
+    auto renderer = CpuRenderer(scene.getData(), options.kernels);
+    renderer.depthPrepass   = options.depthPrepass;
+    renderer.penumbraFactor = options.penumbra;
+    renderer.specializedSdf = !options.genericSdf;
+
+    auto camera = defaultCamera(options);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        auto start = chrono::steady_clock::now();
+        scene.setModels(positionModels(positions[i], board));
+        if (scene.hasChanges()) {
+            scene.update();
+            renderer.updateModels(scene.getData());
+        }
+        auto updateTime = chrono::duration<double, micro>(chrono::steady_clock::now() - start);
+
+        auto image  = Image(options.width, options.height);
+        auto report = renderer.render(camera, image, options.threads);
+        auto output = positions.size() > 1 ? numberedOutput(options.output, i) : options.output;
+        cout << output << ": " << positions[i].getFen() << ", models updated in " << updateTime.count() << " us, "
+             << "rendered in " << report.duration.count() / 1000.0 << " ms\n";
+        if (!image.write(output)) {
+            cerr << "Error while writing image " << output << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compileScene(const HeadlessOptions& options) {
+    auto start = chrono::steady_clock::now();
+    auto sceneData = ShaderSceneData();
+    if (!loadSceneData(options, sceneData)) {
+        return 1;
+    }
+    auto prepared = chrono::steady_clock::now();
+    if (!writeCompiledScene(options.compileScene, sceneData)) {
+        cerr << "Error while writing compiled scene " << options.compileScene << endl;
+        return 1;
+    }
+    auto written = chrono::steady_clock::now();
+
+    auto compiled = CompiledScene(options.compileScene);
+    auto mapped   = chrono::steady_clock::now();
+
+    cout << sceneData.bvhReport << "\n";
+    cout << "Scene parsed and prepared in " << chrono::duration<double, milli>(prepared - start).count() << " ms, "
+         << "written in " << chrono::duration<double, milli>(written - prepared).count() << " ms, "
+         << "mapped in " << chrono::duration<double, milli>(mapped - written).count() << " ms\n";
+    return compiled.isValid() ? 0 : 1;
+}
+
+int runHeadless(int argc, char* argv[]) {
+    auto options = HeadlessOptions();
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    if (options.scalingBenchmark) {
+        return runScalingBenchmark(options);
+    }
+    if (options.updateBenchmark > 0) {
+        return runUpdateBenchmark(options);
+    }
+    if (options.sdfBenchmark) {
+        return runSdfBenchmark(options);
+    }
+    if (!options.compileScene.empty()) {
+        return compileScene(options);
+    }
+    if (!options.fen.empty() || !options.pgn.empty()) {
+        return renderChessPositions(options);
+    }
+
+    auto start     = chrono::steady_clock::now();
+    auto sceneData = ShaderSceneData();
+    if (!loadSceneData(options, sceneData)) {
+        return 1;
+    }
+    auto loadTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start);
+    cout << sceneData.bvhReport << "\n";
+    cout << "Scene loaded in " << loadTime.count() << " ms\n";
+
+    if (options.prepassBenchmark) {
+        return runPrepassBenchmark(options, move(sceneData));
+    }
+
+    auto renderer = CpuRenderer(move(sceneData), options.kernels);
+    renderer.depthPrepass   = options.depthPrepass;
+    renderer.penumbraFactor = options.penumbra;
+    renderer.specializedSdf = !options.genericSdf;
+    auto image    = Image(options.width, options.height);
+    auto counters = PixelCounters();
+    auto report   = renderer.render(defaultCamera(options), image, options.threads, options.pixelCounters.empty() ? nullptr : &counters);
+
+    cout << "Rendered " << options.width << "x" << options.height
+         << " in " << report.duration.count() / 1000.0 << " ms"
+         << " using " << report.threads << " threads (" << report.tiles << " tiles, " << renderer.getKernelName() << " kernels), "
+         << report.raysPerSecond() / 1e6 << " Mrays/s\n";
+    cout << report << "\n";
+
+    if (!options.pixelCounters.empty()) {
+        for (uint32_t i = 0; i < PIXEL_COUNTER_COUNT; ++i) {
+            cout << computeHistogram(counters, PixelCounter(i)) << "\n";
+        }
+        if (!writePixelCounters(counters, options.pixelCounters)) {
+            cerr << "Error while writing pixel counters " << options.pixelCounters << endl;
+            return 1;
+        }
+    }
+
+    if (!image.write(options.output)) {
+        cerr << "Error while writing image " << options.output << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// true when program was started with --headless argument
+bool isHeadlessRun(int argc, char* argv[]);
+
+/**
+ * Renders scene on CPU without creating any window or GL context and writes result into an image file.
+ *
+ * Usage: PRGChess --headless [--output file.png|file.ppm] [--width W] [--height H] [--threads N] [--simd auto|avx2|scalar|off]
+ *                        [--scene scene.json|scene.prgscene] [--models N] [--scaling-benchmark] [--update-benchmark MOVES]
+ *                        [--depth-prepass] [--prepass-benchmark] [--penumbra K] [--pixel-counters PREFIX]
+ *                        [--bake-sdf N] [--sdf-benchmark] [--generic-sdf] [--compile-scene out.prgscene]
+ *                        [--fen FEN] [--pgn game.pgn [--ply N]]
+ *
+ * With --pixel-counters heatmaps and histograms of steps, SDF evaluations, node visits and secondary rays of every pixel
+ * are written to PREFIX_<counter>.png and PREFIX_counters.json.
+ * With --fen the position is placed on the board of the scene, with --pgn every position of the game is rendered
+ * to the output numbered by ply (render_000.png is the initial position), --ply renders a single one.
+ * With --bake-sdf geometries are baked into SDF volumes of resolution N, --sdf-benchmark measures baking with and without
+ * the volume cache, --generic-sdf evaluates primitives by the generic interpreter instead of per geometry SDFs.
+ * With --compile-scene out.prgscene the scene is compiled to binary form loaded by both renderers without parsing.
+ */
+int runHeadless(int argc, char* argv[]);
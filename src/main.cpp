@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <iostream>
 #include <array>
+#include <chrono>
 
 // #define DISABLE_LOGGING
 
@@ -15,28 +16,58 @@
 #include <scene/Scene.h>
 
 #include <sceneUtils.h>
+#include <SceneRenderer.h>
+#include <RayCamera.h>
+#include <FileWatcher.h>
+#include <CommandLine.h>
+#include <cpu/headless.h>
+#include <chess/Pgn.h>
+#include <chess/ChessScene.h>
 
 using namespace std;
 using namespace rb;
 
+// json or compiled scene, see --scene argument
+static string scenePath = RESOURCE_SCENE_JSON;
+
+// see --models, --bake-sdf and --generic-sdf arguments
+static SceneLoadOptions loadOptions;
+
+// reduced resolution during camera motion, disabled by --full-resolution
+static bool adaptiveResolution = true;
+
+// primary rays seeded from the previous frame, enabled by --reprojection and toggled by T
+static bool reprojection = false;
+
+// primary rays start where cones of a low resolution pass first approach a surface, enabled by --depth-prepass and toggled by P
+static bool depthPrepass = false;
+
+// soft shadows with penumbra factor given by --penumbra, 0 for hard shadows
+static float penumbraFactor = 0;
+
+// positions placed on the board, loaded from --pgn or --fen and stepped through by left and right arrows
+static PgnGame game;
+
 class App : public Application
 {
     using Application::Application;
 
     // my objects
     unique_ptr<OrbitCameraController> orbitCamera;
-    unique_ptr<Scene> scene;
+    unique_ptr<SceneRenderer> renderer; // models of json scene may be moved, added or removed between frames
+
+    // next frame is drawn with per pixel counters which are then written to files, requested by C
+    bool     dumpCounters = false;
+    uint32_t counterDumps = 0;
+
+    vector<Model> board; // models of the loaded scene which are not pieces
+    size_t        ply = 0;
 
-    // gl stuff
-    GLuint vao;
-    unique_ptr<Program> prg;
-    unique_ptr<UniformBuffer> sceneBuffer;
+    // scene reloaded by R is prepared in the background and swapped in by a later draw
+    bool reloading = false;
 
-    // scene gl data
-    unique_ptr<UniformBuffer> primitiveBuffer;
-    unique_ptr<UniformBuffer> materialBuffer;
-    unique_ptr<UniformBuffer> modelBuffer;
-    unique_ptr<UniformBuffer> bvhBuffer;
+    // edits of the scene and shader files are applied while the application runs
+    FileWatcher watcher;
 
     bool init() {
 
@@ -51,9 +82,19 @@ class App : public Application
 
         // gl program setup
         glClearColor(0, 0, 0, 1);
-        glCreateVertexArrays(1, &vao);
+        renderer = make_unique<SceneRenderer>();
+        renderer->setAdaptiveResolution(adaptiveResolution);
+        renderer->setReprojection(reprojection);
+        renderer->setDepthPrepass(depthPrepass);
+        renderer->setPenumbraFactor(penumbraFactor);
 
-        return updateScene();
+        // edits are applied on save, see applyFileChanges
+        for (const auto& file : vector<string>{ scenePath, RESOURCE_SHADERS_VERTEX_VS, RESOURCE_SHADERS_PRIMITIVE_SDF_FS, RESOURCE_SHADERS_FRAGMENT_FS }) {
+            if (!watcher.watch(file)) {
+                cerr << "Cannot watch " << file << " for changes" << endl;
+            }
+        }
+        return updateScene(false);
     }
 
     bool update(const Event &event) {
@@ -64,32 +105,113 @@ class App : public Application
                 exit();
             }
             if (event.keyPressedData.keyCode == SDLK_r) {
-                updateScene();
+                updateScene(true);
+            }
+            if (event.keyPressedData.keyCode == SDLK_t) {
+                reprojection = !reprojection;
+                renderer->setReprojection(reprojection);
+                cout << "Reprojection " << (reprojection ? "on" : "off") << "\n";
+            }
+            if (event.keyPressedData.keyCode == SDLK_p) {
+                depthPrepass = !depthPrepass;
+                renderer->setDepthPrepass(depthPrepass);
+                cout << "Depth prepass " << (depthPrepass ? "on" : "off") << "\n";
+            }
+            if (event.keyPressedData.keyCode == SDLK_c) {
+                dumpCounters = true;
+                renderer->setPixelCounters(true);
+            }
+            if (event.keyPressedData.keyCode == SDLK_RIGHT && ply + 1 < game.positions.size()) {
+                showPosition(ply + 1);
+            }
+            if (event.keyPressedData.keyCode == SDLK_LEFT && ply > 0) {
+                showPosition(ply - 1);
             }
         }
         return true;
     }
 
     void draw() {
-        prg->use();
-        glClear(GL_COLOR_BUFFER_BIT);
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES,0,6);
+        if (!reloading) {
+            applyFileChanges();
+        }
+        renderer->draw();
+        if (reloading && renderer->getLoadState() != SceneLoadState::slPreparing && renderer->getLoadState() != SceneLoadState::slUploading) {
+            reloading = false;
+            sceneLoaded(renderer->getLoadState() == SceneLoadState::slLoaded);
+        }
+        if (dumpCounters) {
+            writeCounters();
+        }
     }
 
-    // loads scene data to GPU
-    bool updateScene() {
-        
-        prg = make_unique<Program>(
-            make_shared<Shader>(GL_VERTEX_SHADER, RESOURCE_SHADERS_VERTEX_VS),
-            make_shared<Shader>(GL_FRAGMENT_SHADER, RESOURCE_SHADERS_PRIMITIVE_SDF_FS),
-            make_shared<Shader>(GL_FRAGMENT_SHADER, RESOURCE_SHADERS_FRAGMENT_FS)
-        );
+    void writeCounters() {
+        auto counters = renderer->getPixelCounters();
+        renderer->setPixelCounters(false);
+        dumpCounters = false;
+
+        auto prefix = "counters_" + to_string(counterDumps++);
+        for (uint32_t i = 0; i < PIXEL_COUNTER_COUNT; ++i) {
+            cout << computeHistogram(counters, PixelCounter(i)) << "\n";
+        }
+        if (!writePixelCounters(counters, prefix)) {
+            cerr << "Error while writing pixel counters " << prefix << endl;
+            return;
+        }
+        cout << "Pixel counters written to " << prefix << "_*\n";
+    }
+
+    // shader edits only reload the program, scene edits upload what changed unless geometries or materials were added or removed
+    void applyFileChanges() {
+        bool sceneChanged   = false;
+        bool shadersChanged = false;
+        for (const auto& file : watcher.poll()) {
+            if (file == scenePath) {
+                sceneChanged = true;
+            } else {
+                shadersChanged = true;
+            }
+        }
+
+        auto start = chrono::steady_clock::now();
+        if (shadersChanged) {
+            if (!renderer->loadProgram()) {
+                cerr << "Error while creating a program: \n" << renderer->getErrorMessage() << endl;
+            } else {
+                cout << renderer->getProgramReport() << "\n";
+            }
+        }
+        if (!sceneChanged) {
+            return;
+        }
+        auto reload = SceneReload();
+        if (!renderer->reloadScene(scenePath, loadOptions, reload)) {
+            cerr << "Error while reloading a scene: " << renderer->getErrorMessage() << endl;
+            return;
+        }
+        if (reload.full) {
+            cout << reload << "\n";
+            updateScene(true);
+            return;
+        }
+        if (!game.positions.empty()) {
+            board = boardModels(renderer->getScene()->getScene());
+            showPosition(ply);
+        }
+        auto duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+        cout << reload << ", applied in " << duration.count() / 1000.0 << " ms\n";
+    }
+
+    // loads scene data to GPU, in the background when async so that frames keep the current scene meanwhile
+    bool updateScene(bool async) {
+        auto start = chrono::steady_clock::now();
         
-        if (!prg->getErrorMessage().empty()) {
-            cerr << "Error while creating a program: \n" << prg->getErrorMessage() << endl;
+        // program is compiled only when shader sources changed
+        if (!renderer->loadProgram()) {
+            cerr << "Error while creating a program: \n" << renderer->getErrorMessage() << endl;
             return false;
         }
+        cout << renderer->getProgramReport() << "\n";
         
         // camera setup
         auto camPos     = glm::vec3(0, 10, -10);
@@ -106,25 +228,54 @@ class App : public Application
         orbitCamera = make_unique<OrbitCameraController>(cam);
         updateCamera();
         
-        prg->uniform("lightPosition", glm::vec3(10, 10, 0)); // in the future make light part of the scene
+        renderer->setLightPosition(glm::vec3(10, 10, 0)); // in the future make light part of the scene
         
-        scene = buildSceneFromJson(RESOURCE_SCENE_JSON);
-        
-        auto shaderData = prepareShaderSceneData(*scene);
-        
-        primitiveBuffer = make_unique<UniformBuffer>(shaderData.primitives);
-        materialBuffer  = make_unique<UniformBuffer>(shaderData.materials);
-        modelBuffer     = make_unique<UniformBuffer>(shaderData.models);
-        bvhBuffer       = make_unique<UniformBuffer>(shaderData.bvh);
-        
-        prg->uniform("PrimitivesBlock", *primitiveBuffer, 0);
-        prg->uniform("MaterialBlock",   *materialBuffer,  1);
-        prg->uniform("ModelsBlock",     *modelBuffer,     2);
-        prg->uniform("BVHBlock",        *bvhBuffer,       3);
+        if (async) {
+            reloading = renderer->loadSceneAsync(scenePath, loadOptions);
+            if (!reloading) {
+                cout << "Scene is still loading\n";
+            }
+            return reloading;
+        }
+        if (!sceneLoaded(renderer->loadScene(scenePath, loadOptions))) {
+            return false;
+        }
         
+        auto duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+        cout << "Scene and program loaded in " << duration.count() / 1000.0 << " ms\n";
+        return true;
+    }
+
+    bool sceneLoaded(bool success) {
+        if (!success) {
+            cerr << "Error while loading a scene: " << renderer->getErrorMessage() << endl;
+            return false;
+        }
+        cout << renderer->getLoadReport().bvh << "\n";
+        cout << renderer->getLoadReport() << "\n";
+
+        if (!game.positions.empty()) {
+            if (renderer->getScene() == nullptr) {
+                cerr << "Chess positions need a json scene, models of a compiled scene cannot be replaced" << endl;
+                return false;
+            }
+            board = boardModels(renderer->getScene()->getScene());
+            showPosition(ply);
+        }
         return true;
     }
 
+    // only piece models change, they are uploaded with the refitted BVH by the next draw
+    void showPosition(size_t index) {
+        ply = index;
+        renderer->getScene()->setModels(positionModels(game.positions[ply], board));
+        if (ply > 0) {
+            const auto& before = game.positions[ply - 1];
+            cout << before.fullmoveNumber << (before.sideToMove == ChessColor::ccWhite ? ". " : "... ") << game.moves[ply - 1] << "\n";
+        }
+        cout << game.positions[ply].getFen() << "\n";
+    }
+
     // loads camera dat to GPU
     void updateCamera() {
         LOG_DEBUG("Position:         " << glm::to_string(orbitCamera->camera->getPosition()));
@@ -132,16 +283,65 @@ class App : public Application
         LOG_DEBUG("Direction:        " << glm::to_string(orbitCamera->camera->getDirection()));
         LOG_DEBUG("cameraFOVDegrees: " << glm::degrees(orbitCamera->camera->getFov()));
         
-        float fovTangent = glm::tan(orbitCamera->camera->getFov() / 2.0f);
-        prg->uniform("cameraPosition",    orbitCamera->camera->getPosition());
-        prg->uniform("cameraDirection",   orbitCamera->camera->getDirection());
-        prg->uniform("upRayDistorsion",   orbitCamera->camera->getOrientationUp()   * fovTangent);
-        prg->uniform("leftRayDistorsion", orbitCamera->camera->getOrientationLeft() * fovTangent * orbitCamera->camera->getAspectRatio());
+        renderer->setCamera(RayCamera::fromCamera(orbitCamera->camera));
     }
     
 };
 
 int main(int argc, char *argv[]) {
+    if (isHeadlessRun(argc, argv)) {
+        return runHeadless(argc, argv);
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "--full-resolution") {
+            adaptiveResolution = false;
+        }
+        if (string(argv[i]) == "--reprojection") {
+            reprojection = true;
+        }
+        if (string(argv[i]) == "--depth-prepass") {
+            depthPrepass = true;
+        }
+        if (string(argv[i]) == "--generic-sdf") {
+            loadOptions.specializeSdf = false;
+        }
+    }
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (string(argv[i]) == "--models") {
+            if (!parseArgumentValue(argv[i], argv[i + 1], [&]() { loadOptions.modelCount = toUnsigned(argv[i + 1]); return true; })) {
+                return 1;
+            }
+        }
+        if (string(argv[i]) == "--scene") {
+            scenePath = argv[i + 1];
+        }
+        if (string(argv[i]) == "--bake-sdf") {
+            if (!parseArgumentValue(argv[i], argv[i + 1], [&]() { loadOptions.sdfResolution = toUnsigned(argv[i + 1]); return true; })) {
+                return 1;
+            }
+        }
+        if (string(argv[i]) == "--penumbra") {
+            if (!parseArgumentValue(argv[i], argv[i + 1], [&]() { penumbraFactor = stof(argv[i + 1]); return true; })) {
+                return 1;
+            }
+        }
+        if (string(argv[i]) == "--pgn") {
+            string error;
+            if (!loadPgn(argv[i + 1], game, error)) {
+                cerr << "Error while reading game " << argv[i + 1] << ": " << error << endl;
+                return 1;
+            }
+        }
+        if (string(argv[i]) == "--fen") {
+            string error;
+            game = PgnGame();
+            game.positions.emplace_back();
+            if (!game.positions[0].setFen(argv[i + 1], error)) {
+                cerr << "Error while reading FEN: " << error << endl;
+                return 1;
+            }
+        }
+    }
     auto app = App(Configuration(argc, argv));
     return app.run();
 }
@@ -2,6 +2,7 @@
 
 #include <scene/Transform.h>
 
+#include <cstdint>
 #include <string>
 
 class Model
@@ -10,4 +11,8 @@ class Model
         Transform   transform     = Transform();
         std::string geometryIdent = "";
         std::string materialIdent = "";
+
+        // indices of the identifiers in Scene::geometryNames and Scene::materialNames, -1 until interned or when unknown
+        int32_t geometryHandle = -1;
+        int32_t materialHandle = -1;
 };
@@ -148,7 +148,9 @@ void Cone::setDataPropertyByName(const std::string& name, float value) {
 PrimitiveType RoundCone::getType() const { return PrimitiveType::ptRoundCone; }
 
 glm::vec3 RoundCone::getDimensions() const {
-    return glm::vec3( 2.0f * glm::max(data.x, data.y), data.z + data.x + data.y, 2.0f * glm::max(data.x, data.y)) + (blending * 0.5f);
+    // spheres of different radii make the shape asymmetric, box around origin has to contain the larger one at both ends
+    float radius = glm::max(data.x, data.y);
+    return glm::vec3( 2.0f * radius, data.z + 2.0f * radius, 2.0f * radius) + (blending * 0.5f);
 }
 
 void RoundCone::setDataPropertyByName(const std::string& name, float value) {
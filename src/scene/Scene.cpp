@@ -0,0 +1,31 @@
+
+#include <scene/Scene.h>
+
+using namespace std;
+
+void Scene::internIdentifiers() {
+    geometryNames.clear();
+    geometryHandles.clear();
+    for (const auto& [name, geometry] : geometries) {
+        geometryHandles[name] = int32_t(geometryNames.size());
+        geometryNames.push_back(name);
+    }
+
+    materialNames.clear();
+    materialHandles.clear();
+    for (const auto& [name, material] : materials) {
+        materialHandles[name] = int32_t(materialNames.size());
+        materialNames.push_back(name);
+    }
+
+    for (auto& model : models) {
+        intern(model);
+    }
+}
+
+void Scene::intern(Model& model) const {
+    auto geometryIt      = geometryHandles.find(model.geometryIdent);
+    auto materialIt      = materialHandles.find(model.materialIdent);
+    model.geometryHandle = geometryIt != geometryHandles.end() ? geometryIt->second : -1;
+    model.materialHandle = materialIt != materialHandles.end() ? materialIt->second : -1;
+}
@@ -7,10 +7,25 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 
 class Scene {
     public:
         std::map<std::string, ModelGeometry> geometries = {};
         std::map<std::string, Material>      materials  = {};
         std::vector<Model>                   models     = {};
+
+        // identifiers in order of the maps above, handle of a geometry or material is its index here
+        std::vector<std::string> geometryNames = {};
+        std::vector<std::string> materialNames = {};
+
+        // handles of all identifiers and models, has to be called again when geometries or materials change
+        void internIdentifiers();
+
+        // sets handles of a model by its identifiers, unknown identifiers get -1
+        void intern(Model& model) const;
+
+    private:
+        std::unordered_map<std::string, int32_t> geometryHandles = {};
+        std::unordered_map<std::string, int32_t> materialHandles = {};
 };
@@ -1,8 +1,7 @@
 
 #include <scene/Transform.h>
 
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/transform.hpp>
+#include <glm/gtx/euler_angles.hpp>
 
 using namespace std;
 
@@ -13,18 +12,31 @@ Transform::Transform(glm::vec3 position, glm::vec3 rotation, float size) :
 {}
 
 glm::mat4 Transform::getTransform() const {
-    auto m = glm::mat4(1);
-    // m = glm::inverse(glm::scale(glm::mat4(1), glm::vec3(size))); // scaling invalidates distance field - we need to scale primitives geometry
-    // m = glm::scale(glm::mat4(1), glm::vec3(size)); // scaling invalidates distance field - we need to scale primitives geometry
-    m = m * getRotationMatrix();
-    m = glm::translate(m, -position);
+    // scaling invalidates distance field - we need to scale primitives geometry, so size is not part of the matrix
+    auto m = getRotationMatrix();
+    m[3]   = glm::vec4(glm::mat3(m) * -position, 1.0f); // same as glm::translate(m, -position)
     return m;
 }
 
-glm::mat4 Transform::getRotationMatrix() const {
-    auto m = glm::mat4(1);
-    m = glm::rotate(m, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    m = glm::rotate(m, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-    m = glm::rotate(m, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+glm::mat4 Transform::getInverseTransform() const {
+    auto m = glm::transpose(getRotationMatrix());
+    m[3]   = glm::vec4(position, 1.0f);
     return m;
 }
+
+// single closed form product of rotations around y, z and x instead of three glm::rotate calls
+glm::mat4 Transform::getRotationMatrix() const {
+    return glm::eulerAngleYZX(glm::radians(rotation.y), glm::radians(rotation.z), glm::radians(rotation.x));
+}
+
+// exact comparison, only transforms which evaluate to the same position are reduced
+TransformKind classifyTransform(const glm::mat4& transform) {
+    if (glm::mat3(transform) != glm::mat3(1.0f)) {
+        return TransformKind::tkGeneral;
+    }
+    return glm::vec3(transform[3]) == glm::vec3(0.0f) ? TransformKind::tkIdentity : TransformKind::tkTranslation;
+}
+
+glm::mat3x4 packTransform(const glm::mat4& transform) {
+    return glm::transpose(glm::mat4x3(transform));
+}
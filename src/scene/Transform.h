@@ -2,6 +2,13 @@
 
 #include <glm/glm.hpp>
 
+// cheapest way to bring a point to the space of an object, tag of transforms packed to shader data
+enum TransformKind {
+    tkIdentity    = 0,
+    tkTranslation = 1, // p + translation
+    tkGeneral     = 2, // rotation * p + translation, any affine transform takes the same path
+};
+
 struct Transform {
     glm::vec3 position;
     glm::vec3 rotation;
@@ -14,6 +21,7 @@ struct Transform {
     );
 
     glm::mat4 getTransform() const;
+    glm::mat4 getInverseTransform() const; // object space to world space, closed form of glm::inverse(getTransform())
     glm::mat4 getRotationMatrix() const;
 
     // a syntax sugar
@@ -24,3 +32,20 @@ struct Transform {
     inline void translate(float x, float y, float z) { translate({x, y, z}); }
     inline void rotate(float x, float y, float z)    { rotate({x, y, z}); }
 };
+
+TransformKind classifyTransform(const glm::mat4& transform);
+
+// rows of the affine part of the transform with translation in w, vec4(p, 1) * packed is the transformed point
+glm::mat3x4 packTransform(const glm::mat4& transform);
+
+inline glm::vec3 packedTranslation(const glm::mat3x4& packed) {
+    return glm::vec3(packed[0].w, packed[1].w, packed[2].w);
+}
+
+inline glm::vec3 transformPosition(const glm::mat3x4& packed, TransformKind kind, glm::vec3 position) {
+    switch (kind) {
+        case TransformKind::tkIdentity:    return position;
+        case TransformKind::tkTranslation: return position + packedTranslation(packed);
+        default:                           return glm::vec4(position, 1.0f) * packed;
+    }
+}
@@ -30,8 +30,6 @@
 using namespace std;
 using Json = nlohmann::json;
 
-int addBvhToVector(const AABBNode& node, vector<ShaderBVHNode>& target, int parent = -1);
-
 template<size_t L>
 glm::vec<L, float> jsonToVec(Json value) {
     auto res = glm::vec<L, float>(0);
@@ -110,99 +108,138 @@ unique_ptr<Scene> buildSceneFromJson(string jsonFile) {
     // fill models
     scene->models.reserve(json["models"].size());
     for (auto& [key, value] : json["models"].items()) {
-        auto model = Model();
-        SET_PROPERTY_TRANSFORM(model)
-        SET_PROPERTY_STRING(model, geometry, geometryIdent)
-        SET_PROPERTY_STRING(model, material, materialIdent)
+        auto model = buildModelFromJson(value);
         assert(!model.geometryIdent.empty() && !model.materialIdent.empty());
         scene->models.push_back(model);
     }
 
+    scene->internIdentifiers();
     return scene;
 }
 
+Model buildModelFromJson(const Json& value) {
+    auto model = Model();
+    SET_PROPERTY_TRANSFORM(model)
+    SET_PROPERTY_STRING(model, geometry, geometryIdent)
+    SET_PROPERTY_STRING(model, material, materialIdent)
+    return model;
+}
+
+void replicateModels(Scene& scene, size_t count, float cellSize) {
+    auto original = scene.models;
+    scene.models.clear();
+    if (original.empty()) {
+        return;
+    }
+
+    scene.models.reserve(count);
+    size_t copies = (count + original.size() - 1) / original.size();
+    int    side   = int(glm::ceil(glm::sqrt(float(copies))));
+    for (size_t copy = 0; scene.models.size() < count; ++copy) {
+        auto offset = glm::vec3(float(copy % side), 0.0f, float(copy / side)) * cellSize;
+        for (const auto& model : original) {
+            if (scene.models.size() == count) {
+                break;
+            }
+            scene.models.push_back(model);
+            scene.models.back().transform.translate(offset);
+        }
+    }
+}
+
+ShaderPrimitive prepareShaderPrimitive(const Primitive& primitive) {
+    auto transform                = primitive.transform.getTransform();
+    auto shaderPrimitive          = ShaderPrimitive();
+    shaderPrimitive.type          = primitive.getType();
+    shaderPrimitive.transform     = packTransform(transform);
+    shaderPrimitive.transformKind = classifyTransform(transform);
+    shaderPrimitive.data          = primitive.data;
+    shaderPrimitive.operation     = primitive.operation;
+    shaderPrimitive.blending      = primitive.blending;
+
+    auto box = AABBHierarchy::bbForPrimitive(primitive);
+    shaderPrimitive.bound = glm::vec4(box.center(), glm::length(box.max - box.min) * 0.5f);
+    return shaderPrimitive;
+}
+
+ShaderMaterial prepareShaderMaterial(const Material& material) {
+    auto shaderMaterial          = ShaderMaterial();
+    shaderMaterial.color         = glm::vec4(material.color, 1.0);
+    shaderMaterial.specularColor = glm::vec4(material.specularColor, 1.0);
+    shaderMaterial.shininess     = material.shininess;
+    shaderMaterial.textureId     = material.textureType;
+    shaderMaterial.textureMix    = material.textureMix;
+    return shaderMaterial;
+}
+
+// O(1) by interned handles, models with unknown identifiers fall back to the first geometry and material,
+// without geometries the model has no primitives and an empty bound
+ShaderModel prepareShaderModel(const Model& model, const ShaderSceneData& data) {
+    bool knownGeometry  = model.geometryHandle >= 0 && size_t(model.geometryHandle) < data.geometryRanges.size();
+    bool knownMaterial  = model.materialHandle >= 0 && size_t(model.materialHandle) < data.materials.size();
+    auto geometryHandle = knownGeometry ? model.geometryHandle : 0;
+    bool hasGeometry    = size_t(geometryHandle) < data.geometryRanges.size();
+    auto geometryRange  = hasGeometry ? data.geometryRanges[geometryHandle] : glm::uvec2(0);
+    auto geometryBound  = hasGeometry ? data.geometryBounds[geometryHandle] : BoundingBox();
+
+    auto transform             = model.transform.getTransform();
+    auto shaderModel           = ShaderModel();
+    shaderModel.transform      = packTransform(transform);
+    shaderModel.transformKind  = classifyTransform(transform);
+    shaderModel.geometryId     = geometryRange.x;
+    shaderModel.primitiveCount = geometryRange.y;
+    shaderModel.materialId     = knownMaterial ? model.materialHandle : 0;
+    shaderModel.scale          = model.transform.size;
+    shaderModel.boundMin       = geometryBound.min;
+    shaderModel.boundMax       = geometryBound.max;
+    shaderModel.volumeId       = size_t(geometryHandle) < data.geometryVolumes.size() ? data.geometryVolumes[geometryHandle] : -1;
+    return shaderModel;
+}
+
 ShaderSceneData prepareShaderSceneData(const Scene& scene) {
-    auto data = ShaderSceneData();
+    auto aabb = AABBHierarchy(scene);
 
-    // model geometry identification map - geometry_ident -> (primitive_offset, primitive_count)
-    unordered_map<string, tuple<uint32_t, uint32_t>> mgIdentMap;
+    #if DEBUG
+    aabb.debugPrint();
+    #endif
 
-    // material identification map - material_ident -> material_offset
-    unordered_map<string, uint32_t> maIdentMap;
+    return prepareShaderSceneData(scene, aabb);
+}
 
-    // load primitives to data and fill mgIdentMap
+ShaderSceneData prepareShaderSceneData(const Scene& scene, const AABBHierarchy& hierarchy) {
+    auto data = ShaderSceneData();
+
+    // load primitives to data and fill geometry ranges, geometries are iterated in order of their handles
     uint32_t actId = 0;
-    for (const auto& actGeometry : scene.geometries) {
-        uint32_t count = 0;
-        for (const auto& actPrimitive : actGeometry.second.primitives) {
+    for (int32_t handle = 0; handle < int32_t(scene.geometryNames.size()); ++handle) {
+        const auto& name = scene.geometryNames[handle];
+        uint32_t count   = 0;
+        for (const auto& actPrimitive : scene.geometries.at(name).primitives) {
             ++count;
-            auto shaderPrimitive      = ShaderPrimitive();
-            shaderPrimitive.type      = actPrimitive->getType();
-            shaderPrimitive.transform = actPrimitive->transform.getTransform();
-            shaderPrimitive.data      = actPrimitive->data;
-            shaderPrimitive.operation = actPrimitive->operation;
-            shaderPrimitive.blending  = actPrimitive->blending;
-            data.primitives.push_back(shaderPrimitive);
+            data.primitives.push_back(prepareShaderPrimitive(*actPrimitive));
         }
-        mgIdentMap[actGeometry.first] = { actId, count };
+        data.geometryNames.push_back(name);
+        data.geometryRanges.push_back({ actId, count });
+        data.geometryBounds.push_back(hierarchy.geometryBB(handle));
         actId += count;
     }
 
-    // load materials to data and fill maIdentMap
-    actId = 0;
+    data.geometryVolumes.assign(data.geometryRanges.size(), -1);
+
+    // load materials to data in order of their handles
     for (const auto& actMaterial : scene.materials) {
-        auto shaderMaterial          = ShaderMaterial();
-        shaderMaterial.color         = glm::vec4(actMaterial.second.color, 1.0);
-        shaderMaterial.specularColor = glm::vec4(actMaterial.second.specularColor, 1.0);
-        shaderMaterial.shininess     = actMaterial.second.shininess;;
-        shaderMaterial.textureId     = actMaterial.second.textureType;
-        shaderMaterial.textureMix    = actMaterial.second.textureMix;
-        data.materials.push_back(shaderMaterial);
-
-        maIdentMap[actMaterial.first] = actId;
-        ++actId;
+        data.materials.push_back(prepareShaderMaterial(actMaterial.second));
     }
 
     // load models to data
+    data.models.reserve(scene.models.size());
     for (const auto& actModel : scene.models) {
-        auto shaderModel           = ShaderModel();
-        shaderModel.transform      = actModel.transform.getTransform();
-        shaderModel.geometryId     = get<0>(mgIdentMap[actModel.geometryIdent]);
-        shaderModel.primitiveCount = get<1>(mgIdentMap[actModel.geometryIdent]);
-        shaderModel.materialId     = maIdentMap[actModel.materialIdent];
-        shaderModel.scale          = actModel.transform.size;
-        data.models.push_back(shaderModel);
+        data.models.push_back(prepareShaderModel(actModel, data));
     }
 
     // load bvh to data
-    auto aabb = AABBHierarchy(scene);
-
-    #if DEBUG
-    aabb.root->debugPrint();
-    #endif
-
-    data.bvh.reserve(data.models.size() * 2 + 2);
-    addBvhToVector(*aabb.root, data.bvh);
+    data.bvh       = hierarchy.nodes;
+    data.bvhReport = hierarchy.report;
 
     return data;
 }
-
-int addBvhToVector(const AABBNode& node, vector<ShaderBVHNode>& target, int parent) {
-    auto bVolume = ShaderBVHNode();
-    bVolume.bbMin = glm::vec4(node.box.min, 1.0f);
-    bVolume.bbMax = glm::vec4(node.box.max, 1.0f);
-    bVolume.model = node.modelId;
-    bVolume.parent = parent;
-
-    auto actIndex = target.size();
-    target.push_back(bVolume);
-    if (node.left != nullptr) {
-        target[actIndex].left = addBvhToVector(*node.left, target, actIndex);
-    }
-
-    if (node.right != nullptr) {
-        target[actIndex].right = addBvhToVector(*node.right, target, actIndex);
-    }
-
-    return actIndex;
-}
\ No newline at end of file
@@ -1,16 +1,22 @@
 #pragma once
 
 #include <scene/Scene.h>
+#include <AABB.h>
+
+#include <nlohmann/json.hpp>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 struct ShaderPrimitive {
-    glm::u32  type;
-    glm::u32  operation;
-    glm::f32  blending;
-    glm::f32  dummy;
-    glm::mat4 transform;
-    glm::vec4 data;
+    glm::u32    type;
+    glm::u32    operation;
+    glm::f32    blending;
+    glm::u32    transformKind; // TransformKind of the transform
+    glm::mat3x4 transform;     // see packTransform
+    glm::vec4   data;
+    glm::vec4   bound;         // bounding sphere in geometry space, xyz center, w radius
 };
 
 struct ShaderMaterial {
@@ -23,29 +29,51 @@ struct ShaderMaterial {
 };
 
 struct ShaderModel {
-    glm::mat4 transform;
-    glm::u32  geometryId;
-    glm::u32  materialId;
-    glm::u32  primitiveCount;
-    glm::f32  scale;
+    glm::mat3x4 transform; // see packTransform
+    glm::u32    geometryId;
+    glm::u32    materialId;
+    glm::u32    primitiveCount;
+    glm::f32    scale;
+    glm::vec3   boundMin;      // box of added primitives in geometry space
+    glm::i32    volumeId;      // baked SDF volume of the geometry, -1 when there is none
+    glm::vec3   boundMax;
+    glm::u32    transformKind; // TransformKind of the transform
 };
 
-struct ShaderBVHNode {
-    glm::vec4 bbMin  = glm::vec4(0);
-    glm::vec4 bbMax  = glm::vec4(0);
-    glm::i32  left   = -1;
-    glm::i32  right  = -1;
-    glm::i32  parent = -1;
-    glm::i32  model  = -1;
+// baked SDF volumes of geometries, each is a cube of resolution^3 samples stacked along z, see SdfVolume.h
+struct SdfVolumeAtlas {
+    glm::u32           resolution = 0;
+    glm::u32           count      = 0;
+    std::vector<float> distances;
 };
 
 struct ShaderSceneData {
     std::vector<ShaderPrimitive> primitives;
     std::vector<ShaderModel>     models;
     std::vector<ShaderMaterial>  materials;
-    std::vector<ShaderBVHNode>   bvh;
+    std::vector<BVHNode>         bvh; // flat BVH is uploaded as it is
+    BVHBuildReport               bvhReport;
+    SdfVolumeAtlas               volumes;
+
+    // per geometry handle (see Scene::internIdentifiers), used for models added later,
+    // material handle is directly the index to materials
+    std::vector<std::string> geometryNames;
+    std::vector<glm::uvec2>  geometryRanges;  // first primitive, primitive count
+    std::vector<BoundingBox> geometryBounds;
+    std::vector<int32_t>     geometryVolumes; // baked SDF volume, -1 when there is none
 };
 
 ShaderSceneData prepareShaderSceneData(const Scene& scene);
+ShaderSceneData prepareShaderSceneData(const Scene& scene, const AABBHierarchy& hierarchy);
+
+ShaderModel     prepareShaderModel(const Model& model, const ShaderSceneData& data);
+ShaderPrimitive prepareShaderPrimitive(const Primitive& primitive);
+ShaderMaterial  prepareShaderMaterial(const Material& material);
 
 std::unique_ptr<Scene> buildSceneFromJson(std::string jsonFile);
+
+// model entry of "models" array of scene json, handles are not interned
+Model buildModelFromJson(const nlohmann::json& value);
+
+// copies of scene models are placed on a square grid of cells until count is reached, used to test scaling
+void replicateModels(Scene& scene, size_t count, float cellSize = 10.0f);